@@ -0,0 +1,63 @@
+#include "Arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+void* MonotonicArena::AllocateSlow(const size_t size, const size_t alignment) {
+	const auto required = sizeof(Block) + size + alignment;
+	auto blockSize = std::max(m_nextBlockSize, required);
+	const auto block = static_cast<Block*>(malloc(blockSize));
+	if (block == nullptr)
+		throw std::bad_alloc();
+	block->previous = m_head;
+	m_head = block;
+	++m_blockCount;
+	m_cursor = reinterpret_cast<char*>(block + 1);
+	m_end = reinterpret_cast<char*>(block) + blockSize;
+	m_nextBlockSize = std::min(m_nextBlockSize * 2, MAX_BLOCK_SIZE);
+	return Allocate(size, alignment);
+}
+
+void MonotonicArena::Release() {
+	while (m_head != nullptr) {
+		const auto previous = m_head->previous;
+		free(m_head);
+		m_head = previous;
+	}
+	m_cursor = m_end = nullptr;
+	m_blockCount = 0;
+}
+
+std::string_view MonotonicArena::CopyString(std::string_view s) {
+	if (s.empty())
+		return std::string_view();
+	const auto p = static_cast<char*>(Allocate(s.size(), 1));
+	memcpy(p, s.data(), s.size());
+	return std::string_view(p, s.size());
+}
+
+void StringInterner::SetLowercase(std::string_view name) {
+	m_lowercase.assign(name.begin(), name.end());
+	std::transform(m_lowercase.begin(), m_lowercase.end(), m_lowercase.begin(), [](const char c) {
+		return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+	});
+}
+
+std::pair<uint32_t, bool> StringInterner::Intern(std::string_view name) {
+	SetLowercase(name);
+
+	const auto it = m_ids.find(m_lowercase);
+	if (it != m_ids.end())
+		return std::make_pair(it->second, false);
+
+	const auto id = static_cast<uint32_t>(m_ids.size());
+	m_ids.emplace(m_arena.CopyString(m_lowercase), id);
+	return std::make_pair(id, true);
+}
+
+uint32_t StringInterner::Find(std::string_view name) {
+	SetLowercase(name);
+	const auto it = m_ids.find(m_lowercase);
+	return it == m_ids.end() ? UINT32_MAX : it->second;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// Bump allocator whose memory is only ever released all at once.
+// Blocks double in size up to MAX_BLOCK_SIZE, so even large documents need few system allocations.
+class MonotonicArena {
+	struct Block {
+		Block* previous;
+	};
+
+	static constexpr size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+	Block* m_head = nullptr;
+	char* m_cursor = nullptr;
+	char* m_end = nullptr;
+	size_t m_nextBlockSize;
+	size_t m_blockCount = 0;
+
+	void* AllocateSlow(size_t size, size_t alignment);
+
+public:
+	explicit MonotonicArena(size_t initialBlockSize = 64 * 1024) : m_nextBlockSize(initialBlockSize) {}
+	MonotonicArena(const MonotonicArena&) = delete;
+	MonotonicArena(MonotonicArena&&) = delete;
+	MonotonicArena& operator =(const MonotonicArena&) = delete;
+	MonotonicArena& operator =(MonotonicArena&&) = delete;
+	~MonotonicArena() { Release(); }
+
+	void Release();
+
+	size_t GetBlockCount() const { return m_blockCount; }
+
+	void* Allocate(const size_t size, const size_t alignment) {
+		const auto p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(m_cursor) + alignment - 1) & ~(alignment - 1));
+		if (m_cursor == nullptr || p + size > m_end)
+			return AllocateSlow(size, alignment);
+		m_cursor = p + size;
+		return p;
+	}
+
+	// Destructors of objects made here never run.
+	template<typename T, typename... Args>
+	T* New(Args&&... args) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+		return new(Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	std::string_view CopyString(std::string_view s);
+};
+
+// Maps ASCII case-insensitive names to small consecutive ids; the names live in an arena.
+class StringInterner {
+	MonotonicArena& m_arena;
+	std::unordered_map<std::string_view, uint32_t> m_ids;
+	std::string m_lowercase;
+
+	void SetLowercase(std::string_view name);
+
+public:
+	explicit StringInterner(MonotonicArena& arena) : m_arena(arena) {}
+
+	void Clear() { m_ids.clear(); }
+	size_t Size() const { return m_ids.size(); }
+
+	// Returns the id of name and whether it was newly added.
+	std::pair<uint32_t, bool> Intern(std::string_view name);
+
+	// Returns UINT32_MAX if name was never interned.
+	uint32_t Find(std::string_view name);
+};
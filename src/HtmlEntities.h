@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace HtmlEntities {
+	struct NamedEntity {
+		const char* name;
+		uint32_t codePoint;
+	};
+
+	// Every entity FindNamed knows, sorted by name.
+	const NamedEntity* GetNamedEntities(size_t& count);
+
+	// Returns the code point of a named entity of HTML 4 (plus apos), or 0 if unknown. name excludes '&' and ';'.
+	uint32_t FindNamed(std::string_view name);
+
+	// Decodes the character reference at text[0] == '&': "&name;", "&#123;" or "&#x1F;".
+	// Numeric references in 0x80-0x9F are read as Windows-1252, as browsers do.
+	// Returns the number of bytes consumed, or 0 if text does not start with a valid reference.
+	size_t Decode(std::string_view text, uint32_t& codePoint);
+
+	// Writes at most 4 bytes; surrogates become U+FFFD.
+	size_t EncodeUtf8(uint32_t codePoint, char* out);
+};
@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::filesystem::path& path) {
+	Close();
+
+	const auto hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	m_hFile = hFile;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size)) {
+		Close();
+		return false;
+	}
+	m_size = static_cast<uint64_t>(size.QuadPart);
+
+	// empty files cannot be mapped
+	if (m_size == 0)
+		return true;
+
+	m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == nullptr) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	Unmap();
+	if (m_hMapping != nullptr)
+		CloseHandle(m_hMapping);
+	if (m_hFile != nullptr)
+		CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = nullptr;
+	m_size = 0;
+}
+
+std::string_view MappedFile::Map(const uint64_t offset, const size_t length) {
+	Unmap();
+	if (m_hMapping == nullptr || length == 0 || offset + length > m_size)
+		return std::string_view();
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	const auto pad = static_cast<size_t>(offset % si.dwAllocationGranularity);
+	const auto base = offset - pad;
+	m_view = MapViewOfFile(m_hMapping, FILE_MAP_READ, static_cast<DWORD>(base >> 32), static_cast<DWORD>(base & 0xFFFFFFFF), length + pad);
+	if (m_view == nullptr)
+		return std::string_view();
+	m_viewLength = length + pad;
+	return std::string_view(static_cast<const char*>(m_view) + pad, length);
+}
+
+void MappedFile::Unmap() {
+	if (m_view != nullptr)
+		UnmapViewOfFile(m_view);
+	m_view = nullptr;
+	m_viewLength = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path& path) {
+	Close();
+
+	m_fd = open(path.c_str(), O_RDONLY);
+	if (m_fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(m_fd, &st) == -1) {
+		Close();
+		return false;
+	}
+	m_size = static_cast<uint64_t>(st.st_size);
+	return true;
+}
+
+void MappedFile::Close() {
+	Unmap();
+	if (m_fd != -1)
+		close(m_fd);
+	m_fd = -1;
+	m_size = 0;
+}
+
+std::string_view MappedFile::Map(const uint64_t offset, const size_t length) {
+	Unmap();
+	if (m_fd == -1 || length == 0 || offset + length > m_size)
+		return std::string_view();
+
+	const auto pad = static_cast<size_t>(offset % static_cast<uint64_t>(sysconf(_SC_PAGESIZE)));
+	const auto view = mmap(nullptr, length + pad, PROT_READ, MAP_PRIVATE, m_fd, static_cast<off_t>(offset - pad));
+	if (view == MAP_FAILED)
+		return std::string_view();
+	m_view = view;
+	m_viewLength = length + pad;
+	madvise(m_view, m_viewLength, MADV_SEQUENTIAL);
+	return std::string_view(static_cast<const char*>(m_view) + pad, length);
+}
+
+void MappedFile::Unmap() {
+	if (m_view != nullptr)
+		munmap(m_view, m_viewLength);
+	m_view = nullptr;
+	m_viewLength = 0;
+}
+
+#endif
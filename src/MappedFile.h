@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+// Read-only file mapping that keeps at most one view mapped at a time,
+// so files larger than the address space can be walked window by window.
+class MappedFile {
+#ifdef _WIN32
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+	uint64_t m_size = 0;
+	void* m_view = nullptr;
+	size_t m_viewLength = 0;
+
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+	MappedFile& operator =(const MappedFile&) = delete;
+	MappedFile& operator =(MappedFile&&) = delete;
+	~MappedFile();
+
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	uint64_t GetSize() const { return m_size; }
+
+	// Maps [offset, offset + length), replacing the previous view. Returns an empty view on failure.
+	std::string_view Map(uint64_t offset, size_t length);
+	void Unmap();
+};
@@ -0,0 +1,107 @@
+#include "MpcHcBackend.h"
+#include "MpcHcRemote.h"
+#include <Windows.h>
+#include <tuple>
+
+static std::wstring FormatSystemError(const DWORD dwMessageId) {
+	LPWSTR errorText = nullptr;
+	FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr,
+		dwMessageId,
+		MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+		reinterpret_cast<LPWSTR>(&errorText),
+		0,
+		nullptr);
+
+	std::wstring result = L"Could not open MPC-HC";
+	if (errorText) {
+		result += L": ";
+		result += errorText;
+		LocalFree(errorText);
+	}
+	return result;
+}
+
+MpcHcBackend::MpcHcBackend(const unsigned pollingInterval, const unsigned webServerPort, const std::filesystem::path& iniPath)
+	: m_pollingInterval(pollingInterval) {
+	if (iniPath.empty())
+		MpcHcRemote::SetSettingsProvider(std::make_shared<MpcHcRegistrySettings>());
+	else
+		MpcHcRemote::SetSettingsProvider(std::make_shared<MpcHcIniSettings>(iniPath));
+	MpcHcRemote::SetWebServerPort(webServerPort);
+}
+
+void MpcHcBackend::SetActive(const bool active) {
+	if (active && m_pollingInterval > 0)
+		MpcHcRemote::StartPolling(m_pollingInterval);
+	else
+		MpcHcRemote::PausePolling();
+}
+
+void MpcHcBackend::Shutdown() {
+	MpcHcRemote::StopCommandQueue();
+	MpcHcRemote::StopPolling();
+	MpcHcRemote::Disconnect();
+}
+
+void MpcHcBackend::SetFailureHandler(std::function<void()> handler) {
+	MpcHcRemote::SetCommandFailedHandler(std::move(handler));
+}
+
+int64_t MpcHcBackend::GetPositionAt(const std::chrono::steady_clock::time_point time) {
+	return MpcHcRemote::GetPlayerTimestampAt(time);
+}
+
+PlayerBackend::State MpcHcBackend::GetState() {
+	switch (MpcHcRemote::GetPlayerState()) {
+		case MpcHcRemote::PlayerState::PLAYING:
+			return State::PLAYING;
+		case MpcHcRemote::PlayerState::PAUSED:
+			return State::PAUSED;
+		default:
+			return State::STOPPED;
+	}
+}
+
+void MpcHcBackend::Seek(const int64_t position) {
+	MpcHcRemote::QueueSeek(position);
+}
+
+void MpcHcBackend::SeekBy(const int64_t delta) {
+	MpcHcRemote::QueueSeekBy(delta);
+}
+
+void MpcHcBackend::PlayPause() {
+	MpcHcRemote::QueueCommand(MpcHcRemote::MpcHcCommand::PLAY_PAUSE);
+}
+
+bool MpcHcBackend::CanOpen(std::wstring& error) {
+	bool found;
+	std::tie(found, error) = MpcHcRemote::GetInstallationPath();
+	return found;
+}
+
+bool MpcHcBackend::Open(const std::filesystem::path& mediaPath, std::wstring& error) {
+	bool found;
+	std::wstring mpcHcPath;
+	std::tie(found, mpcHcPath) = MpcHcRemote::GetInstallationPath();
+	if (!found) {
+		error = mpcHcPath;
+		return false;
+	}
+
+	STARTUPINFOW si;
+	PROCESS_INFORMATION pi;
+	ZeroMemory(&si, sizeof si);
+	ZeroMemory(&pi, sizeof pi);
+	si.cb = sizeof si;
+
+	// A running MPC-HC takes the file over from the new instance.
+	auto commandLine = L"\"" + mpcHcPath + L"\" \"" + mediaPath.wstring() + L"\"";
+	if (!CreateProcessW(mpcHcPath.c_str(), &commandLine[0], nullptr, nullptr, false, 0, nullptr, nullptr, &si, &pi)) {
+		error = FormatSystemError(GetLastError());
+		return false;
+	}
+	CloseHandle(pi.hProcess);
+	CloseHandle(pi.hThread);
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "PlayerBackend.h"
+
+// MPC-HC through its web interface; see MpcHcRemote.
+class MpcHcBackend : public PlayerBackend {
+	const unsigned m_pollingInterval;
+
+public:
+	// pollingInterval in ms; 0 asks the player on every use instead.
+	// webServerPort overrides the port MPC-HC stored in its settings unless 0.
+	// The settings are read from iniPath, the mpc-hc.ini of a portable MPC-HC, or from the registry if it is empty.
+	MpcHcBackend(unsigned pollingInterval, unsigned webServerPort, const std::filesystem::path& iniPath);
+
+	void SetActive(bool active) override;
+	void Shutdown() override;
+	void SetFailureHandler(std::function<void()> handler) override;
+
+	int64_t GetPositionAt(std::chrono::steady_clock::time_point time) override;
+	State GetState() override;
+
+	void Seek(int64_t position) override;
+	void SeekBy(int64_t delta) override;
+	void PlayPause() override;
+
+	bool CanOpen(std::wstring& error) override;
+	bool Open(const std::filesystem::path& mediaPath, std::wstring& error) override;
+};
@@ -1,107 +1,762 @@
 #include "MpcHcRemote.h"
-#include <regex>
-#include <WinSock2.h>
-#include <Windows.h>
+#include "MpcHcVariables.h"
 #include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <cinttypes>
+#include <cstring>
+#include <string_view>
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <Windows.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+const SOCKET INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+#define TEXT(text) text
+#endif
 
 namespace MpcHcRemote {
-	const std::regex POSITION_MATCHER("<p id=\"position\">([0-9]+)</p>");
 
-	std::pair<bool, std::string> GetRequest(const std::string &request) {
-		sockaddr_in localhost{};
-		ZeroMemory(&localhost, sizeof localhost);
-		std::string s;
-		char buf[65536];
-		DWORD port = 0, len = 4;
+	// Takes the response body a piece at a time; returns false once it needs no more.
+	typedef std::function<bool(std::string_view)> BodyHandler;
 
-		if (NULL != RegGetValue(HKEY_CURRENT_USER, TEXT("Software\\MPC-HC\\MPC-HC\\Settings"), TEXT("WebServerPort"), 0x00010000 | RRF_RT_REG_DWORD, NULL, &port, &len) || port == 0) {
-			return std::make_pair(false, "");
-		}
+	// Loopback connects are immediate when the player is there; Windows retries a refused one for seconds otherwise.
+	const auto CONNECT_TIMEOUT = std::chrono::milliseconds(200);
+	const auto RECEIVE_TIMEOUT = std::chrono::milliseconds(2000);
+	// After a request fails, further ones fail at once for this long.
+	const auto PLAYER_DOWN_INTERVAL = std::chrono::milliseconds(1000);
+
+	// Connection to the web server kept open between requests; reopened when the server drops it.
+	// Guarded by requestMutex, as the poller thread sends requests too.
+	static std::mutex requestMutex;
+	static SOCKET connection = INVALID_SOCKET;
+	static unsigned connectionPort = 0;
+	static std::chrono::steady_clock::time_point playerDownUntil;
+
+#ifdef _WIN32
+	static void CloseSocket(const SOCKET s) {
+		closesocket(s);
+	}
+
+	static void SetNonBlocking(const SOCKET s, const bool nonBlocking) {
+		u_long value = nonBlocking;
+		ioctlsocket(s, FIONBIO, &value);
+	}
+
+	static bool IsConnectPending() {
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+	}
+
+	static bool IsReceiveTimeout() {
+		return WSAGetLastError() == WSAETIMEDOUT;
+	}
+
+	static void SetReceiveTimeout(const SOCKET s, const std::chrono::milliseconds timeout) {
+		const auto value = static_cast<DWORD>(timeout.count());
+		setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&value), sizeof value);
+	}
 
+	const int SEND_FLAGS = 0;
+#else
+	static void CloseSocket(const SOCKET s) {
+		close(s);
+	}
+
+	static void SetNonBlocking(const SOCKET s, const bool nonBlocking) {
+		const auto flags = fcntl(s, F_GETFL);
+		fcntl(s, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+	}
+
+	static bool IsConnectPending() {
+		return errno == EINPROGRESS;
+	}
+
+	static bool IsReceiveTimeout() {
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+	}
+
+	static void SetReceiveTimeout(const SOCKET s, const std::chrono::milliseconds timeout) {
+		timeval value{ static_cast<time_t>(timeout.count() / 1000), static_cast<suseconds_t>(timeout.count() % 1000 * 1000) };
+		setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof value);
+	}
+
+	// A server that has closed the connection must fail the send, not raise SIGPIPE in the host process.
+	const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+	static void CloseConnection() {
+		if (connection == INVALID_SOCKET)
+			return;
+		CloseSocket(connection);
+		connection = INVALID_SOCKET;
+	}
+
+	static bool Connect(const unsigned port) {
+		sockaddr_in localhost{};
 		localhost.sin_family = AF_INET;
 		localhost.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-		localhost.sin_port = htons(static_cast<u_short>(port));
+		localhost.sin_port = htons(static_cast<uint16_t>(port));
+
+		connection = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (connection == INVALID_SOCKET)
+			return false;
+
+		// Connect without blocking, and give up once the budget is spent.
+		SetNonBlocking(connection, true);
+		if (connect(connection, reinterpret_cast<struct sockaddr*>(&localhost), sizeof localhost) == SOCKET_ERROR) {
+			if (!IsConnectPending()) {
+				CloseConnection();
+				return false;
+			}
+
+			fd_set writable, failed;
+			FD_ZERO(&writable);
+			FD_ZERO(&failed);
+			FD_SET(connection, &writable);
+			FD_SET(connection, &failed);
+			timeval budget{ 0, static_cast<long>(std::chrono::microseconds(CONNECT_TIMEOUT).count()) };
+			int error = 0;
+			socklen_t errorLength = sizeof error;
+			if (select(static_cast<int>(connection + 1), nullptr, &writable, &failed, &budget) != 1 || !FD_ISSET(connection, &writable)
+				|| getsockopt(connection, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorLength) == SOCKET_ERROR || error != 0) {
+				CloseConnection();
+				return false;
+			}
+		}
+		SetNonBlocking(connection, false);
+
+		// A player that accepts but never answers must not hold the caller forever either.
+		SetReceiveTimeout(connection, RECEIVE_TIMEOUT);
 
-		auto connectSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-		if (connectSocket == INVALID_SOCKET) {
-			return std::make_pair(false, "");
+		// Requests are small and answered one at a time; do not hold them back waiting for more data.
+		int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof noDelay);
+		connectionPort = port;
+		return true;
+	}
+
+	// An idle connection should have nothing to read; if it does, the server has closed it or sent something unexpected.
+	static bool IsConnectionStale() {
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(connection, &readable);
+		timeval noWait{};
+		return select(static_cast<int>(connection + 1), &readable, nullptr, nullptr, &noWait) != 0;
+	}
+
+	// Receive buffer of the connection. A response goes through it a piece at a time, so only a
+	// header line has to fit at once; the body is handed on as it arrives.
+	static char receiveBuffer[4096];
+	static size_t receiveBegin = 0, receiveEnd = 0;
+	// Whether the last Receive failed because the server did not answer in time, rather than closing the connection.
+	static bool receiveTimedOut = false;
+
+	// A body the handler has had enough of is still read off the connection up to this many bytes,
+	// as reconnecting costs more than that; a longer one is cut off by closing the connection.
+	const uint64_t DRAIN_LIMIT = 65536;
+
+	static std::string_view Pending() {
+		return std::string_view(receiveBuffer + receiveBegin, receiveEnd - receiveBegin);
+	}
+
+	static bool Receive() {
+		if (receiveBegin == receiveEnd)
+			receiveBegin = receiveEnd = 0;
+		else if (receiveEnd == sizeof receiveBuffer) {
+			if (receiveBegin == 0)
+				return false; // A line longer than the buffer.
+			memmove(receiveBuffer, receiveBuffer + receiveBegin, receiveEnd - receiveBegin);
+			receiveEnd -= receiveBegin;
+			receiveBegin = 0;
 		}
-		if (connect(connectSocket, reinterpret_cast<struct sockaddr*>(&localhost), sizeof localhost) == SOCKET_ERROR) {
-			closesocket(connectSocket);
-			connectSocket = INVALID_SOCKET;
+		const auto readBytes = recv(connection, receiveBuffer + receiveEnd, static_cast<int>(sizeof receiveBuffer - receiveEnd), 0);
+		if (readBytes <= 0) {
+			receiveTimedOut = readBytes < 0 && IsReceiveTimeout();
+			return false;
 		}
-		if (connectSocket == INVALID_SOCKET)
-			return std::make_pair(false, "");
-		if (SOCKET_ERROR == send(connectSocket, request.c_str(), static_cast<int>(request.size()), 0)) {
-			closesocket(connectSocket);
-			return std::make_pair(false, "");
+		receiveEnd += static_cast<size_t>(readBytes);
+		return true;
+	}
+
+	// The line stays valid until the next Receive.
+	static bool ReadLine(std::string_view &line) {
+		size_t searchFrom = 0;
+		while (true) {
+			const auto pending = Pending();
+			const auto lineEnd = pending.find("\r\n", searchFrom);
+			if (lineEnd != std::string_view::npos) {
+				line = pending.substr(0, lineEnd);
+				receiveBegin += lineEnd + 2;
+				return true;
+			}
+			searchFrom = pending.empty() ? 0 : pending.size() - 1;
+			if (!Receive())
+				return false;
 		}
-		if (shutdown(connectSocket, SD_SEND) == SOCKET_ERROR) {
-			closesocket(connectSocket);
-			return std::make_pair(false, "");
+	}
+
+	static bool EqualsIgnoreCase(const std::string_view text, const std::string_view lowercase) {
+		if (text.size() != lowercase.size())
+			return false;
+		for (size_t i = 0; i < text.size(); ++i)
+			if (tolower(static_cast<unsigned char>(text[i])) != lowercase[i])
+				return false;
+		return true;
+	}
+
+	static bool ContainsIgnoreCase(const std::string_view text, const std::string_view lowercase) {
+		for (size_t i = 0; i + lowercase.size() <= text.size(); ++i)
+			if (EqualsIgnoreCase(text.substr(i, lowercase.size()), lowercase))
+				return true;
+		return false;
+	}
+
+	static uint64_t ParseUnsigned(const std::string_view text, const int base) {
+		uint64_t value = 0;
+		for (const auto c : text) {
+			int digit;
+			if (c >= '0' && c <= '9')
+				digit = c - '0';
+			else if (base == 16 && c >= 'a' && c <= 'f')
+				digit = c - 'a' + 10;
+			else if (base == 16 && c >= 'A' && c <= 'F')
+				digit = c - 'A' + 10;
+			else if (c == ' ' || c == '\t')
+				continue;
+			else
+				break;
+			value = value * base + digit;
+		}
+		return value;
+	}
+
+	// Hands length bytes of body to onBody as they arrive, or fewer if the connection closes first and
+	// untilClose is set. Once onBody returns false, the rest is only read off the connection, or left
+	// unread if it is longer than DRAIN_LIMIT, which leaves the connection unusable.
+	static bool ReadBody(uint64_t length, const bool untilClose, const BodyHandler &onBody, bool &stopped, bool &complete) {
+		complete = false;
+		while (length > 0) {
+			if (stopped && (untilClose || length > DRAIN_LIMIT))
+				return true;
+			if (receiveBegin == receiveEnd && !Receive()) {
+				complete = untilClose;
+				return untilClose;
+			}
+			const auto piece = Pending().substr(0, static_cast<size_t>(std::min<uint64_t>(length, receiveEnd - receiveBegin)));
+			receiveBegin += piece.size();
+			length -= piece.size();
+			if (!stopped && !onBody(piece))
+				stopped = true;
 		}
+		complete = true;
+		return true;
+	}
+
+	// Reads one response off the connection and returns its status code, or 0 if it could not be read.
+	// The body of a 2xx response goes to onBody; it ends at Content-Length, at the last chunk, or where the server
+	// closes the connection. receivedAny tells whether anything came back at all, so that a dropped idle connection can be retried.
+	static int ReadResponse(const BodyHandler &onBody, bool &keepAlive, bool &receivedAny) {
+		// Requests are never pipelined, so nothing of an earlier response is left.
+		receiveBegin = receiveEnd = 0;
+		receiveTimedOut = false;
 
+		std::string_view line;
+		const auto gotStatusLine = ReadLine(line);
+		receivedAny = receiveEnd != 0;
+		if (!gotStatusLine || line.size() < 12 || line.compare(0, 5, "HTTP/") != 0)
+			return 0;
+		keepAlive = line.compare(0, 8, "HTTP/1.0") != 0;
+		const auto status = static_cast<int>(ParseUnsigned(line.substr(9, 3), 10));
+		if (status < 200 || status > 599)
+			return 0;
 
-		// Receive data until the server closes the connection
-		do {
-			const auto readBytes = recv(connectSocket, buf, sizeof buf, 0);
-			if (readBytes <= 0)
+		auto chunked = false;
+		auto contentLength = UINT64_MAX;
+		while (true) {
+			if (!ReadLine(line))
+				return 0;
+			if (line.empty())
 				break;
-			s.append(buf, readBytes);
-		} while (true);
-		closesocket(connectSocket);
-		return std::make_pair(true, s);
+
+			const auto colon = line.find(':');
+			if (colon == std::string_view::npos)
+				continue;
+			const auto name = line.substr(0, colon);
+			const auto value = line.substr(colon + 1);
+			if (EqualsIgnoreCase(name, "content-length"))
+				contentLength = ParseUnsigned(value, 10);
+			else if (EqualsIgnoreCase(name, "transfer-encoding"))
+				chunked = ContainsIgnoreCase(value, "chunked");
+			else if (EqualsIgnoreCase(name, "connection"))
+				keepAlive = ContainsIgnoreCase(value, "keep-alive") || (keepAlive && !ContainsIgnoreCase(value, "close"));
+		}
+
+		// Only a successful response has a body worth looking at.
+		const BodyHandler discard = [](std::string_view) { return true; };
+		const auto &handler = status / 100 == 2 ? onBody : discard;
+		auto stopped = false, complete = false;
+		if (status == 204 || status == 304) {
+			complete = true;
+		} else if (chunked) {
+			complete = true;
+			while (true) {
+				if (!ReadLine(line))
+					return 0;
+				const auto chunkSize = ParseUnsigned(line, 16);
+				if (chunkSize == 0)
+					break;
+				if (!ReadBody(chunkSize, false, handler, stopped, complete))
+					return 0;
+				if (!complete)
+					break;
+				if (!ReadLine(line) || !line.empty())
+					return 0;
+			}
+
+			// Skip trailers up to the empty line.
+			while (complete) {
+				if (!ReadLine(line))
+					return 0;
+				if (line.empty())
+					break;
+			}
+		} else if (contentLength != UINT64_MAX) {
+			if (!ReadBody(contentLength, false, handler, stopped, complete))
+				return 0;
+		} else {
+			// No framing; the body runs until the server closes the connection.
+			ReadBody(UINT64_MAX, true, handler, stopped, complete);
+			keepAlive = false;
+		}
+
+		// Anything left over means the connection is out of step.
+		if (!complete || receiveBegin != receiveEnd)
+			keepAlive = false;
+		return status;
 	}
 
-	int64_t GetCurrentPlayerTimestamp() {
-		bool result;
-		std::string response;
-		std::tie(result, response) = GetRequest("GET /variables.html HTTP/1.1\r\n\r\n");
-		if (!result)
+	static std::shared_ptr<MpcHcSettingsProvider> settingsProvider;
+	static std::atomic<unsigned> webServerPortOverride{ 0 };
+
+	void SetSettingsProvider(std::shared_ptr<MpcHcSettingsProvider> provider) {
+		std::atomic_store(&settingsProvider, std::move(provider));
+	}
+
+	void SetWebServerPort(const unsigned port) {
+		webServerPortOverride = port;
+
+		// Whatever was down, it was on the other port.
+		std::lock_guard<std::mutex> lock(requestMutex);
+		playerDownUntil = {};
+	}
+
+	// Expects requestMutex to be held. Returns the status code, or 0 if the server could not be reached.
+	static int SendRequest(const std::string_view request, const BodyHandler &onBody) {
+		unsigned port = webServerPortOverride;
+		if (port == 0) {
+			if (const auto provider = std::atomic_load(&settingsProvider))
+				port = provider->GetWebServerPort();
+			if (port == 0)
+				return 0;
+		}
+
+		if (connection != INVALID_SOCKET && (connectionPort != port || IsConnectionStale()))
+			CloseConnection();
+
+		// A reused connection may have been closed by the server just now; try once more on a new one
+		// if nothing came back. A server that is there but does not answer in time is not given another
+		// receive timeout. Nothing is retried once the server has started answering, and a command is
+		// retried only if it was not sent: the server may have carried it out before dropping the connection.
+		const auto idempotent = request.compare(0, 4, "GET ") == 0;
+		for (auto attempt = 0; attempt < 2; ++attempt) {
+			const auto reusing = connection != INVALID_SOCKET;
+			if (!reusing && !Connect(port))
+				return 0;
+
+			auto keepAlive = false, receivedAny = false;
+			const auto sent = SOCKET_ERROR != send(connection, request.data(), static_cast<int>(request.size()), SEND_FLAGS);
+			if (sent) {
+				if (const auto status = ReadResponse(onBody, keepAlive, receivedAny)) {
+					if (!keepAlive)
+						CloseConnection();
+					return status;
+				}
+			}
+
+			CloseConnection();
+			if (!reusing || receivedAny || receiveTimedOut || (sent && !idempotent))
+				break;
+		}
+		return 0;
+	}
+
+	// Whether the server answered with a 2xx status. onBody is given the body a piece at a time and may return false to stop early.
+	static bool GetRequest(const std::string_view request, const BodyHandler &onBody) {
+		std::lock_guard<std::mutex> lock(requestMutex);
+
+		// While the player is known to be down, do not make every caller wait to find out again.
+		if (std::chrono::steady_clock::now() < playerDownUntil)
+			return false;
+
+		const auto status = SendRequest(request, onBody);
+		if (status == 0)
+			playerDownUntil = std::chrono::steady_clock::now() + PLAYER_DOWN_INTERVAL;
+		return status / 100 == 2;
+	}
+
+	bool GetVariables(MpcHcVariables::PlayerVariables &variables, const uint32_t required) {
+		// Parsed as each piece arrives, so that the rest of the page is not waited for once the required fields are in.
+		MpcHcVariables::Parser parser(variables, required);
+		auto complete = false;
+		const auto result = GetRequest("GET /variables.html HTTP/1.1\r\nHost: localhost\r\n\r\n", [&](const std::string_view piece) {
+			complete = parser.Append(piece);
+			return !complete;
+		});
+		return result && complete;
+	}
+
+	// Formats a form POST to /command.html into request; form is at most a few dozen bytes.
+	static std::string_view MakeCommandRequest(char (&request)[256], const char *form) {
+		const auto length = snprintf(request, sizeof request, "POST /command.html HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: %zu\r\n\r\n%s", strlen(form), form);
+		return std::string_view(request, static_cast<size_t>(std::clamp<int>(length, 0, sizeof request - 1)));
+	}
+
+	// The answer to a command is the whole player page, which is of no use here.
+	const BodyHandler IGNORE_BODY = [](std::string_view) { return false; };
+
+	// Player position as of a point in time.
+	struct Sample {
+		int64_t position = -1;
+		int64_t duration = -1;
+		PlayerState state = PlayerState::STOPPED;
+		double playbackRate = 1.0;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	static bool QuerySample(Sample &sample) {
+		using namespace MpcHcVariables;
+		const auto requestTime = std::chrono::steady_clock::now();
+
+		// All four are asked for so that the page is read on to the playback rate, which comes late in it;
+		// older versions do not report the rate, so only the position has to be found.
+		PlayerVariables variables;
+		GetVariables(variables, FIELD_STATE | FIELD_POSITION | FIELD_DURATION | FIELD_PLAYBACK_RATE);
+		if (!(variables.found & FIELD_POSITION))
+			return false;
+		sample.position = variables.position;
+		sample.duration = variables.duration;
+		sample.state = static_cast<PlayerState>(variables.state);
+		sample.playbackRate = variables.playbackRate;
+
+		// The position was read somewhere within the round trip; assume halfway.
+		sample.time = requestTime + (std::chrono::steady_clock::now() - requestTime) / 2;
+		return true;
+	}
+
+	// Latest sample taken by the poller. sampleGeneration is bumped whenever a command makes the
+	// sample obsolete, so that a poll already in flight does not store what it read before the command.
+	static std::mutex sampleMutex;
+	static Sample latestSample;
+	static bool hasSample = false;
+	static uint64_t sampleGeneration = 0;
+
+	static void InvalidateSample() {
+		std::lock_guard<std::mutex> lock(sampleMutex);
+		hasSample = false;
+		++sampleGeneration;
+	}
+
+	// After a seek the player may take a while to report the new position; carry on from the target meanwhile.
+	static void MoveSample(const int64_t position) {
+		std::lock_guard<std::mutex> lock(sampleMutex);
+		latestSample.position = position;
+		latestSample.time = std::chrono::steady_clock::now();
+		++sampleGeneration;
+	}
+
+	static std::mutex pollerMutex;
+	static std::condition_variable pollerWake;
+	static std::thread poller;
+	// Read by GetSample under sampleMutex rather than pollerMutex, so not guarded by either.
+	static std::atomic<int64_t> pollIntervalMs{ 0 };
+	static bool stopPoller = false;
+	static bool pollerPaused = false;
+
+	static void PollerMain() {
+		std::unique_lock<std::mutex> lock(pollerMutex);
+		while (!stopPoller) {
+			if (pollerPaused) {
+				pollerWake.wait(lock, [] { return stopPoller || !pollerPaused; });
+				continue;
+			}
+			lock.unlock();
+
+			uint64_t generation;
+			{
+				std::lock_guard<std::mutex> sampleLock(sampleMutex);
+				generation = sampleGeneration;
+			}
+			Sample sample;
+			const auto result = QuerySample(sample);
+			{
+				std::lock_guard<std::mutex> sampleLock(sampleMutex);
+				if (generation == sampleGeneration) {
+					latestSample = sample;
+					hasSample = result;
+				}
+			}
+
+			lock.lock();
+			// Woken when the interval changes as well, so that a shorter one applies to this wait already.
+			const auto polled = std::chrono::steady_clock::now();
+			while (!stopPoller && !pollerPaused && std::chrono::steady_clock::now() < polled + std::chrono::milliseconds(pollIntervalMs.load()))
+				pollerWake.wait_until(lock, polled + std::chrono::milliseconds(pollIntervalMs.load()));
+		}
+	}
+
+	void StartPolling(const unsigned intervalMs) {
+		{
+			std::lock_guard<std::mutex> lock(pollerMutex);
+			pollIntervalMs = intervalMs;
+			pollerPaused = false;
+			if (!poller.joinable()) {
+				stopPoller = false;
+				poller = std::thread(PollerMain);
+			}
+		}
+		pollerWake.notify_all();
+	}
+
+	void PausePolling() {
+		{
+			std::lock_guard<std::mutex> lock(pollerMutex);
+			if (!poller.joinable() || pollerPaused)
+				return;
+			pollerPaused = true;
+		}
+		pollerWake.notify_all();
+		// A poll still in flight is not waited for; it finds its sample obsolete.
+		InvalidateSample();
+	}
+
+	void StopPolling() {
+		{
+			std::lock_guard<std::mutex> lock(pollerMutex);
+			if (!poller.joinable())
+				return;
+			stopPoller = true;
+		}
+		pollerWake.notify_all();
+		poller.join();
+		InvalidateSample();
+	}
+
+	// The poller's sample if it is fresh, or a new one from the player.
+	static bool GetSample(Sample &sample) {
+		{
+			std::lock_guard<std::mutex> lock(sampleMutex);
+
+			// Trust the poller only while it keeps up; a sample much older than the interval means it is stuck on the player.
+			const auto maxAge = std::max<std::chrono::steady_clock::duration>(3 * std::chrono::milliseconds(pollIntervalMs.load()), std::chrono::milliseconds(500));
+			if (hasSample && std::chrono::steady_clock::now() - latestSample.time < maxAge) {
+				sample = latestSample;
+				return true;
+			}
+		}
+		return QuerySample(sample);
+	}
+
+	PlayerState GetPlayerState() {
+		Sample sample;
+		return GetSample(sample) ? sample.state : PlayerState::STOPPED;
+	}
+
+	int64_t GetPlayerTimestampAt(const std::chrono::steady_clock::time_point time) {
+		Sample sample;
+		if (!GetSample(sample))
 			return -1;
 
-		std::smatch m;
-		int64_t pos = -1;
-		if (std::regex_search(response, m, POSITION_MATCHER))
-			pos = strtoll(m[1].str().c_str(), nullptr, 10);
-		return pos;
+		if (sample.state != PlayerState::PLAYING)
+			return sample.position;
+		const auto elapsed = std::chrono::duration<double, std::milli>(time - sample.time).count() * sample.playbackRate;
+		auto position = std::max<int64_t>(0, sample.position + static_cast<int64_t>(elapsed));
+		if (sample.duration > 0)
+			position = std::min(position, sample.duration);
+		return position;
+	}
+
+	int64_t GetCurrentPlayerTimestamp() {
+		return GetPlayerTimestampAt(std::chrono::steady_clock::now());
 	}
 
 	bool SendCommand(const MpcHcCommand cmd) {
-		char req[65536], req2[1024];
-		snprintf(req2, sizeof req2, "wm_command=%d", static_cast<int>(cmd));
-		snprintf(req, sizeof req, "POST /command.html HTTP/1.1\r\nConnection: Close\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: %zu\r\n\r\n%s", strlen(req2), req2);
+		char form[32], request[256];
+		snprintf(form, sizeof form, "wm_command=%d", static_cast<int>(cmd));
 
-		bool result;
-		std::string response;
-		std::tie(result, response) = GetRequest(req);
+		const auto result = GetRequest(MakeCommandRequest(request, form), IGNORE_BODY);
+		InvalidateSample();
 		return result;
 	}
 
 	bool Seek(const int64_t position) {
-		char req[65536], req2[1024];
-		snprintf(req2, sizeof req2, "wm_command=-1&position=%" PRId64 ":%" PRId64 ":%" PRId64 ":%" PRId64 "", position / 3600000, position / 60000 % 60, position / 1000 % 60, position % 1000);
-		snprintf(req, sizeof req, "POST /command.html HTTP/1.1\r\nConnection: Close\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: %zu\r\n\r\n%s", strlen(req2), req2);
+		char form[128], request[256];
+		snprintf(form, sizeof form, "wm_command=-1&position=%" PRId64 ":%" PRId64 ":%" PRId64 ":%" PRId64 "", position / 3600000, position / 60000 % 60, position / 1000 % 60, position % 1000);
 
-		bool result;
-		std::string response;
-		std::tie(result, response) = GetRequest(req);
+		const auto result = GetRequest(MakeCommandRequest(request, form), IGNORE_BODY);
+		if (result)
+			MoveSample(position);
+		else
+			InvalidateSample();
 		return result;
 	}
 
+	// Commands waiting for the worker thread, oldest first.
+	struct QueuedCommand {
+		enum class Type {
+			SEEK,
+			SEEK_BY,
+			COMMAND
+		} type;
+		int64_t value;
+	};
+
+	static std::mutex queueMutex;
+	static std::condition_variable queueWake;
+	static std::deque<QueuedCommand> commandQueue;
+	static std::thread commandWorker;
+	static bool stopCommandWorker = false;
+	static std::function<void()> commandFailedHandler;
+
+	static void CommandWorkerMain() {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		while (true) {
+			queueWake.wait(lock, [] { return stopCommandWorker || !commandQueue.empty(); });
+			if (stopCommandWorker)
+				break;
+			const auto command = commandQueue.front();
+			commandQueue.pop_front();
+			lock.unlock();
+
+			auto result = false;
+			switch (command.type) {
+				case QueuedCommand::Type::SEEK:
+					result = Seek(command.value);
+					break;
+
+				case QueuedCommand::Type::SEEK_BY:
+				{
+					// Resolved only now, so that it starts from where the seeks before it went.
+					const auto time = GetCurrentPlayerTimestamp();
+					result = time != -1 && Seek(std::max<int64_t>(0, time + command.value));
+					break;
+				}
+
+				case QueuedCommand::Type::COMMAND:
+					result = SendCommand(static_cast<MpcHcCommand>(command.value));
+					break;
+			}
+
+			lock.lock();
+			if (!result) {
+				// The rest would most likely fail the same way.
+				commandQueue.clear();
+				const auto handler = commandFailedHandler;
+				lock.unlock();
+				if (handler)
+					handler();
+				lock.lock();
+			}
+		}
+	}
+
+	static void Enqueue(const QueuedCommand command) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			auto merged = false;
+			if (!commandQueue.empty() && command.type != QueuedCommand::Type::COMMAND) {
+				auto &last = commandQueue.back();
+				if (command.type == QueuedCommand::Type::SEEK && last.type != QueuedCommand::Type::COMMAND) {
+					last = command;
+					merged = true;
+				} else if (command.type == QueuedCommand::Type::SEEK_BY && last.type != QueuedCommand::Type::COMMAND) {
+					last.value = last.type == QueuedCommand::Type::SEEK ? std::max<int64_t>(0, last.value + command.value) : last.value + command.value;
+					merged = true;
+				}
+			}
+			if (!merged)
+				commandQueue.push_back(command);
+
+			if (!commandWorker.joinable()) {
+				stopCommandWorker = false;
+				commandWorker = std::thread(CommandWorkerMain);
+			}
+		}
+		queueWake.notify_one();
+	}
+
+	void QueueSeek(const int64_t position) {
+		Enqueue({ QueuedCommand::Type::SEEK, position });
+	}
+
+	void QueueSeekBy(const int64_t delta) {
+		Enqueue({ QueuedCommand::Type::SEEK_BY, delta });
+	}
+
+	void QueueCommand(const MpcHcCommand cmd) {
+		Enqueue({ QueuedCommand::Type::COMMAND, static_cast<int64_t>(cmd) });
+	}
+
+	void SetCommandFailedHandler(std::function<void()> handler) {
+		std::lock_guard<std::mutex> lock(queueMutex);
+		commandFailedHandler = std::move(handler);
+	}
+
+	void StopCommandQueue() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (!commandWorker.joinable())
+				return;
+			stopCommandWorker = true;
+			commandQueue.clear();
+		}
+		queueWake.notify_all();
+		commandWorker.join();
+	}
+
+	void Disconnect() {
+		std::lock_guard<std::mutex> lock(requestMutex);
+		CloseConnection();
+	}
+
 	std::tuple<bool, SSTRING> GetInstallationPath() {
-		TCHAR szMpcHcPath[MAX_PATH];
-		DWORD len = MAX_PATH;
-		DWORD res = 0;
+		const auto provider = std::atomic_load(&settingsProvider);
+		const auto settings = provider ? provider->Get() : MpcHcSettings();
 
-		if (NULL != RegGetValue(HKEY_CURRENT_USER, TEXT("Software\\MPC-HC\\MPC-HC"), TEXT("ExePath"), 0x00010000 | RRF_RT_REG_SZ, nullptr, &szMpcHcPath, &len)) {
-			return std::make_tuple(false, TEXT("MPC-HC not found."));
+		if (settings.exePath.empty()) {
+			return std::make_tuple(false, SSTRING(TEXT("MPC-HC not found.")));
 		}
-		if (NULL != RegGetValue(HKEY_CURRENT_USER, TEXT("Software\\MPC-HC\\MPC-HC\\Settings"), TEXT("EnableWebServer"), 0x00010000 | RRF_RT_REG_DWORD, nullptr, &res, &len) || res == 0) {
-			return std::make_tuple(false, TEXT("Web Server feature of MPC-HC is inactive."));
+		if (!settings.webServerEnabled) {
+			return std::make_tuple(false, SSTRING(TEXT("Web Server feature of MPC-HC is inactive.")));
 		}
-		return std::make_tuple(true, szMpcHcPath);
+		return std::make_tuple(true, settings.exePath.native());
 	}
 
 }
@@ -1,6 +1,11 @@
 #pragma once
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include "MpcHcSettings.h"
+#include "MpcHcVariables.h"
 
 #ifdef UNICODE
 typedef std::wstring SSTRING;
@@ -13,9 +18,52 @@ namespace MpcHcRemote {
 		PLAY_PAUSE = 889
 	};
 
+	enum class PlayerState : int {
+		STOPPED = 0,
+		PAUSED = 1,
+		PLAYING = 2
+	};
+
+	// Where the web interface port and the installation path are read from. Without one, MPC-HC is not found.
+	void SetSettingsProvider(std::shared_ptr<MpcHcSettingsProvider> provider);
+	// Connects to port instead of the one in the settings; 0 goes back to the settings.
+	// A stand-in server can be used this way. Also forgets that the player was found down.
+	void SetWebServerPort(unsigned port);
+
+	// Polls the player every intervalMs on a background thread, so that GetCurrentPlayerTimestamp
+	// can answer from the latest sample without a request of its own. Calling again changes the interval at once, or resumes polling after PausePolling.
+	void StartPolling(unsigned intervalMs);
+	// Stops polling without waiting for a request in flight, so that it can be called on the UI thread.
+	// The poller thread stays, waiting for StartPolling.
+	void PausePolling();
+	// Must be called before the DLL is unloaded; the poller thread cannot be joined under the loader lock.
+	void StopPolling();
+
+	// Fetches /variables.html; see MpcHcVariables::Parse for required.
+	bool GetVariables(MpcHcVariables::PlayerVariables &variables, uint32_t required = MpcHcVariables::ALL_FIELDS);
+
+	// While polling, extrapolated from the latest sample if the player is playing; otherwise asked from the player.
 	int64_t GetCurrentPlayerTimestamp();
+	// Stopped as well if the player cannot be reached.
+	PlayerState GetPlayerState();
+	// Position the player had, or will have, at time, assuming it keeps playing at its current rate.
+	int64_t GetPlayerTimestampAt(std::chrono::steady_clock::time_point time);
 	bool SendCommand(MpcHcCommand cmd);
 	bool Seek(int64_t position);
 	std::tuple<bool, SSTRING> GetInstallationPath();
+
+	// Sent in order from a worker thread, so that the caller does not wait for the player.
+	// A seek still waiting in the queue is merged with the one queued after it: a later absolute seek
+	// replaces it, and relative seeks add up. Relative seeks start from the position at the time they are sent.
+	void QueueSeek(int64_t position);
+	void QueueSeekBy(int64_t delta);
+	void QueueCommand(MpcHcCommand cmd);
+	// Called on the worker thread when a queued command fails; the commands still waiting are dropped.
+	void SetCommandFailedHandler(std::function<void()> handler);
+	// Like StopPolling, must be called before the DLL is unloaded.
+	void StopCommandQueue();
+
+	// Closes the connection kept open to the web server, if any. Call before WSACleanup.
+	void Disconnect();
 };
 
@@ -0,0 +1,195 @@
+#include "MpcHcSettings.h"
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+static const std::chrono::milliseconds RECHECK_INTERVAL(1000);
+
+const MpcHcSettings& MpcHcSettingsProvider::Refresh() {
+	if (!m_loaded || HasChanged()) {
+		m_settings = Load();
+		m_loaded = true;
+	}
+	return m_settings;
+}
+
+MpcHcSettings MpcHcSettingsProvider::Get() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return Refresh();
+}
+
+unsigned MpcHcSettingsProvider::GetWebServerPort() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return Refresh().webServerPort;
+}
+
+#ifdef _WIN32
+
+#ifndef REG_NOTIFY_THREAD_AGNOSTIC
+#define REG_NOTIFY_THREAD_AGNOSTIC 0x10000000L
+#endif
+
+MpcHcRegistrySettings::MpcHcRegistrySettings()
+	: m_hChanged(CreateEventW(nullptr, FALSE, FALSE, nullptr)) {
+}
+
+MpcHcRegistrySettings::~MpcHcRegistrySettings() {
+	if (m_hKey)
+		RegCloseKey(static_cast<HKEY>(m_hKey));
+	if (m_hChanged)
+		CloseHandle(m_hChanged);
+}
+
+bool MpcHcRegistrySettings::Watch() {
+	const DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET;
+
+	// Without REG_NOTIFY_THREAD_AGNOSTIC, which needs Windows 8, the watch ends with the calling thread,
+	// which signals the event; the only cost is reading the settings once more.
+	const auto key = static_cast<HKEY>(m_hKey);
+	return ERROR_SUCCESS == RegNotifyChangeKeyValue(key, TRUE, filter | REG_NOTIFY_THREAD_AGNOSTIC, m_hChanged, TRUE)
+		|| ERROR_SUCCESS == RegNotifyChangeKeyValue(key, TRUE, filter, m_hChanged, TRUE);
+}
+
+bool MpcHcRegistrySettings::HasChanged() {
+	if (m_hKey)
+		return WAIT_OBJECT_0 == WaitForSingleObject(m_hChanged, 0);
+	return std::chrono::steady_clock::now() - m_lastOpenAttempt >= RECHECK_INTERVAL;
+}
+
+MpcHcSettings MpcHcRegistrySettings::Load() {
+	MpcHcSettings settings;
+
+	if (!m_hKey) {
+		m_lastOpenAttempt = std::chrono::steady_clock::now();
+		HKEY key;
+		if (ERROR_SUCCESS != RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\MPC-HC\\MPC-HC", 0, KEY_READ | KEY_NOTIFY, &key))
+			return settings;
+		m_hKey = key;
+	}
+
+	// Watched before reading, so that a change made while reading is not missed.
+	const auto watching = m_hChanged && Watch();
+	const auto key = static_cast<HKEY>(m_hKey);
+
+	WCHAR exePath[MAX_PATH];
+	DWORD len = sizeof exePath;
+	if (ERROR_SUCCESS == RegGetValueW(key, nullptr, L"ExePath", RRF_RT_REG_SZ | RRF_SUBKEY_WOW6464KEY, nullptr, exePath, &len))
+		settings.exePath = exePath;
+
+	DWORD value = 0;
+	len = sizeof value;
+	if (ERROR_SUCCESS == RegGetValueW(key, L"Settings", L"EnableWebServer", RRF_RT_REG_DWORD | RRF_SUBKEY_WOW6464KEY, nullptr, &value, &len))
+		settings.webServerEnabled = value != 0;
+
+	value = 0;
+	len = sizeof value;
+	if (ERROR_SUCCESS == RegGetValueW(key, L"Settings", L"WebServerPort", RRF_RT_REG_DWORD | RRF_SUBKEY_WOW6464KEY, nullptr, &value, &len))
+		settings.webServerPort = value;
+
+	// Read once more after a second, as if the key had not been there.
+	if (!watching) {
+		RegCloseKey(key);
+		m_hKey = nullptr;
+		m_lastOpenAttempt = std::chrono::steady_clock::now();
+	}
+	return settings;
+}
+
+#endif
+
+MpcHcIniSettings::MpcHcIniSettings(std::filesystem::path path)
+	: m_path(std::move(path)) {
+}
+
+bool MpcHcIniSettings::HasChanged() {
+	const auto now = std::chrono::steady_clock::now();
+	if (now - m_lastCheck < RECHECK_INTERVAL)
+		return false;
+	m_lastCheck = now;
+
+	std::error_code ec;
+	return std::filesystem::last_write_time(m_path, ec) != m_loadedWriteTime;
+}
+
+static bool EqualsIgnoreCase(const std::string_view a, const std::string_view b) {
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		auto x = a[i], y = b[i];
+		if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+		if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+		if (x != y)
+			return false;
+	}
+	return true;
+}
+
+static std::string_view Trim(std::string_view s) {
+	while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+		s.remove_prefix(1);
+	while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+		s.remove_suffix(1);
+	return s;
+}
+
+MpcHcSettings MpcHcIniSettings::Load() {
+	MpcHcSettings settings;
+
+	std::error_code ec;
+	m_loadedWriteTime = std::filesystem::last_write_time(m_path, ec);
+	m_lastCheck = std::chrono::steady_clock::now();
+
+	std::ifstream file(m_path, std::ios::binary);
+	if (!file)
+		return settings;
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	// MPC-HC writes the file in UTF-16. Only ASCII keys and numbers are needed, so the rest is replaced.
+	if (data.size() >= 2 && data[0] == '\xFF' && data[1] == '\xFE') {
+		std::string narrow;
+		narrow.reserve(data.size() / 2);
+		for (size_t i = 2; i + 1 < data.size(); i += 2) {
+			const auto unit = static_cast<unsigned char>(data[i]) | static_cast<unsigned char>(data[i + 1]) << 8;
+			narrow.push_back(unit < 0x80 ? static_cast<char>(unit) : '?');
+		}
+		data.swap(narrow);
+	}
+
+	std::string_view rest(data);
+	auto inSettings = false;
+	while (!rest.empty()) {
+		const auto eol = rest.find('\n');
+		const auto line = Trim(rest.substr(0, eol));
+		rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+
+		if (line.size() >= 2 && line.front() == '[' && line.back() == ']') {
+			inSettings = EqualsIgnoreCase(line.substr(1, line.size() - 2), "Settings");
+			continue;
+		}
+		const auto equals = line.find('=');
+		if (!inSettings || equals == std::string_view::npos)
+			continue;
+
+		const auto name = Trim(line.substr(0, equals));
+		const std::string value(Trim(line.substr(equals + 1)));
+		if (EqualsIgnoreCase(name, "EnableWebServer"))
+			settings.webServerEnabled = std::strtoul(value.c_str(), nullptr, 10) != 0;
+		else if (EqualsIgnoreCase(name, "WebServerPort"))
+			settings.webServerPort = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+	}
+
+	for (const auto name : { "mpc-hc64.exe", "mpc-hc.exe" }) {
+		auto exePath = m_path.parent_path() / name;
+		if (std::filesystem::is_regular_file(exePath, ec)) {
+			settings.exePath = std::move(exePath);
+			break;
+		}
+	}
+	return settings;
+}
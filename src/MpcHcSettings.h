@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+
+// The part of MPC-HC's settings the plugin depends on.
+struct MpcHcSettings {
+	std::filesystem::path exePath; // empty if MPC-HC was not found
+	bool webServerEnabled = false;
+	unsigned webServerPort = 0;
+};
+
+// Keeps MPC-HC's settings cached, so that they are read again only after they changed
+// instead of on every request to the player.
+class MpcHcSettingsProvider {
+	std::mutex m_mutex;
+	MpcHcSettings m_settings;
+	bool m_loaded = false;
+
+	// Expects m_mutex to be held.
+	const MpcHcSettings& Refresh();
+
+protected:
+	// Whether the settings may have changed since the last Load. Called with the cache locked.
+	virtual bool HasChanged() = 0;
+	virtual MpcHcSettings Load() = 0;
+
+public:
+	MpcHcSettingsProvider() = default;
+	MpcHcSettingsProvider(const MpcHcSettingsProvider&) = delete;
+	MpcHcSettingsProvider& operator =(const MpcHcSettingsProvider&) = delete;
+	virtual ~MpcHcSettingsProvider() = default;
+
+	MpcHcSettings Get();
+	// Same as Get().webServerPort, without copying the rest.
+	unsigned GetWebServerPort();
+};
+
+#ifdef _WIN32
+// Settings of an installed MPC-HC, under HKCU\Software\MPC-HC\MPC-HC.
+// The key is watched with RegNotifyChangeKeyValue; until it exists, opening it is retried at most once a second.
+class MpcHcRegistrySettings : public MpcHcSettingsProvider {
+	void* m_hKey = nullptr;
+	void* m_hChanged = nullptr;
+	std::chrono::steady_clock::time_point m_lastOpenAttempt;
+
+	bool Watch();
+
+protected:
+	bool HasChanged() override;
+	MpcHcSettings Load() override;
+
+public:
+	MpcHcRegistrySettings();
+	~MpcHcRegistrySettings() override;
+};
+#endif
+
+// Settings of a portable MPC-HC, from the [Settings] section of its mpc-hc.ini.
+// The executable is looked for next to the file. The file is checked for changes at most once a second.
+class MpcHcIniSettings : public MpcHcSettingsProvider {
+	const std::filesystem::path m_path;
+	std::filesystem::file_time_type m_loadedWriteTime;
+	std::chrono::steady_clock::time_point m_lastCheck;
+
+protected:
+	bool HasChanged() override;
+	MpcHcSettings Load() override;
+
+public:
+	explicit MpcHcIniSettings(std::filesystem::path path);
+};
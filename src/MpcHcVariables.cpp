@@ -0,0 +1,175 @@
+#include "MpcHcVariables.h"
+#include "HtmlEntities.h"
+#include <algorithm>
+
+namespace MpcHcVariables {
+	static bool ParseInteger(const std::string_view text, int64_t& value) {
+		size_t i = 0;
+		const auto negative = !text.empty() && text[0] == '-';
+		if (negative)
+			++i;
+		if (i == text.size())
+			return false;
+
+		int64_t result = 0;
+		for (; i < text.size(); ++i) {
+			if (text[i] < '0' || text[i] > '9')
+				return false;
+			// Values out of range are malformed, not wrapped.
+			const auto digit = text[i] - '0';
+			if (result > (INT64_MAX - digit) / 10)
+				return false;
+			result = result * 10 + digit;
+		}
+		value = negative ? -result : result;
+		return true;
+	}
+
+	// Not strtod, which would follow the C locale's decimal separator; the player may write either.
+	static bool ParseDecimal(const std::string_view text, double& value) {
+		double result = 0, scale = 0;
+		auto hasDigit = false;
+		for (const auto c : text) {
+			if (c >= '0' && c <= '9') {
+				hasDigit = true;
+				if (scale == 0)
+					result = result * 10 + (c - '0');
+				else {
+					result += (c - '0') * scale;
+					scale /= 10;
+				}
+			} else if ((c == '.' || c == ',') && scale == 0)
+				scale = 0.1;
+			else
+				return false;
+		}
+		if (hasDigit)
+			value = result;
+		return hasDigit;
+	}
+
+	static std::string DecodeText(const std::string_view text) {
+		std::string result;
+		result.reserve(text.size());
+		for (size_t i = 0; i < text.size();) {
+			uint32_t codePoint;
+			const auto length = text[i] == '&' ? HtmlEntities::Decode(text.substr(i), codePoint) : 0;
+			if (length == 0) {
+				result += text[i++];
+				continue;
+			}
+			char utf8[4];
+			result.append(utf8, HtmlEntities::EncodeUtf8(codePoint, utf8));
+			i += length;
+		}
+		return result;
+	}
+
+	static void Store(PlayerVariables& variables, const std::string_view id, const std::string_view value) {
+		int64_t number;
+		if (id == "file") {
+			variables.file = DecodeText(value);
+			variables.found |= FIELD_FILE;
+		} else if (id == "filepath") {
+			variables.filePath = DecodeText(value);
+			variables.found |= FIELD_FILE_PATH;
+		} else if (id == "filedir") {
+			variables.fileDir = DecodeText(value);
+			variables.found |= FIELD_FILE_DIR;
+		} else if (id == "version") {
+			variables.version = DecodeText(value);
+			variables.found |= FIELD_VERSION;
+		} else if (id == "state") {
+			if (ParseInteger(value, number)) {
+				variables.state = static_cast<int>(number);
+				variables.found |= FIELD_STATE;
+			}
+		} else if (id == "position") {
+			if (ParseInteger(value, variables.position))
+				variables.found |= FIELD_POSITION;
+		} else if (id == "duration") {
+			if (ParseInteger(value, variables.duration))
+				variables.found |= FIELD_DURATION;
+		} else if (id == "volumelevel") {
+			if (ParseInteger(value, number)) {
+				variables.volumeLevel = static_cast<int>(number);
+				variables.found |= FIELD_VOLUME_LEVEL;
+			}
+		} else if (id == "muted") {
+			if (ParseInteger(value, number)) {
+				variables.muted = number != 0;
+				variables.found |= FIELD_MUTED;
+			}
+		} else if (id == "playbackrate") {
+			if (ParseDecimal(value, variables.playbackRate))
+				variables.found |= FIELD_PLAYBACK_RATE;
+		}
+	}
+
+	// Stores the complete elements of html. Returns whether every field in required has been seen; otherwise
+	// resume is where an element cut off at the end of html starts, or where the start of one may be.
+	static bool Scan(const std::string_view html, PlayerVariables& variables, const uint32_t required, size_t& resume) {
+		static constexpr std::string_view OPEN = "<p id=\"";
+		static constexpr std::string_view CLOSE = "</p>";
+
+		size_t from = 0;
+		for (auto pos = html.find(OPEN); ; pos = html.find(OPEN, from)) {
+			if (pos == std::string_view::npos) {
+				resume = std::max(from, html.size() - std::min(html.size(), OPEN.size() - 1));
+				break;
+			}
+			resume = pos;
+			const auto idBegin = pos + OPEN.size();
+			const auto idEnd = html.find('"', idBegin);
+			if (idEnd == std::string_view::npos || idEnd + 1 == html.size())
+				break;
+			if (html[idEnd + 1] != '>') {
+				from = idBegin;
+				continue;
+			}
+
+			const auto valueBegin = idEnd + 2;
+			const auto valueEnd = html.find(CLOSE, valueBegin);
+			if (valueEnd == std::string_view::npos)
+				break;
+
+			Store(variables, html.substr(idBegin, idEnd - idBegin), html.substr(valueBegin, valueEnd - valueBegin));
+			if ((variables.found & required) == required)
+				return true;
+			from = valueEnd + CLOSE.size();
+		}
+		return (variables.found & required) == required;
+	}
+
+	bool Parse(const std::string_view html, PlayerVariables& variables, const uint32_t required) {
+		variables = PlayerVariables();
+		size_t resume;
+		return Scan(html, variables, required, resume);
+	}
+
+	Parser::Parser(PlayerVariables& variables, const uint32_t required)
+		: m_variables(variables)
+		, m_required(required) {
+		m_variables = PlayerVariables();
+		m_complete = (m_variables.found & m_required) == m_required;
+	}
+
+	bool Parser::Append(const std::string_view piece) {
+		if (m_complete)
+			return true;
+
+		// Scanned in place unless part of an element is left from the last piece.
+		size_t resume;
+		if (m_pending.empty()) {
+			m_complete = Scan(piece, m_variables, m_required, resume);
+			if (!m_complete)
+				m_pending.assign(piece.substr(resume));
+		} else {
+			m_pending.append(piece);
+			m_complete = Scan(m_pending, m_variables, m_required, resume);
+			if (!m_complete)
+				m_pending.erase(0, resume);
+		}
+		return m_complete;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace MpcHcVariables {
+	enum Field : uint32_t {
+		FIELD_FILE = 1 << 0,
+		FIELD_FILE_PATH = 1 << 1,
+		FIELD_FILE_DIR = 1 << 2,
+		FIELD_STATE = 1 << 3,
+		FIELD_POSITION = 1 << 4,
+		FIELD_DURATION = 1 << 5,
+		FIELD_VOLUME_LEVEL = 1 << 6,
+		FIELD_MUTED = 1 << 7,
+		FIELD_PLAYBACK_RATE = 1 << 8,
+		FIELD_VERSION = 1 << 9,
+		ALL_FIELDS = (1 << 10) - 1
+	};
+
+	// Player state as reported by the web interface at /variables.html.
+	struct PlayerVariables {
+		uint32_t found = 0; // Field bits of the values below that were present and well-formed
+		std::string file; // text is UTF-8 with character references decoded
+		std::string filePath;
+		std::string fileDir;
+		std::string version;
+		int state = -1; // 0: stopped, 1: paused, 2: playing
+		int64_t position = -1; // ms
+		int64_t duration = -1; // ms
+		int volumeLevel = -1;
+		bool muted = false;
+		double playbackRate = 1.0;
+	};
+
+	// Reads the <p id="name">value</p> elements of a variables.html response in one pass.
+	// Stops as soon as every field in required has been seen; returns whether they all were.
+	bool Parse(std::string_view html, PlayerVariables& variables, uint32_t required = ALL_FIELDS);
+
+	// Parse for a page that arrives a piece at a time. Each piece is scanned once; only an element cut off
+	// at the end of a piece is kept, and scanned again once the rest of it arrives.
+	class Parser {
+		PlayerVariables& m_variables;
+		const uint32_t m_required;
+		std::string m_pending;
+		bool m_complete = false;
+
+	public:
+		Parser(PlayerVariables& variables, uint32_t required = ALL_FIELDS);
+
+		// Returns whether every field in required has been seen so far; the rest of the page is of no use then.
+		bool Append(std::string_view piece);
+	};
+};
@@ -0,0 +1,417 @@
+#include "MpvBackend.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#endif
+#include "nlohmann/json.hpp"
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+enum : int {
+	OBSERVE_TIME_POS = 1,
+	OBSERVE_PAUSE = 2,
+	OBSERVE_SPEED = 3
+};
+
+static std::string MakeCommand(const nlohmann::json& arguments) {
+	return nlohmann::json{ { "command", arguments } }.dump() + "\n";
+}
+
+MpvBackend::MpvBackend(std::filesystem::path ipcPath, std::filesystem::path executable)
+	: m_ipcPath(std::move(ipcPath))
+	, m_executable(std::move(executable)) {
+#ifdef _WIN32
+	m_hReadEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	m_hWriteEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	m_hStopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+#endif
+}
+
+MpvBackend::~MpvBackend() {
+	Shutdown();
+#ifdef _WIN32
+	CloseHandle(m_hReadEvent);
+	CloseHandle(m_hWriteEvent);
+	CloseHandle(m_hStopEvent);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MpvBackend::OpenConnection() {
+	// Overlapped, so that writes do not wait behind the read the reader thread keeps pending.
+	const auto hPipe = CreateFileW(m_ipcPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+	if (hPipe == INVALID_HANDLE_VALUE)
+		return false;
+	m_hPipe = hPipe;
+	ResetEvent(m_hStopEvent);
+	return true;
+}
+
+void MpvBackend::StopReading() {
+	SetEvent(m_hStopEvent);
+}
+
+void MpvBackend::CloseConnection() {
+	if (m_hPipe == nullptr)
+		return;
+	CloseHandle(m_hPipe);
+	m_hPipe = nullptr;
+}
+
+bool MpvBackend::WriteAll(const std::string_view data) {
+	OVERLAPPED overlapped{};
+	overlapped.hEvent = m_hWriteEvent;
+	if (!WriteFile(m_hPipe, data.data(), static_cast<DWORD>(data.size()), nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+		return false;
+
+	DWORD written = 0;
+	return GetOverlappedResult(m_hPipe, &overlapped, &written, TRUE) && written == data.size();
+}
+
+ptrdiff_t MpvBackend::ReadSome(char* buffer, const size_t size) {
+	OVERLAPPED overlapped{};
+	overlapped.hEvent = m_hReadEvent;
+	if (!ReadFile(m_hPipe, buffer, static_cast<DWORD>(size), nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+		return -1;
+
+	DWORD read = 0;
+	const HANDLE handles[] = { m_hReadEvent, m_hStopEvent };
+	if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+		CancelIoEx(m_hPipe, &overlapped);
+		GetOverlappedResult(m_hPipe, &overlapped, &read, TRUE);
+		return -1;
+	}
+	if (!GetOverlappedResult(m_hPipe, &overlapped, &read, FALSE) && GetLastError() != ERROR_MORE_DATA)
+		return -1;
+	return read;
+}
+
+bool MpvBackend::Launch(const std::filesystem::path& mediaPath, std::wstring& error) {
+	STARTUPINFOW si;
+	PROCESS_INFORMATION pi;
+	ZeroMemory(&si, sizeof si);
+	ZeroMemory(&pi, sizeof pi);
+	si.cb = sizeof si;
+
+	// No application name, so that a bare "mpv.exe" is looked up in PATH.
+	auto commandLine = L"\"" + m_executable.wstring() + L"\" \"--input-ipc-server=" + m_ipcPath.wstring() + L"\" \"" + mediaPath.wstring() + L"\"";
+	if (CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, false, 0, nullptr, nullptr, &si, &pi)) {
+		CloseHandle(pi.hProcess);
+		CloseHandle(pi.hThread);
+		return true;
+	}
+
+	LPWSTR errorText = nullptr;
+	FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr,
+		GetLastError(),
+		MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+		reinterpret_cast<LPWSTR>(&errorText),
+		0,
+		nullptr);
+	error = L"Could not start mpv";
+	if (errorText) {
+		error += L": ";
+		error += errorText;
+		LocalFree(errorText);
+	}
+	return false;
+}
+
+#else
+
+bool MpvBackend::OpenConnection() {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	const auto& path = m_ipcPath.native();
+	if (path.size() >= sizeof address.sun_path)
+		return false;
+	memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	m_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_socket == -1)
+		return false;
+	if (connect(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof address) == -1) {
+		CloseConnection();
+		return false;
+	}
+	return true;
+}
+
+void MpvBackend::StopReading() {
+	shutdown(m_socket, SHUT_RDWR);
+}
+
+void MpvBackend::CloseConnection() {
+	if (m_socket == -1)
+		return;
+	close(m_socket);
+	m_socket = -1;
+}
+
+bool MpvBackend::WriteAll(std::string_view data) {
+	while (!data.empty()) {
+		const auto written = send(m_socket, data.data(), data.size(), MSG_NOSIGNAL);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data.remove_prefix(static_cast<size_t>(written));
+	}
+	return true;
+}
+
+ptrdiff_t MpvBackend::ReadSome(char* buffer, const size_t size) {
+	ssize_t read;
+	do
+		read = recv(m_socket, buffer, size, 0);
+	while (read == -1 && errno == EINTR);
+	return read;
+}
+
+bool MpvBackend::Launch(const std::filesystem::path& mediaPath, std::wstring& error) {
+	auto executable = m_executable.native();
+	auto ipcArgument = "--input-ipc-server=" + m_ipcPath.native();
+	auto media = mediaPath.native();
+	char* argv[] = { &executable[0], &ipcArgument[0], &media[0], nullptr };
+
+	pid_t pid;
+	const auto result = posix_spawnp(&pid, executable.c_str(), nullptr, nullptr, argv, environ);
+	if (result == 0)
+		return true;
+
+	const std::string reason = strerror(result);
+	error = L"Could not start mpv: " + std::wstring(reason.begin(), reason.end());
+	return false;
+}
+
+#endif
+
+bool MpvBackend::EnsureConnected(std::unique_lock<std::mutex>& lock) {
+	if (m_connected)
+		return true;
+
+	// The reader of the previous connection has finished; it takes no lock after clearing m_connected.
+	if (m_reader.joinable())
+		m_reader.join();
+	CloseConnection();
+	if (!OpenConnection())
+		return false;
+
+	m_connected = true;
+	++m_connectionId;
+	m_hasTimePos = m_hasPosition = false;
+	m_paused = true;
+	m_speed = 1;
+	m_reader = std::thread(&MpvBackend::ReaderMain, this);
+
+	if (!SendCommand(lock, MakeCommand({ "observe_property", OBSERVE_TIME_POS, "time-pos" }))
+		|| !SendCommand(lock, MakeCommand({ "observe_property", OBSERVE_PAUSE, "pause" }))
+		|| !SendCommand(lock, MakeCommand({ "observe_property", OBSERVE_SPEED, "speed" })))
+		return false;
+	return true;
+}
+
+bool MpvBackend::EnsurePosition(std::unique_lock<std::mutex>& lock) {
+	if (!EnsureConnected(lock))
+		return false;
+
+	// mpv answers an observation with the current value right away; wait for it, so that the caller gets a position.
+	m_changed.wait_for(lock, std::chrono::milliseconds(500), [this] { return m_hasTimePos || !m_connected; });
+	return m_connected;
+}
+
+void MpvBackend::Disconnect(std::unique_lock<std::mutex>& lock) {
+	const auto connectionId = m_connectionId;
+	if (m_reader.joinable()) {
+		// The reader may be waiting for the lock to handle a message.
+		StopReading();
+		auto reader = std::move(m_reader);
+		lock.unlock();
+		reader.join();
+		lock.lock();
+	}
+
+	// Someone may have connected again while the lock was released.
+	if (connectionId == m_connectionId) {
+		CloseConnection();
+		m_connected = false;
+	}
+}
+
+bool MpvBackend::SendCommand(std::unique_lock<std::mutex>& lock, const std::string& command) {
+	if (WriteAll(command))
+		return true;
+	Disconnect(lock);
+	return false;
+}
+
+void MpvBackend::AdvanceTimePos(const std::chrono::steady_clock::time_point now) {
+	if (m_hasPosition && !m_paused)
+		m_timePos += std::chrono::duration<double>(now - m_timePosTime).count() * m_speed;
+	m_timePosTime = now;
+}
+
+void MpvBackend::Execute(const std::string& command) {
+	std::function<void()> failureHandler;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (EnsureConnected(lock) && SendCommand(lock, command))
+			return;
+		failureHandler = m_failureHandler;
+	}
+	if (failureHandler)
+		failureHandler();
+}
+
+void MpvBackend::ReaderMain() {
+	std::string pending;
+	char buffer[4096];
+	ptrdiff_t read;
+	while ((read = ReadSome(buffer, sizeof buffer)) > 0) {
+		pending.append(buffer, static_cast<size_t>(read));
+		size_t lineBegin = 0;
+		for (size_t lineEnd; (lineEnd = pending.find('\n', lineBegin)) != std::string::npos; lineBegin = lineEnd + 1)
+			OnMessage(std::string_view(pending).substr(lineBegin, lineEnd - lineBegin));
+		pending.erase(0, lineBegin);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_connected = false;
+	m_changed.notify_all();
+}
+
+void MpvBackend::OnMessage(const std::string_view line) {
+	const auto message = nlohmann::json::parse(line.begin(), line.end(), nullptr, false);
+	if (!message.is_object() || message.value("event", std::string()) != "property-change")
+		return;
+
+	const auto now = std::chrono::steady_clock::now();
+	const auto id = message.value("id", 0);
+	const auto data = message.find("data");
+	const auto hasData = data != message.end() && !data->is_null();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	switch (id) {
+		case OBSERVE_TIME_POS:
+			// No data while no file is loaded.
+			m_hasTimePos = true;
+			m_hasPosition = hasData && data->is_number();
+			if (m_hasPosition)
+				m_timePos = data->get<double>();
+			m_timePosTime = now;
+			break;
+
+		case OBSERVE_PAUSE:
+			if (hasData && data->is_boolean()) {
+				AdvanceTimePos(now);
+				m_paused = data->get<bool>();
+			}
+			break;
+
+		case OBSERVE_SPEED:
+			if (hasData && data->is_number()) {
+				AdvanceTimePos(now);
+				m_speed = data->get<double>();
+			}
+			break;
+
+		default:
+			return;
+	}
+	m_changed.notify_all();
+}
+
+void MpvBackend::SetActive(const bool active) {
+	// Nothing to poll; only connect early, on another thread, so that neither this nor the first use waits for it.
+	if (!active)
+		return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_connected || m_connecting)
+		return;
+
+	// A connector that is done has cleared m_connecting as its last step, and needs the lock no more.
+	if (m_connector.joinable())
+		m_connector.join();
+	m_connecting = true;
+	m_connector = std::thread([this] {
+		std::unique_lock<std::mutex> connectorLock(m_mutex);
+		EnsureConnected(connectorLock);
+		m_connecting = false;
+	});
+}
+
+void MpvBackend::Shutdown() {
+	if (m_connector.joinable())
+		m_connector.join();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Disconnect(lock);
+	if (m_reader.joinable())
+		m_reader.join();
+	CloseConnection();
+	m_connected = false;
+}
+
+void MpvBackend::SetFailureHandler(std::function<void()> handler) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_failureHandler = std::move(handler);
+}
+
+int64_t MpvBackend::GetPositionAt(const std::chrono::steady_clock::time_point time) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!EnsurePosition(lock) || !m_hasPosition)
+		return -1;
+
+	auto seconds = m_timePos;
+	if (!m_paused)
+		seconds += std::chrono::duration<double>(time - m_timePosTime).count() * m_speed;
+	return std::max<int64_t>(0, std::llround(seconds * 1000));
+}
+
+PlayerBackend::State MpvBackend::GetState() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!EnsurePosition(lock) || !m_hasPosition)
+		return State::STOPPED;
+	return m_paused ? State::PAUSED : State::PLAYING;
+}
+
+void MpvBackend::Seek(const int64_t position) {
+	Execute(MakeCommand({ "seek", position / 1000.0, "absolute+exact" }));
+}
+
+void MpvBackend::SeekBy(const int64_t delta) {
+	Execute(MakeCommand({ "seek", delta / 1000.0, "relative+exact" }));
+}
+
+void MpvBackend::PlayPause() {
+	Execute(MakeCommand({ "cycle", "pause" }));
+}
+
+bool MpvBackend::CanOpen(std::wstring&) {
+	// Whether mpv can be started is only known by trying.
+	return true;
+}
+
+bool MpvBackend::Open(const std::filesystem::path& mediaPath, std::wstring& error) {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (EnsureConnected(lock) && SendCommand(lock, MakeCommand({ "loadfile", mediaPath.u8string() })))
+			return true;
+	}
+	return Launch(mediaPath, error);
+}
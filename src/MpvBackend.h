@@ -0,0 +1,84 @@
+#pragma once
+#include "PlayerBackend.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+// mpv through its JSON IPC server (--input-ipc-server): a named pipe on Windows, a Unix domain socket elsewhere.
+// mpv pushes position, pause and speed as they change, so the player is never polled.
+class MpvBackend : public PlayerBackend {
+	const std::filesystem::path m_ipcPath;
+	const std::filesystem::path m_executable;
+
+	// Guards everything below. The reader thread only ever holds it while handling one message.
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+#ifdef _WIN32
+	void* m_hPipe = nullptr;
+	void* m_hReadEvent = nullptr;
+	void* m_hWriteEvent = nullptr;
+	void* m_hStopEvent = nullptr;
+#else
+	int m_socket = -1;
+#endif
+	std::thread m_reader;
+	std::thread m_connector; // connects for SetActive
+	bool m_connecting = false;
+	bool m_connected = false;
+	uint64_t m_connectionId = 0;
+
+	bool m_hasTimePos = false; // mpv answered the time-pos observation at least once
+	bool m_hasPosition = false; // a file is loaded
+	double m_timePos = 0; // seconds
+	std::chrono::steady_clock::time_point m_timePosTime;
+	bool m_paused = true;
+	double m_speed = 1;
+
+	std::function<void()> m_failureHandler;
+
+	bool OpenConnection();
+	void StopReading();
+	void CloseConnection();
+	bool WriteAll(std::string_view data);
+	ptrdiff_t ReadSome(char* buffer, size_t size);
+	bool Launch(const std::filesystem::path& mediaPath, std::wstring& error);
+
+	// All of these expect m_mutex to be held.
+	bool EnsureConnected(std::unique_lock<std::mutex>& lock);
+	// Connects if needed and waits a bounded time for the first position, which mpv sends right after connecting.
+	bool EnsurePosition(std::unique_lock<std::mutex>& lock);
+	void Disconnect(std::unique_lock<std::mutex>& lock);
+	bool SendCommand(std::unique_lock<std::mutex>& lock, const std::string& command);
+	void AdvanceTimePos(std::chrono::steady_clock::time_point now);
+
+	// Sends a command, connecting first if needed; calls the failure handler if it cannot.
+	void Execute(const std::string& command);
+
+	void ReaderMain();
+	void OnMessage(std::string_view line);
+
+public:
+	// ipcPath is what mpv was given as --input-ipc-server; executable is used to start mpv when it is not running.
+	MpvBackend(std::filesystem::path ipcPath, std::filesystem::path executable);
+	MpvBackend(const MpvBackend&) = delete;
+	MpvBackend(MpvBackend&&) = delete;
+	MpvBackend& operator =(const MpvBackend&) = delete;
+	MpvBackend& operator =(MpvBackend&&) = delete;
+	~MpvBackend() override;
+
+	void SetActive(bool active) override;
+	void Shutdown() override;
+	void SetFailureHandler(std::function<void()> handler) override;
+
+	int64_t GetPositionAt(std::chrono::steady_clock::time_point time) override;
+	State GetState() override;
+
+	void Seek(int64_t position) override;
+	void SeekBy(int64_t delta) override;
+	void PlayPause() override;
+
+	bool CanOpen(std::wstring& error) override;
+	bool Open(const std::filesystem::path& mediaPath, std::wstring& error) override;
+};
@@ -2,28 +2,20 @@
 #include "PluginInterface.h"
 #include <shlwapi.h>
 #include <fstream>
-#include "MpcHcRemote.h"
-#include <regex>
+#include "MpcHcBackend.h"
+#include "MpvBackend.h"
+#include "SmiLint.h"
+#include "SmiParser.h"
+#include "SmiRetime.h"
+#include "SmiSort.h"
+#include "SmiTimeline.h"
+#include <algorithm>
 #include <cinttypes>
 
-namespace UsefulRegexs {
-	const std::regex SYNC_MATCHER(R"(<sync(?=\s)[^<>]*\s)" R"(start=(['"]?)(\d+)\1(?=\s|>)[^<>]*>(?:<P>)?)", std::regex_constants::icase);
-	const std::regex TAG_REMOVER(R"(</?p\b[^<>]*>)", std::regex_constants::icase);
-	const std::regex BR_REPLACER(R"(<br\b[^<>]*>)", std::regex_constants::icase);
-	const std::regex MULTILINE_MATCHER(R"(\n+)");
-	const std::regex SPACE_MATCHER(R"(\s+)");
-}
-
 class NppSmi::ScintillaWorker {
 	const NppSmi& m_nppSmi;
 	HWND const m_hScintilla; // NOLINT(misc-misplaced-const)
 
-	static HWND FindCurrentScintilla(const NppSmi& nppSmi) {
-		int which = -1;
-		SendMessage(nppSmi.m_hNpp, NPPM_GETCURRENTSCINTILLA, 0, reinterpret_cast<LPARAM>(&which));
-		return which == 0 ? nppSmi.m_hSc1 : nppSmi.m_hSc2;
-	}
-
 public:
 	enum : int {
 		PRIMARY = 0,
@@ -39,7 +31,7 @@ public:
 		: m_nppSmi(*smi)
 		, m_hScintilla(
 			which == ACTIVE
-			? FindCurrentScintilla(m_nppSmi)
+			? m_nppSmi.GetCurrentScintilla()
 			: which == PRIMARY
 			? m_nppSmi.m_hSc1
 			: m_nppSmi.m_hSc2
@@ -83,6 +75,30 @@ public:
 		return SendMessage(m_hScintilla, SCI_POSITIONFROMLINE, lineNumber, 0);
 	}
 
+	// Where the line ends, before its line end characters.
+	size_t GetLineEndPosition(const size_t lineNumber) const {
+		return SendMessage(m_hScintilla, SCI_GETLINEENDPOSITION, lineNumber, 0);
+	}
+
+	size_t GetSelectionStart() const {
+		return SendMessage(m_hScintilla, SCI_GETSELECTIONSTART, 0, 0);
+	}
+
+	size_t GetSelectionEnd() const {
+		return SendMessage(m_hScintilla, SCI_GETSELECTIONEND, 0, 0);
+	}
+
+	bool IsSelectionEmpty() const {
+		return !!SendMessage(m_hScintilla, SCI_GETSELECTIONEMPTY, 0, 0);
+	}
+
+	// The whole document without a copy; valid until it is modified.
+	std::string_view GetText() const {
+		const auto length = static_cast<size_t>(SendMessage(m_hScintilla, SCI_GETLENGTH, 0, 0));
+		const auto text = reinterpret_cast<const char*>(SendMessage(m_hScintilla, SCI_GETCHARACTERPOINTER, 0, 0));
+		return text == nullptr ? std::string_view() : std::string_view(text, length);
+	}
+
 	// ReSharper disable CppMemberFunctionMayBeConst
 	void SetAnchor(const size_t pos) {
 		SendMessage(m_hScintilla, SCI_SETANCHOR, pos, 0);
@@ -108,12 +124,39 @@ public:
 		SendMessage(m_hScintilla, SCI_ADDTEXT, newString.size(), reinterpret_cast<LPARAM>(&newString[0]));
 	}
 
+	void ReplaceRange(const size_t begin, const size_t end, const std::string& newString) {
+		SendMessage(m_hScintilla, SCI_SETTARGETRANGE, begin, end);
+		SendMessage(m_hScintilla, SCI_REPLACETARGET, newString.size(), reinterpret_cast<LPARAM>(newString.data()));
+	}
+
 	void ScrollBy(const int columns, const int lines) {
 		SendMessage(m_hScintilla, SCI_LINESCROLL, columns, lines);
 	}
 	// ReSharper restore CppMemberFunctionMayBeConst
 };
 
+// Reads straight from Scintilla's buffer without starting an undo action, so it is safe to use from notifications.
+class ScintillaTextSource : public SmiTextSource {
+	HWND const m_hScintilla; // NOLINT(misc-misplaced-const)
+
+public:
+	explicit ScintillaTextSource(HWND hScintilla) : m_hScintilla(hScintilla) {}
+
+	size_t GetLength() const override {
+		return static_cast<size_t>(SendMessage(m_hScintilla, SCI_GETLENGTH, 0, 0));
+	}
+
+	// Valid until the document is modified.
+	std::string_view GetRange(const size_t offset, const size_t length) const override {
+		const auto text = reinterpret_cast<const char*>(SendMessage(m_hScintilla, SCI_GETRANGEPOINTER, offset, length));
+		return text == nullptr ? std::string_view() : std::string_view(text, length);
+	}
+
+	size_t GetLineFromPosition(const size_t position) const override {
+		return static_cast<size_t>(SendMessage(m_hScintilla, SCI_LINEFROMPOSITION, position, 0));
+	}
+};
+
 NppSmi::NppSmi(HINSTANCE hModule, const struct NppData &data, const std::tuple<std::vector<struct FuncItem>, std::shared_ptr<std::list<struct ShortcutKey>>> & menus)
 	: m_hModule(hModule)
 	, m_hNpp(data._nppHandle)
@@ -141,6 +184,22 @@ NppSmi::NppSmi(HINSTANCE hModule, const struct NppData &data, const std::tuple<s
 	}
 	m_config.autoOpenMedia = ReadConfig(config, { "autoOpenMedia" }, m_config.autoOpenMedia);
 	m_config.forceShortcutIfSmi = ReadConfig(config, { "forceShortcutIfSmi" }, m_config.forceShortcutIfSmi);
+	m_config.pollingInterval = ReadConfig(config, { "pollingInterval" }, m_config.pollingInterval);
+	m_config.player = ReadConfig(config, { "player" }, m_config.player);
+	m_config.webServerPort = ReadConfig(config, { "webServerPort" }, m_config.webServerPort);
+	m_config.mpcHcIni = ReadConfig(config, { "mpcHcIni" }, m_config.mpcHcIni);
+	m_config.mpvPipe = ReadConfig(config, { "mpvPipe" }, m_config.mpvPipe);
+	m_config.mpvPath = ReadConfig(config, { "mpvPath" }, m_config.mpvPath);
+	m_config.anchorFit = ReadConfig(config, { "anchorFit" }, m_config.anchorFit);
+	m_config.lint = ReadConfig(config, { "lint" }, m_config.lint);
+	m_config.lintMinDuration = ReadConfig(config, { "lintMinDuration" }, m_config.lintMinDuration);
+
+	m_shiftTimingsDialog.init(m_hModule, m_hNpp);
+
+	if (m_config.player == "mpv")
+		m_player = std::make_unique<MpvBackend>(std::filesystem::u8path(m_config.mpvPipe), std::filesystem::u8path(m_config.mpvPath));
+	else
+		m_player = std::make_unique<MpcHcBackend>(m_config.pollingInterval, m_config.webServerPort, std::filesystem::u8path(m_config.mpcHcIni));
 
 	GetModuleFileName(hModule, m_moduleName, sizeof m_moduleName);
 	_tcsncpy_s(m_moduleName, MAX_PATH, _tcsrchr(m_moduleName, '\\') + 1, MAX_PATH);
@@ -149,6 +208,10 @@ NppSmi::NppSmi(HINSTANCE hModule, const struct NppData &data, const std::tuple<s
 		return instance->LowLevelKeyboardProc(nCode, wParam, lParam);
 	}), m_hModule, 0);
 
+	m_player->SetFailureHandler([hNpp = m_hNpp]() {
+		PostMessage(hNpp, WM_PLAYER_COMMAND_FAILED, 0, 0);
+	});
+
 	m_prevWndProc = reinterpret_cast<WNDPROC>(GetWindowLongPtr(m_hNpp, GWLP_WNDPROC));
 	SetWindowLongPtr(m_hNpp, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(static_cast<WNDPROC>([](HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) -> LRESULT {
 		return instance->OnBeforeNppWndProc(hWnd, uMsg, wParam, lParam);
@@ -164,6 +227,7 @@ NppSmi::~NppSmi() {
 	SetWindowLongPtr(m_hNpp, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(m_prevWndProc));
 	UnhookWindowsHookEx(m_hhkLowLevelKeyboard);
 
+	m_player->Shutdown();
 	WSACleanup();
 
 	typedef nlohmann::json JSON;
@@ -171,6 +235,15 @@ NppSmi::~NppSmi() {
 	configFile << JSON::object({
 		{ "autoOpenMedia", m_config.autoOpenMedia },
 		{ "forceShortcutIfSmi", m_config.forceShortcutIfSmi },
+		{ "pollingInterval", m_config.pollingInterval },
+		{ "player", m_config.player },
+		{ "webServerPort", m_config.webServerPort },
+		{ "mpcHcIni", m_config.mpcHcIni },
+		{ "mpvPipe", m_config.mpvPipe },
+		{ "mpvPath", m_config.mpvPath },
+		{ "anchorFit", m_config.anchorFit },
+		{ "lint", m_config.lint },
+		{ "lintMinDuration", m_config.lintMinDuration },
 		}).dump();
 }
 
@@ -182,12 +255,35 @@ void NppSmi::OnScintillaMessage(SCNotification* notifyCode) {
 	switch (notifyCode->nmhdr.code) {
 		case NPPN_BUFFERACTIVATED:
 			DetermineCurrentDocumentIsSmi();
+			m_isTimelineValid = false;
+			m_anchors.clear();
+			m_player->SetActive(m_isCurrentDocumentSMI);
+			LintDocument();
 			break;
 
 		case NPPN_FILEOPENED:
 			DetermineCurrentDocumentIsSmi();
+			m_isTimelineValid = false;
+			m_anchors.clear();
+			m_player->SetActive(m_isCurrentDocumentSMI);
 			if (m_isCurrentDocumentSMI)
 				SendMessage(m_hNpp, NPPM_SETCURRENTLANGTYPE, 0, L_HTML);
+			LintDocument();
+			break;
+
+		case NPPN_READY:
+			// Documents activated while starting up were not marked yet.
+			AllocateLintIndicator();
+			LintDocument();
+			break;
+
+		case NPPN_SHUTDOWN:
+			// Worker threads have to be gone before the DLL is unloaded.
+			m_player->Shutdown();
+			break;
+
+		case SCN_MODIFIED:
+			UpdateTimeline(*notifyCode);
 			break;
 
 		default:
@@ -196,6 +292,89 @@ void NppSmi::OnScintillaMessage(SCNotification* notifyCode) {
 	}
 }
 
+HWND NppSmi::GetCurrentScintilla() const {
+	int which = -1;
+	SendMessage(m_hNpp, NPPM_GETCURRENTSCINTILLA, 0, reinterpret_cast<LPARAM>(&which));
+	return which == 0 ? m_hSc1 : m_hSc2;
+}
+
+const SmiTimeline& NppSmi::GetTimeline() {
+	if (!m_isTimelineValid) {
+		const ScintillaTextSource source(GetCurrentScintilla());
+		m_timeline.Build(source.GetRange(0, source.GetLength()));
+		m_isTimelineValid = true;
+	}
+	return m_timeline;
+}
+
+void NppSmi::UpdateTimeline(const SCNotification& notification) {
+	if (!m_isTimelineValid || !(notification.modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+		return;
+
+	// Both views send this when they share the document; the index follows the active one only.
+	const auto hScintilla = GetCurrentScintilla();
+	if (notification.nmhdr.hwndFrom != hScintilla)
+		return;
+
+	const auto length = static_cast<size_t>(notification.length);
+	const auto inserted = !!(notification.modificationType & SC_MOD_INSERTTEXT);
+	const auto changed = m_timeline.Update(ScintillaTextSource(hScintilla), notification.position, inserted ? 0 : length, inserted ? length : 0, notification.linesAdded);
+
+	// Issues of a Sync depend on its neighbors as well.
+	if (m_config.lint && m_isCurrentDocumentSMI && m_lintIndicator >= 0)
+		LintRange(hScintilla, changed.first == 0 ? 0 : changed.first - 1, changed.second + 1);
+}
+
+void NppSmi::AllocateLintIndicator() {
+	int indicator;
+	if (!SendMessage(m_hNpp, NPPM_ALLOCATEINDICATOR, 1, reinterpret_cast<LPARAM>(&indicator)))
+		return;
+
+	// Indicator styles belong to the views, not to the documents shown in them.
+	m_lintIndicator = indicator;
+	for (const auto hView : { m_hSc1, m_hSc2 }) {
+		SendMessage(hView, SCI_INDICSETSTYLE, m_lintIndicator, INDIC_SQUIGGLE);
+		SendMessage(hView, SCI_INDICSETFORE, m_lintIndicator, RGB(0xE0, 0x20, 0x20));
+	}
+}
+
+void NppSmi::LintDocument() {
+	if (m_lintIndicator < 0)
+		return;
+
+	// A document not to be linted is left alone unless it has marks, as after linting was turned off or it was saved as another type.
+	// The run of indicator values at the start reaches the end of an unmarked document.
+	const auto hScintilla = GetCurrentScintilla();
+	const auto lint = m_config.lint && m_isCurrentDocumentSMI;
+	const auto length = SendMessage(hScintilla, SCI_GETLENGTH, 0, 0);
+	if (!lint && SendMessage(hScintilla, SCI_INDICATORVALUEAT, m_lintIndicator, 0) == 0 && SendMessage(hScintilla, SCI_INDICATOREND, m_lintIndicator, 0) >= length)
+		return;
+
+	SendMessage(hScintilla, SCI_SETINDICATORCURRENT, m_lintIndicator, 0);
+	SendMessage(hScintilla, SCI_INDICATORCLEARRANGE, 0, length);
+	if (lint)
+		LintRange(hScintilla, 0, GetTimeline().Size());
+}
+
+void NppSmi::LintRange(HWND hScintilla, const size_t first, size_t end) {
+	end = std::min(end, m_timeline.Size());
+	const auto clearBegin = first == 0 || first >= end ? 0 : m_timeline.GetOffset(first);
+	const auto clearEnd = end == m_timeline.Size() ? static_cast<size_t>(SendMessage(hScintilla, SCI_GETLENGTH, 0, 0)) : m_timeline.GetOffset(end - 1) + m_timeline.GetTagLength(end - 1);
+
+	// Called from SCN_MODIFIED too; indicators are not part of the text, so changing them there is allowed.
+	SendMessage(hScintilla, SCI_SETINDICATORCURRENT, m_lintIndicator, 0);
+	SendMessage(hScintilla, SCI_INDICATORCLEARRANGE, clearBegin, clearEnd - clearBegin);
+
+	SmiLint::Options options;
+	options.minDuration = m_config.lintMinDuration;
+	for (auto i = first; i < end; ++i) {
+		if (const auto issues = SmiLint::Check(m_timeline, i, options)) {
+			SendMessage(hScintilla, SCI_SETINDICATORVALUE, issues, 0);
+			SendMessage(hScintilla, SCI_INDICATORFILLRANGE, m_timeline.GetOffset(i), m_timeline.GetTagLength(i));
+		}
+	}
+}
+
 void NppSmi::DetermineCurrentDocumentIsSmi() {
 	TCHAR extension[MAX_PATH];
 	SendMessage(m_hNpp, NPPM_GETEXTPART, MAX_PATH, reinterpret_cast<LPARAM>(extension));
@@ -204,6 +383,11 @@ void NppSmi::DetermineCurrentDocumentIsSmi() {
 
 // ReSharper disable CppMemberFunctionMayBeStatic CppMemberFunctionMayBeConst
 LRESULT NppSmi::OnBeforeNppWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+	if (uMsg == WM_PLAYER_COMMAND_FAILED) {
+		if (m_config.autoOpenMedia)
+			OpenMediaForUnreachablePlayer();
+		return 0;
+	}
 	return CallWindowProc(m_prevWndProc, hWnd, uMsg, wParam, lParam);
 }
 
@@ -237,6 +421,8 @@ LRESULT NppSmi::LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
 					switch (wParam) {
 						case WM_KEYDOWN:
 						case WM_SYSKEYDOWN:
+							m_lastShortcutKey.cmdId = fn._cmdID;
+							m_lastShortcutKey.time = p.time;
 							PostMessage(m_hNpp, WM_COMMAND, fn._cmdID, 0);
 						default:
 							// does nothing
@@ -316,28 +502,18 @@ SSTRING NppSmi::FindOrAskSimilarMediaFile() const {
 void NppSmi::TryOpenMedia() {
 	const auto h = CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>([](PVOID p) -> DWORD {
 		NppSmi* const self = reinterpret_cast<NppSmi*>(p);
-		SSTRING mpcHcPath;
-		bool mpcHcFound;
-		std::tie(mpcHcFound, mpcHcPath) = MpcHcRemote::GetInstallationPath();
-		if (!mpcHcFound)
-			MessageBox(self->m_hNpp, mpcHcPath.c_str(), TEXT("NppSmi Error"), MB_ICONERROR | MB_OK);
+		std::wstring error;
+		if (!self->m_player->CanOpen(error)) {
+			MessageBoxW(self->m_hNpp, error.c_str(), L"NppSmi Error", MB_ICONERROR | MB_OK);
+			return 0;
+		}
 
 		const auto mediaFile = self->FindOrAskSimilarMediaFile();
 		if (mediaFile.empty())
 			return 0;
 
-		STARTUPINFO si;
-		PROCESS_INFORMATION pi;
-		ZeroMemory(&si, sizeof si);
-		ZeroMemory(&pi, sizeof pi);
-		si.cb = sizeof si;
-
-		auto commandLine = TEXT("\"") + mpcHcPath + TEXT("\" \"") + mediaFile + TEXT("\"");
-		if (CreateProcess(mpcHcPath.c_str(), &commandLine[0], nullptr, nullptr, false, 0, nullptr, nullptr, &si, &pi)) {
-			CloseHandle(pi.hProcess);
-			CloseHandle(pi.hThread);
-		} else
-			self->FormatMessageAndShowError(GetLastError());
+		if (!self->m_player->Open(mediaFile, error))
+			MessageBoxW(self->m_hNpp, error.c_str(), L"NppSmi", MB_OK | MB_ICONERROR);
 
 		return 0;
 	}), this, 0, nullptr);
@@ -347,6 +523,16 @@ void NppSmi::TryOpenMedia() {
 		CloseHandle(h);
 }
 
+void NppSmi::OpenMediaForUnreachablePlayer() {
+	// Keys pressed while the player is still starting up fail as well; they should not open it again.
+	const auto now = std::chrono::steady_clock::now();
+	if (m_hasOpenedMediaForUnreachablePlayer && now - m_lastOpenedMediaForUnreachablePlayer < REOPEN_MEDIA_INTERVAL)
+		return;
+	m_hasOpenedMediaForUnreachablePlayer = true;
+	m_lastOpenedMediaForUnreachablePlayer = now;
+	TryOpenMedia();
+}
+
 void NppSmi::FormatMessageAndShowError(DWORD dwMessageId) const {
 	LPTSTR errorText = nullptr;
 
@@ -358,7 +544,7 @@ void NppSmi::FormatMessageAndShowError(DWORD dwMessageId) const {
 		nullptr);
 
 	if (errorText) {
-		SSTRING str = TEXT("Could not open MPC-HC: ") + SSTRING(errorText);
+		SSTRING str = TEXT("Could not open the player: ") + SSTRING(errorText);
 		MessageBox(m_hNpp, str.c_str(), TEXT("NppSmi"), MB_OK | MB_ICONERROR);
 		LocalFree(errorText);
 	}
@@ -369,12 +555,28 @@ void NppSmi::MenuFunctionToggleForceShortcutIfSmi() {
 }
 
 
+std::chrono::steady_clock::time_point NppSmi::GetCommandTime(const int menuIndex) {
+	// Commands posted by the keyboard hook carry the key press time; the rest were sent while handling
+	// the key press or the click that triggered them, so the time of the message being handled is close enough.
+	auto eventTime = static_cast<DWORD>(GetMessageTime());
+	if (m_lastShortcutKey.cmdId != 0 && m_lastShortcutKey.cmdId == static_cast<UINT>(m_menuFunctions[menuIndex]._cmdID)) {
+		eventTime = m_lastShortcutKey.time;
+		m_lastShortcutKey.cmdId = 0;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	const auto delay = GetTickCount() - eventTime;
+	if (delay > MAX_COMMAND_DELAY)
+		return now;
+	return now - std::chrono::milliseconds(delay);
+}
+
 void NppSmi::MenuFunctionInsertBeginningTimecode() {
-	const auto time = MpcHcRemote::GetCurrentPlayerTimestamp();
+	const auto time = m_player->GetPositionAt(GetCommandTime(m_menuIndexInsertBeginningTimecode));
 
 	if (time == -1) {
 		if (m_config.autoOpenMedia)
-			TryOpenMedia();
+			OpenMediaForUnreachablePlayer();
 		return;
 	}
 
@@ -386,10 +588,10 @@ void NppSmi::MenuFunctionInsertBeginningTimecode() {
 	std::string newSync(512, '\0');
 	newSync.resize(snprintf(&newSync[0], newSync.capacity(), "<Sync Start=%" PRId64 "><P>", time));
 
-	std::smatch match;
-	const auto isReplacing = std::regex_search(line, match, UsefulRegexs::SYNC_MATCHER) && match.size() > 1;
+	SmiParser::SyncTag tag;
+	const auto isReplacing = SmiParser::FindSyncTag(line, 0, tag);
 	if (isReplacing) {
-		worker.SetAnchor(match.str(0).length() + worker.GetPositionFromLine(curLine));
+		worker.SetAnchor(tag.offset + tag.length + worker.GetPositionFromLine(curLine));
 		worker.ReplaceSelection(newSync);
 	} else
 		worker.AddText(newSync);
@@ -406,9 +608,9 @@ void NppSmi::MenuFunctionInsertBeginningTimecode() {
 }
 
 void NppSmi::MenuFunctionInsertEndingTimecode() {
-	const auto time = MpcHcRemote::GetCurrentPlayerTimestamp();
+	const auto time = m_player->GetPositionAt(GetCommandTime(m_menuIndexInsertEndingTimecode));
 	if (time == -1) {
-		TryOpenMedia();
+		OpenMediaForUnreachablePlayer();
 		return;
 	}
 
@@ -429,48 +631,138 @@ void NppSmi::MenuFunctionOpenMedia() {
 }
 
 void NppSmi::MenuFunctionPlayOrPause() {
-	if (!MpcHcRemote::SendCommand(MpcHcRemote::MpcHcCommand::PLAY_PAUSE)) {
-		if (m_config.autoOpenMedia)
-			TryOpenMedia();
-	}
+	m_player->PlayPause();
 }
 
 void NppSmi::MenuFunctionGoToCurrentLine() {
 	ScintillaWorker worker(this);
-	auto curLine = worker.GetCurrentLineNumber();
-	do {
-		const auto line = worker.GetLine(curLine);
-		std::smatch match;
-		if (std::regex_search(line, match, UsefulRegexs::SYNC_MATCHER) && match.size() > 1) {
-			const auto pos = strtoll(match.str(2).c_str(), nullptr, 10);
-			if (!MpcHcRemote::Seek(pos))
-				if (m_config.autoOpenMedia)
-					TryOpenMedia();
-			break;
-		}
-	} while (--curLine != static_cast<size_t>(-1));
+	const auto& timeline = GetTimeline();
+	const auto index = timeline.FindAtOrBeforeLine(worker.GetCurrentLineNumber());
+	if (index == SmiTimeline::npos)
+		return;
+
+	m_player->Seek(timeline.GetStart(index));
 }
 
 void NppSmi::MenuFunctionRewind() {
-	const auto time = MpcHcRemote::GetCurrentPlayerTimestamp();
+	m_player->SeekBy(-3000);
+}
+
+void NppSmi::MenuFunctionFastForward() {
+	m_player->SeekBy(3000);
+}
+
+void NppSmi::MenuFunctionShiftTimingsToPlayer() {
+	const auto time = m_player->GetPositionAt(GetCommandTime(m_menuIndexShiftTimingsToPlayer));
 	if (time == -1) {
 		if (m_config.autoOpenMedia)
-			TryOpenMedia();
-	} else
-		MpcHcRemote::Seek(time - 3000);
+			OpenMediaForUnreachablePlayer();
+		return;
+	}
+
+	ScintillaWorker worker(this);
+	const auto& timeline = GetTimeline();
+	const auto index = timeline.FindAtOrBeforeLine(worker.GetCurrentLineNumber());
+	if (index == SmiTimeline::npos)
+		return;
+	ShiftSelectedTimings(worker, time - timeline.GetStart(index));
 }
 
-void NppSmi::MenuFunctionFastForward() {
-	const auto time = MpcHcRemote::GetCurrentPlayerTimestamp();
+void NppSmi::MenuFunctionShiftTimingsBy() {
+	int64_t delta;
+	if (!m_shiftTimingsDialog.DoModal(delta))
+		return;
+
+	ScintillaWorker worker(this);
+	ShiftSelectedTimings(worker, delta);
+}
+
+void NppSmi::ShiftSelectedTimings(ScintillaWorker& worker, const int64_t delta) {
+	const auto text = worker.GetText();
+	size_t from = 0, to = text.size();
+	if (!worker.IsSelectionEmpty()) {
+		const auto firstLine = worker.GetLineNumberFromPosition(worker.GetSelectionStart());
+		auto lastLine = worker.GetLineNumberFromPosition(worker.GetSelectionEnd());
+		// Selecting whole lines ends the selection at the start of the line after them, which is not meant.
+		if (lastLine > firstLine && worker.GetPositionFromLine(lastLine) == worker.GetSelectionEnd())
+			--lastLine;
+		from = worker.GetPositionFromLine(firstLine);
+		to = worker.GetLineEndPosition(lastLine);
+	}
+
+	// One replace from the first changed value to the last, so that it is a single step to undo.
+	SmiRetime::Edit edit;
+	if (SmiRetime::Shift(text, from, to, delta, edit)) {
+		worker.ReplaceRange(edit.begin, edit.end, edit.text);
+		// The anchors refer to the old values.
+		m_anchors.clear();
+	}
+}
+
+void NppSmi::RetimeDocument(const SmiRetime::TimeMap& map) {
+	ScintillaWorker worker(this);
+	const auto text = worker.GetText();
+	SmiRetime::Edit edit;
+	if (SmiRetime::Rewrite(text, 0, text.size(), map, edit)) {
+		worker.ReplaceRange(edit.begin, edit.end, edit.text);
+		m_anchors.clear();
+	}
+}
+
+void NppSmi::MenuFunctionAddSyncAnchor() {
+	const auto time = m_player->GetPositionAt(GetCommandTime(m_menuIndexAddSyncAnchor));
 	if (time == -1) {
 		if (m_config.autoOpenMedia)
-			TryOpenMedia();
-	} else
-		MpcHcRemote::Seek(time + 3000);
+			OpenMediaForUnreachablePlayer();
+		return;
+	}
+
+	ScintillaWorker worker(this);
+	const auto& timeline = GetTimeline();
+	const auto index = timeline.FindAtOrBeforeLine(worker.GetCurrentLineNumber());
+	if (index == SmiTimeline::npos)
+		return;
+
+	// Marking the same caption again corrects the earlier mark.
+	const auto start = timeline.GetStart(index);
+	const auto existing = std::find_if(m_anchors.begin(), m_anchors.end(), [start](const SmiRetime::Anchor& anchor) { return anchor.start == start; });
+	if (existing != m_anchors.end())
+		existing->target = time;
+	else
+		m_anchors.push_back({ start, time });
+}
+
+void NppSmi::MenuFunctionFitTimingsToAnchors() {
+	if (m_anchors.empty())
+		return;
+
+	RetimeDocument(m_config.anchorFit == "leastSquares" ? SmiRetime::FitLine(m_anchors) : SmiRetime::Interpolate(m_anchors));
+	// Used up even if no value had to move.
+	m_anchors.clear();
+}
+
+void NppSmi::MenuFunctionClearSyncAnchors() {
+	m_anchors.clear();
+}
+
+void NppSmi::MenuFunctionToggleLint() {
+	SetMenuChecked(m_menuIndexToggleLint, m_config.lint = !m_config.lint);
+	LintDocument();
+}
+
+void NppSmi::MenuFunctionSortCaptions() {
+	ScintillaWorker worker(this);
+	const auto text = worker.GetText();
+	SmiRetime::Edit edit;
+	if (SmiSort::Sort(text, edit))
+		worker.ReplaceRange(edit.begin, edit.end, edit.text);
 }
 
 const TCHAR* const NppSmi::PLUGIN_NAME = TEXT("NppSmi");
 const TCHAR* const NppSmi::PLUGIN_CONFIG_FILENAME = TEXT("NppSmi.json");
+const DWORD NppSmi::MAX_COMMAND_DELAY = 2000;
+const std::chrono::milliseconds NppSmi::REOPEN_MEDIA_INTERVAL(5000);
+const UINT NppSmi::WM_PLAYER_COMMAND_FAILED = RegisterWindowMessage(TEXT("NppSmi.PlayerCommandFailed"));
 std::shared_ptr<NppSmi> NppSmi::instance = nullptr;
 
 #define MENU_FN_SHORTCUT(DESCRIPTION, FUNCTION, CTRL, ALT, SHIFT, VK) menu.insert(menu.end(),{ TEXT(DESCRIPTION), []() { instance->MenuFunction##FUNCTION(); }, 0, false, (keys->push_back({CTRL, ALT, SHIFT, VK}), &(keys->back()))})
@@ -491,5 +783,13 @@ std::tuple<std::vector<struct FuncItem>, std::shared_ptr<std::list<struct Shortc
 	MENU_FN_SHORTCUT("Go to current line", GoToCurrentLine, false, false, false, VK_F8);
 	MENU_FN_SHORTCUT("Rewind", Rewind, true, true, false, VK_LEFT);
 	MENU_FN_SHORTCUT("Fast forward", FastForward, true, true, false, VK_RIGHT);
+	MENU_SEPARATOR();
+	MENU_FN("Shift timings to player position", ShiftTimingsToPlayer);
+	MENU_FN("Shift timings by...", ShiftTimingsBy);
+	MENU_FN("Add sync anchor at player position", AddSyncAnchor);
+	MENU_FN("Fit timings to sync anchors", FitTimingsToAnchors);
+	MENU_FN("Clear sync anchors", ClearSyncAnchors);
+	MENU_FN("Sort captions by start", SortCaptions);
+	MENU_FN_CHECK("Mark timing issues", ToggleLint, m_config.lint);
 	return std::make_tuple(menu, keys);
 }
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <Windows.h>
+#include <chrono>
 #include <memory>
 #include <string>
+#include "PlayerBackend.h"
+#include "ShiftTimingsDialog.h"
+#include "SmiRetime.h"
+#include "SmiTimeline.h"
 
 #pragma warning(push, 0)        
 #include "nlohmann/json.hpp"
@@ -34,11 +39,47 @@ private:
 	struct {
 		bool autoOpenMedia = true;
 		bool forceShortcutIfSmi = true;
+		unsigned pollingInterval = 100; // ms; 0 asks the player on every use instead
+		std::string player = "mpc-hc"; // or "mpv"
+		unsigned webServerPort = 0; // MPC-HC web interface port; 0 reads it from MPC-HC's settings
+		std::string mpcHcIni; // mpc-hc.ini of a portable MPC-HC; empty reads the settings from the registry
+		std::string mpvPipe = R"(\\.\pipe\mpvsocket)";
+		std::string mpvPath = "mpv.exe";
+		std::string anchorFit = "piecewise"; // or "leastSquares"
+		bool lint = true;
+		unsigned lintMinDuration = 100; // ms; a Sync shown for less is marked
 	} m_config;
 
+	// Chosen by the "player" config value at startup. Active, that is polling if it needs to, only while an SMI document is.
+	std::unique_ptr<PlayerBackend> m_player;
+
 	bool m_isCurrentDocumentSMI = false;
 	void DetermineCurrentDocumentIsSmi();
 
+	// Timeline of the active document; built on first use and kept up to date from SCN_MODIFIED.
+	SmiTimeline m_timeline;
+	bool m_isTimelineValid = false;
+	const SmiTimeline& GetTimeline();
+
+	// Collected for the active document by "Add sync anchor" until they are fitted to or cleared.
+	std::vector<SmiRetime::Anchor> m_anchors;
+
+	// Rewrites every Start value of the active document in one undoable edit.
+	void RetimeDocument(const SmiRetime::TimeMap& map);
+
+	// Timing issues are marked on the Sync tags with this indicator, its value being the SmiLint issue bits.
+	// Allocated from Notepad++ once it is ready; -1 before, or if Notepad++ is too old to allocate one, and nothing is marked then.
+	int m_lintIndicator = -1;
+	void AllocateLintIndicator();
+	// If linting is on for the active document, marks every Sync again; otherwise clears the marks it was left with, if any.
+	void LintDocument();
+	// Checks the timeline entries [first, end) and marks the ones with issues; marks from the start of the first
+	// entry to the end of the last are cleared first, or from and to the ends of the document at either end of the timeline.
+	void LintRange(HWND hScintilla, size_t first, size_t end);
+	void UpdateTimeline(const struct SCNotification& notification);
+
+	HWND GetCurrentScintilla() const;
+
 	template<typename T>
 	static T ReadConfig(const nlohmann::json& json, std::initializer_list<std::string> path, T defaultValue) {
 		auto itemIndex = 0;
@@ -68,16 +109,42 @@ private:
 
 	class ScintillaWorker;
 
+	// Adds delta to the Start values in the selected lines, whole lines from the first to the last one selected,
+	// or in the whole document if nothing is selected, in one undoable edit.
+	void ShiftSelectedTimings(ScintillaWorker& worker, int64_t delta);
+	ShiftTimingsDialog m_shiftTimingsDialog;
+
+	// Posted to the Notepad++ window when a queued player command fails, to open the media from the UI thread.
+	static const UINT WM_PLAYER_COMMAND_FAILED;
+
 	WNDPROC m_prevWndProc;
 	LRESULT OnBeforeNppWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 	HHOOK m_hhkLowLevelKeyboard = nullptr;
 	LRESULT LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
 
+	// Command last posted by the keyboard hook, and when its key was pressed (GetTickCount).
+	struct {
+		UINT cmdId = 0;
+		DWORD time = 0;
+	} m_lastShortcutKey;
+
+	// Older events are not trusted to be what triggered the command; such commands use the current time.
+	static const DWORD MAX_COMMAND_DELAY;
+
+	// When the user asked for the menu command being run, so that timecodes can be back-dated to it.
+	std::chrono::steady_clock::time_point GetCommandTime(int menuIndex);
+
 	void SetMenuChecked(int menuIndex, bool isChecked);
 	
 	SSTRING FindOrAskSimilarMediaFile() const;
 	void TryOpenMedia();
+
+	// TryOpenMedia, unless it was already done for a failure within REOPEN_MEDIA_INTERVAL.
+	void OpenMediaForUnreachablePlayer();
+	bool m_hasOpenedMediaForUnreachablePlayer = false;
+	std::chrono::steady_clock::time_point m_lastOpenedMediaForUnreachablePlayer;
+	static const std::chrono::milliseconds REOPEN_MEDIA_INTERVAL;
 	void FormatMessageAndShowError(DWORD dwMessageId) const;
 
 #pragma push_macro("MENU_FUNCTION")
@@ -95,6 +162,14 @@ private:
 	MENU_FUNCTION(GoToCurrentLine)
 	MENU_FUNCTION(Rewind)
 	MENU_FUNCTION(FastForward)
+	MENU_SEPARATOR(1)
+	MENU_FUNCTION(ShiftTimingsToPlayer)
+	MENU_FUNCTION(ShiftTimingsBy)
+	MENU_FUNCTION(AddSyncAnchor)
+	MENU_FUNCTION(FitTimingsToAnchors)
+	MENU_FUNCTION(ClearSyncAnchors)
+	MENU_FUNCTION(SortCaptions)
+	MENU_FUNCTION(ToggleLint)
 #pragma pop_macro("MENU_FUNCTION")
 #pragma pop_macro("MENU_SEPARATOR")
 
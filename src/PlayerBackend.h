@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+// A media player the plugin drives. Commands may be sent asynchronously; a command that fails
+// after its function has returned is reported through the failure handler, on any thread.
+class PlayerBackend {
+public:
+	enum class State {
+		STOPPED,
+		PAUSED,
+		PLAYING
+	};
+
+	virtual ~PlayerBackend() = default;
+
+	// Background work such as polling runs only while active; an inactive backend still answers, only slower.
+	virtual void SetActive(bool active) = 0;
+	// Stops every thread of the backend. Must be called before the DLL is unloaded.
+	virtual void Shutdown() = 0;
+	virtual void SetFailureHandler(std::function<void()> handler) = 0;
+
+	// Position in ms the player had, or will have, at time; -1 if the player cannot be reached.
+	virtual int64_t GetPositionAt(std::chrono::steady_clock::time_point time) = 0;
+	int64_t GetPosition() { return GetPositionAt(std::chrono::steady_clock::now()); }
+	// Stopped as well if the player cannot be reached.
+	virtual State GetState() = 0;
+
+	virtual void Seek(int64_t position) = 0;
+	virtual void SeekBy(int64_t delta) = 0;
+	virtual void PlayPause() = 0;
+
+	// Whether Open can work at all; error tells the user why not.
+	virtual bool CanOpen(std::wstring& error) = 0;
+	// Opens the media in the player, starting the player if needed. May block; call off the UI thread.
+	virtual bool Open(const std::filesystem::path& mediaPath, std::wstring& error) = 0;
+};
@@ -0,0 +1,210 @@
+#include "SamiDocument.h"
+#include "SmiParser.h"
+#include <limits>
+
+static bool IsSpace(const char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static std::string_view Trim(std::string_view s) {
+	while (!s.empty() && IsSpace(s.front()))
+		s.remove_prefix(1);
+	while (!s.empty() && IsSpace(s.back()))
+		s.remove_suffix(1);
+	return s;
+}
+
+static bool StartsWithIgnoreCase(std::string_view s, std::string_view lowercase) {
+	if (s.size() < lowercase.size())
+		return false;
+	for (size_t i = 0; i < lowercase.size(); ++i) {
+		const auto c = s[i] >= 'A' && s[i] <= 'Z' ? s[i] + ('a' - 'A') : s[i];
+		if (c != lowercase[i])
+			return false;
+	}
+	return true;
+}
+
+// Finds lowercase in text case-insensitively; lowercase must start with '<'.
+static size_t FindTag(std::string_view text, std::string_view lowercase, size_t from = 0) {
+	for (auto pos = text.find('<', from); pos != std::string_view::npos; pos = text.find('<', pos + 1)) {
+		if (StartsWithIgnoreCase(text.substr(pos), lowercase))
+			return pos;
+	}
+	return std::string_view::npos;
+}
+
+// Finds "<p" or "</p" that is followed by whitespace, '/' or '>'.
+static size_t FindParagraphTag(std::string_view text, size_t from) {
+	for (auto pos = text.find('<', from); pos != std::string_view::npos; pos = text.find('<', pos + 1)) {
+		auto p = pos + 1;
+		if (p < text.size() && text[p] == '/')
+			++p;
+		if (p + 1 < text.size() && (text[p] | 0x20) == 'p' && (IsSpace(text[p + 1]) || text[p + 1] == '>' || text[p + 1] == '/'))
+			return pos;
+	}
+	return std::string_view::npos;
+}
+
+// Saturates like Start does.
+static int64_t ParseTime(std::string_view s) {
+	if (s.empty())
+		return SamiDocument::NO_TIME;
+	int64_t value = 0;
+	for (const auto c : s) {
+		if (c < '0' || c > '9')
+			return SamiDocument::NO_TIME;
+		const auto digit = c - '0';
+		value = value > (std::numeric_limits<int64_t>::max() - digit) / 10 ? std::numeric_limits<int64_t>::max() : value * 10 + digit;
+	}
+	return value;
+}
+
+void SamiDocument::Clear() {
+	m_classNames.Clear();
+	m_classes.clear();
+	m_firstSync = m_lastSync = nullptr;
+	m_syncCount = 0;
+	m_arena.Release();
+}
+
+uint32_t SamiDocument::InternClass(std::string_view name) {
+	const auto result = m_classNames.Intern(name);
+	if (result.second) {
+		m_classes.emplace_back();
+		m_classes.back().name = m_arena.CopyString(name);
+	}
+	return result.first;
+}
+
+// Reads ".NAME { Name: ...; lang: ...; SAMIType: ...; }" rules; other selectors are skipped.
+void SamiDocument::ParseStyles(std::string_view css) {
+	size_t pos = 0;
+	while (true) {
+		const auto open = css.find('{', pos);
+		if (open == std::string_view::npos)
+			break;
+		const auto close = css.find('}', open);
+		if (close == std::string_view::npos)
+			break;
+
+		auto selector = Trim(css.substr(pos, open - pos));
+		if (StartsWithIgnoreCase(selector, "<!--"))
+			selector = Trim(selector.substr(4));
+		pos = close + 1;
+		if (selector.size() < 2 || selector[0] != '.')
+			continue;
+
+		auto& styleClass = m_classes[InternClass(Trim(selector.substr(1)))];
+		styleClass.isDeclared = true;
+
+		auto body = css.substr(open + 1, close - open - 1);
+		while (!body.empty()) {
+			const auto semicolon = body.find(';');
+			const auto declaration = body.substr(0, semicolon);
+			body = semicolon == std::string_view::npos ? std::string_view() : body.substr(semicolon + 1);
+
+			const auto colon = declaration.find(':');
+			if (colon == std::string_view::npos)
+				continue;
+			const auto name = Trim(declaration.substr(0, colon));
+			const auto value = m_arena.CopyString(Trim(declaration.substr(colon + 1)));
+			if (name.size() == 4 && StartsWithIgnoreCase(name, "name"))
+				styleClass.displayName = value;
+			else if (name.size() == 4 && StartsWithIgnoreCase(name, "lang"))
+				styleClass.lang = value;
+			else if (name.size() == 8 && StartsWithIgnoreCase(name, "samitype"))
+				styleClass.samiType = value;
+		}
+	}
+}
+
+// block is everything between the end of a Sync tag and the next Sync; text before the first <P> belongs to an unclassed paragraph.
+const SamiDocument::Paragraph* SamiDocument::ParseParagraphs(std::string_view block) {
+	const Paragraph* first = nullptr;
+	Paragraph* last = nullptr;
+	const auto append = [&](const uint32_t classId, std::string_view text) {
+		text = Trim(text);
+		if (text.empty() && classId == NO_CLASS)
+			return;
+		const auto paragraph = m_arena.New<Paragraph>();
+		paragraph->classId = classId;
+		paragraph->text = m_arena.CopyString(text);
+		if (last == nullptr)
+			first = paragraph;
+		else
+			last->next = paragraph;
+		last = paragraph;
+	};
+
+	auto classId = NO_CLASS;
+	size_t textBegin = 0;
+	auto pos = FindParagraphTag(block, 0);
+	while (true) {
+		const auto textEnd = pos == std::string_view::npos ? block.size() : pos;
+		if (textBegin != std::string_view::npos)
+			append(classId, block.substr(textBegin, textEnd - textBegin));
+		if (pos == std::string_view::npos)
+			break;
+
+		const auto tagEnd = block.find('>', pos);
+		if (tagEnd == std::string_view::npos)
+			break;
+		const auto tag = block.substr(pos, tagEnd + 1 - pos);
+		if (tag[1] == '/') {
+			// text after </P> is not part of any paragraph
+			textBegin = std::string_view::npos;
+		} else {
+			std::string_view className;
+			classId = SmiParser::FindAttribute(tag, "class", className) && !className.empty() ? InternClass(className) : NO_CLASS;
+			textBegin = tagEnd + 1;
+		}
+		pos = FindParagraphTag(block, tagEnd + 1);
+	}
+	return first;
+}
+
+void SamiDocument::Parse(std::string_view text) {
+	Clear();
+
+	const auto styleBegin = FindTag(text, "<style");
+	if (styleBegin != std::string_view::npos) {
+		const auto cssBegin = text.find('>', styleBegin);
+		const auto styleEnd = FindTag(text, "</style", styleBegin);
+		if (cssBegin != std::string_view::npos && styleEnd != std::string_view::npos && cssBegin < styleEnd)
+			ParseStyles(text.substr(cssBegin + 1, styleEnd - cssBegin - 1));
+	}
+
+	auto bodyEnd = FindTag(text, "</body");
+	if (bodyEnd == std::string_view::npos)
+		bodyEnd = text.size();
+
+	SmiParser::SyncTag tag, next;
+	auto hasTag = SmiParser::FindSyncTag(text, 0, tag);
+	while (hasTag && tag.offset < bodyEnd) {
+		const auto hasNext = SmiParser::FindSyncTag(text, tag.offset + tag.length, next);
+		const auto blockEnd = hasNext && next.offset < bodyEnd ? next.offset : bodyEnd;
+
+		const auto sync = m_arena.New<Sync>();
+		sync->start = tag.start;
+		sync->offset = tag.offset;
+
+		const auto tagText = text.substr(tag.offset, tag.paragraphOffset == std::string_view::npos ? tag.length : tag.paragraphOffset - tag.offset);
+		std::string_view end;
+		if (SmiParser::FindAttribute(tagText, "end", end))
+			sync->end = ParseTime(end);
+
+		const auto blockBegin = tag.paragraphOffset == std::string_view::npos ? tag.offset + tag.length : tag.paragraphOffset;
+		sync->paragraphs = ParseParagraphs(text.substr(blockBegin, blockEnd - blockBegin));
+
+		if (m_lastSync == nullptr)
+			m_firstSync = sync;
+		else
+			m_lastSync->next = sync;
+		m_lastSync = sync;
+		++m_syncCount;
+
+		tag = next;
+		hasTag = hasNext;
+	}
+}
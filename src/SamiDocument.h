@@ -0,0 +1,66 @@
+#pragma once
+#include "Arena.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Object model of a SAMI document: STYLE classes, and Syncs with their paragraphs.
+// Nodes and strings are allocated from one arena owned by the document, so they stay
+// valid after the source buffer is gone and are all freed together.
+class SamiDocument {
+public:
+	static constexpr uint32_t NO_CLASS = UINT32_MAX;
+	static constexpr int64_t NO_TIME = -1;
+
+	struct StyleClass {
+		std::string_view name;
+		std::string_view displayName; // "Name:" property
+		std::string_view lang;
+		std::string_view samiType;
+		bool isDeclared = false; // false if only used by a paragraph
+	};
+
+	struct Paragraph {
+		const Paragraph* next = nullptr;
+		uint32_t classId = NO_CLASS;
+		std::string_view text; // raw inner HTML, trimmed
+	};
+
+	struct Sync {
+		const Sync* next = nullptr;
+		int64_t start = NO_TIME;
+		int64_t end = NO_TIME;
+		size_t offset = 0;
+		const Paragraph* paragraphs = nullptr;
+	};
+
+private:
+	MonotonicArena m_arena;
+	StringInterner m_classNames{ m_arena };
+	std::vector<StyleClass> m_classes;
+	Sync* m_firstSync = nullptr;
+	Sync* m_lastSync = nullptr;
+	size_t m_syncCount = 0;
+
+	uint32_t InternClass(std::string_view name);
+	void ParseStyles(std::string_view css);
+	const Paragraph* ParseParagraphs(std::string_view block);
+
+public:
+	SamiDocument() = default;
+	SamiDocument(const SamiDocument&) = delete;
+	SamiDocument(SamiDocument&&) = delete;
+	SamiDocument& operator =(const SamiDocument&) = delete;
+	SamiDocument& operator =(SamiDocument&&) = delete;
+
+	void Clear();
+	void Parse(std::string_view text);
+
+	const std::vector<StyleClass>& GetClasses() const { return m_classes; }
+	uint32_t FindClass(std::string_view name) { return m_classNames.Find(name); }
+
+	const Sync* GetFirstSync() const { return m_firstSync; }
+	size_t GetSyncCount() const { return m_syncCount; }
+
+	const MonotonicArena& GetArena() const { return m_arena; }
+};
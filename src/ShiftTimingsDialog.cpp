@@ -0,0 +1,51 @@
+#include "ShiftTimingsDialog.h"
+#include "SmiRetime.h"
+#include "resource.h"
+
+bool ShiftTimingsDialog::DoModal(int64_t& offset) {
+	const auto result = DialogBoxParam(_hInst, MAKEINTRESOURCE(IDD_SHIFT_TIMINGS), _hParent, dlgProc, reinterpret_cast<LPARAM>(this));
+	// EndDialog has destroyed it already; StaticDialog would destroy it again otherwise.
+	_hSelf = nullptr;
+	if (result != IDOK)
+		return false;
+	offset = m_offset;
+	return true;
+}
+
+INT_PTR CALLBACK ShiftTimingsDialog::run_dlgProc(const UINT message, const WPARAM wParam, LPARAM) {
+	switch (message) {
+		case WM_INITDIALOG:
+			goToCenter();
+			SetDlgItemTextA(_hSelf, IDC_SHIFT_AMOUNT, m_text.c_str());
+			SendDlgItemMessage(_hSelf, IDC_SHIFT_AMOUNT, EM_SETSEL, 0, -1);
+			return TRUE;
+
+		case WM_COMMAND:
+			switch (LOWORD(wParam)) {
+				case IDOK: {
+					char text[64];
+					GetDlgItemTextA(_hSelf, IDC_SHIFT_AMOUNT, text, sizeof text);
+					if (!SmiRetime::ParseOffset(text, m_offset)) {
+						// Left open to correct.
+						MessageBeep(MB_ICONWARNING);
+						SetFocus(GetDlgItem(_hSelf, IDC_SHIFT_AMOUNT));
+						SendDlgItemMessage(_hSelf, IDC_SHIFT_AMOUNT, EM_SETSEL, 0, -1);
+						return TRUE;
+					}
+					m_text = text;
+					EndDialog(_hSelf, IDOK);
+					return TRUE;
+				}
+				case IDCANCEL:
+					EndDialog(_hSelf, IDCANCEL);
+					return TRUE;
+				default:
+					break;
+			}
+			break;
+
+		default:
+			break;
+	}
+	return FALSE;
+}
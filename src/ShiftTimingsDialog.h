@@ -0,0 +1,17 @@
+#pragma once
+#include "DockingFeature/StaticDialog.h"
+#include <cstdint>
+#include <string>
+
+// Asks for the amount to shift timings by, as SmiRetime::ParseOffset reads it, offering the last one given again.
+class ShiftTimingsDialog : public StaticDialog {
+	std::string m_text;
+	int64_t m_offset = 0;
+
+protected:
+	INT_PTR CALLBACK run_dlgProc(UINT message, WPARAM wParam, LPARAM lParam) override;
+
+public:
+	// Shows the dialog over the window given to init until it is closed; false if it was cancelled.
+	bool DoModal(int64_t& offset);
+};
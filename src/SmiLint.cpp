@@ -0,0 +1,53 @@
+#include "SmiLint.h"
+
+namespace SmiLint {
+	uint32_t Check(const SmiTimeline& timeline, const size_t index, const Options& options) {
+		const auto start = timeline.GetStart(index), end = timeline.GetEnd(index);
+		uint32_t issues = 0;
+		if (index > 0 && start < timeline.GetStart(index - 1))
+			issues |= OUT_OF_ORDER;
+		if (end >= 0 && end <= start)
+			return issues | ENDS_BEFORE_START;
+
+		// A next Sync that starts earlier is reported on that one, as out of order.
+		if (index + 1 < timeline.Size()) {
+			const auto next = timeline.GetStart(index + 1);
+			if (next == start)
+				issues |= ZERO_DURATION;
+			else if (next > start) {
+				if (end > next)
+					issues |= OVERLAP;
+				const auto duration = (end >= 0 && end < next ? end : next) - start;
+				if (duration < options.minDuration)
+					issues |= SHORT_DURATION;
+			}
+		} else if (end >= 0 && end - start < options.minDuration)
+			issues |= SHORT_DURATION;
+		return issues;
+	}
+
+	std::vector<Finding> CheckAll(const SmiTimeline& timeline, const Options& options) {
+		std::vector<Finding> findings;
+		for (size_t i = 0; i < timeline.Size(); ++i) {
+			if (const auto issues = Check(timeline, i, options))
+				findings.push_back({ i, issues });
+		}
+		return findings;
+	}
+
+	const char* Describe(const Issue issue) {
+		switch (issue) {
+			case OUT_OF_ORDER:
+				return "starts before the Sync before it";
+			case ZERO_DURATION:
+				return "starts together with the next Sync";
+			case SHORT_DURATION:
+				return "too short before its End or the next Sync";
+			case OVERLAP:
+				return "ends after the next Sync starts";
+			case ENDS_BEFORE_START:
+				return "does not end after it starts";
+		}
+		return "";
+	}
+}
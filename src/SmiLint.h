@@ -0,0 +1,33 @@
+#pragma once
+#include "SmiTimeline.h"
+#include <cstdint>
+#include <vector>
+
+namespace SmiLint {
+	enum Issue : uint32_t {
+		OUT_OF_ORDER = 1 << 0, // starts before the Sync before it in the document
+		ZERO_DURATION = 1 << 1, // starts together with the next Sync, so it is never shown
+		SHORT_DURATION = 1 << 2, // shown for less than minDuration, until its End or the next Sync; a short blank Sync is a gap that flickers
+		OVERLAP = 1 << 3, // has an End after the next Sync starts
+		ENDS_BEFORE_START = 1 << 4, // has an End not after its Start, so it is never shown
+	};
+
+	struct Options {
+		int64_t minDuration = 100; // ms
+	};
+
+	// Issue bits of the Sync at index. They depend only on it and the Syncs right before and after it in the document,
+	// so after an edit only the changed entries and one on either side need checking again.
+	uint32_t Check(const SmiTimeline& timeline, size_t index, const Options& options);
+
+	struct Finding {
+		size_t index;
+		uint32_t issues;
+	};
+
+	// Checks every Sync; returns the ones with issues in document order.
+	std::vector<Finding> CheckAll(const SmiTimeline& timeline, const Options& options);
+
+	// Short English description of a single issue bit.
+	const char* Describe(Issue issue);
+};
@@ -0,0 +1,373 @@
+#include "SmiParser.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SMIPARSER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SMIPARSER_TARGET(ISA)
+#else
+#define SMIPARSER_TARGET(ISA) __attribute__((target(ISA)))
+#endif
+#endif
+
+namespace SmiParser {
+	static bool IsSpace(const char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+	}
+
+	static bool IsDigit(const char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	static char ToLower(const char c) {
+		return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+	}
+
+	static bool EqualsIgnoreCase(const char* s, const char* lowercase, const size_t len) {
+		for (size_t i = 0; i < len; ++i)
+			if (ToLower(s[i]) != lowercase[i])
+				return false;
+		return true;
+	}
+
+	size_t CountLineBreaks(std::string_view text) {
+		size_t count = 0;
+		const auto end = text.data() + text.size();
+		for (auto p = text.data(); p < end; ++p) {
+			if (*p == '\n')
+				++count;
+			else if (*p == '\r' && (p + 1 == end || p[1] != '\n'))
+				++count;
+		}
+		return count;
+	}
+
+	bool FindAttribute(std::string_view tag, std::string_view lowercaseName, std::string_view& value) {
+		const auto nameLength = lowercaseName.size();
+		for (size_t pos = 1; pos + nameLength < tag.size(); ++pos) {
+			if (!IsSpace(tag[pos - 1]) || !EqualsIgnoreCase(&tag[pos], lowercaseName.data(), nameLength))
+				continue;
+
+			auto p = pos + nameLength;
+			while (p < tag.size() && IsSpace(tag[p]))
+				++p;
+			if (p == tag.size() || tag[p] != '=')
+				continue;
+			++p;
+			while (p < tag.size() && IsSpace(tag[p]))
+				++p;
+			if (p == tag.size())
+				return false;
+
+			if (tag[p] == '"' || tag[p] == '\'') {
+				const auto close = tag.find(tag[p], p + 1);
+				if (close == std::string_view::npos)
+					return false;
+				value = tag.substr(p + 1, close - p - 1);
+			} else {
+				auto end = p;
+				while (end < tag.size() && !IsSpace(tag[end]) && tag[end] != '>')
+					++end;
+				value = tag.substr(p, end - p);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Checks for "ync" after a "<s" or "<S" at pos.
+	static bool IsSyncAt(const char* data, const size_t size, const size_t pos) {
+		return pos + 5 <= size && EqualsIgnoreCase(data + pos + 2, "ync", 3);
+	}
+
+	static size_t FindSyncCandidateScalar(const char* data, const size_t size, size_t from) {
+		while (from < size) {
+			const auto p = static_cast<const char*>(memchr(data + from, '<', size - from));
+			if (p == nullptr)
+				break;
+			const auto pos = static_cast<size_t>(p - data);
+			if (pos + 1 < size && ToLower(p[1]) == 's' && IsSyncAt(data, size, pos))
+				return pos;
+			from = pos + 1;
+		}
+		return std::string_view::npos;
+	}
+
+#ifdef SMIPARSER_X86
+	// Each bit set in mask marks a '<' followed by 's' or 'S' at pos + bit index.
+	static size_t VerifySyncCandidates(const char* data, const size_t size, const size_t pos, uint32_t mask) {
+		while (mask) {
+			unsigned long bit;
+#ifdef _MSC_VER
+			_BitScanForward(&bit, mask);
+#else
+			bit = static_cast<unsigned long>(__builtin_ctz(mask));
+#endif
+			if (IsSyncAt(data, size, pos + bit))
+				return pos + bit;
+			mask &= mask - 1;
+		}
+		return std::string_view::npos;
+	}
+
+	SMIPARSER_TARGET("sse2")
+	static size_t FindSyncCandidateSse2(const char* data, const size_t size, size_t from) {
+		const auto lt = _mm_set1_epi8('<');
+		const auto s = _mm_set1_epi8('s');
+		const auto caseBit = _mm_set1_epi8(0x20);
+		// the second load reads one byte ahead
+		for (; from + 17 <= size; from += 16) {
+			const auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+			const auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from + 1));
+			const auto hits = _mm_and_si128(_mm_cmpeq_epi8(b0, lt), _mm_cmpeq_epi8(_mm_or_si128(b1, caseBit), s));
+			const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+			if (mask) {
+				const auto pos = VerifySyncCandidates(data, size, from, mask);
+				if (pos != std::string_view::npos)
+					return pos;
+			}
+		}
+		return FindSyncCandidateScalar(data, size, from);
+	}
+
+	SMIPARSER_TARGET("avx2")
+	static size_t FindSyncCandidateAvx2(const char* data, const size_t size, size_t from) {
+		const auto lt = _mm256_set1_epi8('<');
+		const auto s = _mm256_set1_epi8('s');
+		const auto caseBit = _mm256_set1_epi8(0x20);
+		// Two vectors at a time while there is no candidate, which is most of a document.
+		for (; from + 65 <= size; from += 64) {
+			const auto a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+			const auto a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from + 1));
+			const auto b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from + 32));
+			const auto b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from + 33));
+			const auto hitsA = _mm256_and_si256(_mm256_cmpeq_epi8(a0, lt), _mm256_cmpeq_epi8(_mm256_or_si256(a1, caseBit), s));
+			const auto hitsB = _mm256_and_si256(_mm256_cmpeq_epi8(b0, lt), _mm256_cmpeq_epi8(_mm256_or_si256(b1, caseBit), s));
+			if (_mm256_testz_si256(_mm256_or_si256(hitsA, hitsB), _mm256_or_si256(hitsA, hitsB)))
+				continue;
+			auto pos = VerifySyncCandidates(data, size, from, static_cast<uint32_t>(_mm256_movemask_epi8(hitsA)));
+			if (pos == std::string_view::npos)
+				pos = VerifySyncCandidates(data, size, from + 32, static_cast<uint32_t>(_mm256_movemask_epi8(hitsB)));
+			if (pos != std::string_view::npos)
+				return pos;
+		}
+		for (; from + 33 <= size; from += 32) {
+			const auto b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+			const auto b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from + 1));
+			const auto hits = _mm256_and_si256(_mm256_cmpeq_epi8(b0, lt), _mm256_cmpeq_epi8(_mm256_or_si256(b1, caseBit), s));
+			const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+			if (mask) {
+				const auto pos = VerifySyncCandidates(data, size, from, mask);
+				if (pos != std::string_view::npos)
+					return pos;
+			}
+		}
+		return FindSyncCandidateSse2(data, size, from);
+	}
+
+	static bool CpuSupportsSse2() {
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return !!(info[3] & (1 << 26));
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	static bool CpuSupportsAvx2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		// the OS must be saving YMM registers
+		if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return !!(info[1] & (1 << 5));
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	typedef size_t(*FindSyncCandidateFunction)(const char* data, size_t size, size_t from);
+
+	static bool IsKernelSupported(const Kernel kernel) {
+		switch (kernel) {
+#ifdef SMIPARSER_X86
+			case Kernel::AVX2:
+				return CpuSupportsAvx2();
+			case Kernel::SSE2:
+				return CpuSupportsSse2();
+#endif
+			case Kernel::SCALAR:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	static FindSyncCandidateFunction GetImplementation(const Kernel kernel) {
+		switch (kernel) {
+#ifdef SMIPARSER_X86
+			case Kernel::AVX2:
+				return FindSyncCandidateAvx2;
+			case Kernel::SSE2:
+				return FindSyncCandidateSse2;
+#endif
+			default:
+				return FindSyncCandidateScalar;
+		}
+	}
+
+	static Kernel FindBestKernel() {
+		for (const auto kernel : { Kernel::AVX2, Kernel::SSE2 })
+			if (IsKernelSupported(kernel))
+				return kernel;
+		return Kernel::SCALAR;
+	}
+
+	static std::atomic<Kernel>& SelectedKernel() {
+		static std::atomic<Kernel> kernel{ FindBestKernel() };
+		return kernel;
+	}
+
+	bool SelectKernel(const Kernel kernel) {
+		if (!IsKernelSupported(kernel))
+			return false;
+		SelectedKernel() = kernel;
+		return true;
+	}
+
+	Kernel GetKernel() {
+		return SelectedKernel();
+	}
+
+	size_t FindSyncCandidate(std::string_view text, size_t from) {
+		return GetImplementation(SelectedKernel().load(std::memory_order_relaxed))(text.data(), text.size(), from);
+	}
+
+	// Tries to match start=(['"]?)(\d+)\1(?=\s|>) at pos; tagEnd is the position of the closing '>'.
+	// digits is set to where the value is in text.
+	static bool MatchStartAttribute(std::string_view text, size_t pos, const size_t tagEnd, int64_t& value, std::string_view& digits) {
+		if (pos + 6 > tagEnd || !EqualsIgnoreCase(&text[pos], "start=", 6))
+			return false;
+		pos += 6;
+
+		char quote = 0;
+		if (text[pos] == '"' || text[pos] == '\'')
+			quote = text[pos++];
+
+		const auto digitsBegin = pos;
+		int64_t result = 0;
+		auto overflow = false;
+		for (; pos < tagEnd && IsDigit(text[pos]); ++pos) {
+			const auto digit = text[pos] - '0';
+			if (result > (std::numeric_limits<int64_t>::max() - digit) / 10)
+				overflow = true;
+			else
+				result = result * 10 + digit;
+		}
+		if (pos == digitsBegin)
+			return false;
+		const auto digitsEnd = pos;
+
+		if (quote) {
+			if (text[pos] != quote)
+				return false;
+			++pos;
+		}
+		if (pos != tagEnd && !IsSpace(text[pos]))
+			return false;
+
+		// saturate like strtoll did
+		value = overflow ? std::numeric_limits<int64_t>::max() : result;
+		digits = text.substr(digitsBegin, digitsEnd - digitsBegin);
+		return true;
+	}
+
+	bool FindSyncTag(std::string_view text, size_t from, SyncTag& tag) {
+		const auto size = text.size();
+		while (from < size) {
+			const auto tagBegin = FindSyncCandidate(text, from);
+			if (tagBegin == std::string_view::npos)
+				return false;
+			from = tagBegin + 1;
+
+			// "<sync" followed by whitespace
+			if (tagBegin + 6 > size || !IsSpace(text[tagBegin + 5]))
+				continue;
+
+			// the tag cannot contain another '<'
+			auto tagEnd = tagBegin + 5;
+			while (tagEnd < size && text[tagEnd] != '>' && text[tagEnd] != '<')
+				++tagEnd;
+			if (tagEnd == size || text[tagEnd] == '<') {
+				from = tagEnd;
+				continue;
+			}
+
+			// greedy [^<>]* before \s: prefer the last valid attribute
+			int64_t value = -1;
+			std::string_view digits;
+			auto found = false;
+			for (auto attr = tagEnd; attr > tagBegin + 5 && !found; --attr) {
+				if (IsSpace(text[attr - 1]) && ToLower(text[attr]) == 's')
+					found = MatchStartAttribute(text, attr, tagEnd, value, digits);
+			}
+			if (!found)
+				continue;
+
+			tag.start = value;
+			tag.valueOffset = static_cast<size_t>(digits.data() - text.data());
+			tag.valueLength = digits.size();
+			tag.offset = tagBegin;
+			tag.length = tagEnd + 1 - tagBegin;
+			if (tagEnd + 4 <= size && EqualsIgnoreCase(&text[tagEnd + 1], "<p>", 3)) {
+				tag.paragraphOffset = tagEnd + 1;
+				tag.paragraphLength = 3;
+				tag.length += 3;
+			} else {
+				tag.paragraphOffset = std::string_view::npos;
+				tag.paragraphLength = 0;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	int64_t FindSyncEnd(const std::string_view text, const SyncTag& tag, std::string_view* const digits) {
+		const auto tagText = text.substr(tag.offset, tag.length - tag.paragraphLength);
+		// Most tags have nothing but a Start, and neither that nor "sync" has an 'e'.
+		if (std::none_of(tagText.begin(), tagText.end(), [](const char c) { return ToLower(c) == 'e'; }))
+			return -1;
+		std::string_view value;
+		if (!FindAttribute(tagText, "end", value) || value.empty())
+			return -1;
+
+		int64_t result = 0;
+		auto overflow = false;
+		for (const auto c : value) {
+			if (!IsDigit(c))
+				return -1;
+			const auto digit = c - '0';
+			if (result > (std::numeric_limits<int64_t>::max() - digit) / 10)
+				overflow = true;
+			else
+				result = result * 10 + digit;
+		}
+		if (digits != nullptr)
+			*digits = value;
+		return overflow ? std::numeric_limits<int64_t>::max() : result;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace SmiParser {
+	struct SyncTag {
+		int64_t start = -1;
+		size_t offset = 0; // position of '<' in "<SYNC"
+		size_t length = 0; // through the closing '>', or through "<P>" if one follows immediately
+		size_t valueOffset = 0; // digits of the Start value, without quotes
+		size_t valueLength = 0;
+		size_t paragraphOffset = std::string_view::npos;
+		size_t paragraphLength = 0;
+	};
+
+	// Counts line breaks the way Scintilla does: CR LF, LF and CR each end a line.
+	// A CR at the very end of text is counted as a line break on its own.
+	size_t CountLineBreaks(std::string_view text);
+
+	// Finds name=value in a tag spanning from '<' to '>'. The value may be quoted or bare.
+	// lowercaseName is matched case-insensitively.
+	bool FindAttribute(std::string_view tag, std::string_view lowercaseName, std::string_view& value);
+
+	// Finds the first "<sync" (case-insensitive) at or after from, or returns npos.
+	// Uses AVX2 or SSE2 when the CPU supports them.
+	size_t FindSyncCandidate(std::string_view text, size_t from);
+
+	// Implementations of FindSyncCandidate. The best one the CPU supports is used unless the tests or benchmarks select another.
+	enum class Kernel {
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+	// Returns false, keeping the current one, if the CPU does not support kernel.
+	bool SelectKernel(Kernel kernel);
+	Kernel GetKernel();
+
+	// Finds the first <SYNC ... Start=...> tag at or after from.
+	// Matches exactly what the following regex (icase) would match:
+	//   <sync(?=\s)[^<>]*\sstart=(['"]?)(\d+)\1(?=\s|>)[^<>]*>(?:<P>)?
+	// If a tag has more than one valid Start attribute, the last one wins, as it would with the greedy regex.
+	bool FindSyncTag(std::string_view text, size_t from, SyncTag& tag);
+
+	// End value of a tag found by FindSyncTag in text, saturating as Start does; -1 if it has none or it is not a number.
+	// digits, if given, is set to where the value is in text.
+	int64_t FindSyncEnd(std::string_view text, const SyncTag& tag, std::string_view* digits = nullptr);
+};
@@ -0,0 +1,285 @@
+#include "SmiRetime.h"
+#include "SmiParser.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace SmiRetime {
+	static int64_t SaturatingAdd(const int64_t a, const int64_t b) {
+		if (b > 0 && a > std::numeric_limits<int64_t>::max() - b)
+			return std::numeric_limits<int64_t>::max();
+		if (b < 0 && a < std::numeric_limits<int64_t>::min() - b)
+			return std::numeric_limits<int64_t>::min();
+		return a + b;
+	}
+
+	static uint64_t SaturatingAdd(const uint64_t a, const uint64_t b) {
+		return a > std::numeric_limits<uint64_t>::max() - b ? std::numeric_limits<uint64_t>::max() : a + b;
+	}
+
+	static uint64_t SaturatingMultiply(const uint64_t a, const uint64_t b) {
+		if (b != 0 && a > std::numeric_limits<uint64_t>::max() / b)
+			return std::numeric_limits<uint64_t>::max();
+		return a * b;
+	}
+
+	bool Rewrite(const std::string_view text, const size_t from, const size_t to, const TimeMap& map, Edit& edit) {
+		edit = Edit();
+
+		// Text between two changed values is copied over as it is, once the next change is found.
+		size_t copiedTo = std::string_view::npos;
+		const auto replace = [&](const size_t offset, const size_t length, const int64_t value) {
+			if (copiedTo == std::string_view::npos) {
+				edit.begin = offset;
+				edit.text.reserve(to - offset + 64);
+			} else
+				edit.text.append(text.data() + copiedTo, offset - copiedTo);
+
+			char digits[20];
+			const auto result = std::to_chars(digits, digits + sizeof digits, value);
+			edit.text.append(digits, result.ptr - digits);
+			copiedTo = offset + length;
+		};
+		const auto mapped = [&map](const int64_t value) { return std::max<int64_t>(map(value), 0); };
+
+		SmiParser::SyncTag tag;
+		std::string_view endDigits;
+		for (auto pos = from; SmiParser::FindSyncTag(text, pos, tag) && tag.offset < to; pos = tag.offset + tag.length) {
+			const auto start = mapped(tag.start);
+			// An End moves with its Start, and may come before it in the tag.
+			const auto oldEnd = SmiParser::FindSyncEnd(text, tag, &endDigits);
+			const auto end = oldEnd < 0 ? oldEnd : mapped(oldEnd);
+			if (start == tag.start && end == oldEnd)
+				continue;
+
+			const auto endOffset = end == oldEnd ? std::string_view::npos : static_cast<size_t>(endDigits.data() - text.data());
+			if (endOffset < tag.valueOffset)
+				replace(endOffset, endDigits.size(), end);
+			if (start != tag.start)
+				replace(tag.valueOffset, tag.valueLength, start);
+			if (endOffset != std::string_view::npos && endOffset > tag.valueOffset)
+				replace(endOffset, endDigits.size(), end);
+			++edit.changed;
+		}
+
+		if (copiedTo == std::string_view::npos)
+			return false;
+		edit.end = copiedTo;
+		return true;
+	}
+
+	bool Shift(const std::string_view text, const size_t from, const size_t to, const int64_t delta, Edit& edit) {
+		return Rewrite(text, from, to, [delta](const int64_t start) { return SaturatingAdd(start, delta); }, edit);
+	}
+
+	bool ParseRate(std::string_view text, Rational& rate) {
+		static constexpr int64_t LIMIT = 1000000;
+
+		const auto slash = text.find('/');
+		if (slash != std::string_view::npos) {
+			Rational num, den;
+			if (!ParseRate(text.substr(0, slash), num) || !ParseRate(text.substr(slash + 1), den) || num.den != 1 || den.den != 1)
+				return false;
+			rate = { num.num, den.num };
+			return true;
+		}
+
+		// NTSC rates are never exactly what their decimal form says.
+		static constexpr struct {
+			std::string_view text;
+			int64_t num;
+		} NTSC_RATES[] = {
+			{ "23.976", 24000 }, { "23.98", 24000 }, { "29.97", 30000 }, { "47.952", 48000 }, { "59.94", 60000 }, { "119.88", 120000 },
+		};
+		for (const auto& ntsc : NTSC_RATES) {
+			if (text == ntsc.text) {
+				rate = { ntsc.num, 1001 };
+				return true;
+			}
+		}
+
+		int64_t num = 0, den = 1;
+		auto hasDigit = false, hasPoint = false;
+		for (const auto c : text) {
+			if (c >= '0' && c <= '9') {
+				num = num * 10 + (c - '0');
+				if (hasPoint)
+					den *= 10;
+				hasDigit = true;
+				if (num > LIMIT || den > LIMIT)
+					return false;
+			} else if (c == '.' && !hasPoint)
+				hasPoint = true;
+			else
+				return false;
+		}
+		if (!hasDigit || num == 0)
+			return false;
+		rate = { num, den };
+		return true;
+	}
+
+	bool ParseOffset(std::string_view text, int64_t& offset) {
+		// Well within int64_t once in milliseconds, and longer than any video.
+		static constexpr int64_t LIMIT = 1000000000000;
+
+		const auto trim = [&text] {
+			while (!text.empty() && text.front() == ' ')
+				text.remove_prefix(1);
+			while (!text.empty() && text.back() == ' ')
+				text.remove_suffix(1);
+		};
+
+		trim();
+		auto negative = false;
+		if (!text.empty() && (text.front() == '+' || text.front() == '-')) {
+			negative = text.front() == '-';
+			text.remove_prefix(1);
+		}
+		auto isMilliseconds = false;
+		if (text.size() >= 2 && text.substr(text.size() - 2) == "ms") {
+			isMilliseconds = true;
+			text.remove_suffix(2);
+		} else if (!text.empty() && text.back() == 's')
+			text.remove_suffix(1);
+		trim();
+
+		int64_t whole = 0, fraction = 0, fractionScale = 1000;
+		auto hasDigit = false, hasPoint = false;
+		for (const auto c : text) {
+			if (c >= '0' && c <= '9') {
+				if (hasPoint) {
+					if (fractionScale == 1)
+						return false;
+					fractionScale /= 10;
+					fraction += (c - '0') * fractionScale;
+				} else if ((whole = whole * 10 + (c - '0')) > LIMIT)
+					return false;
+				hasDigit = true;
+			} else if (c == '.' && !hasPoint && !isMilliseconds)
+				hasPoint = true;
+			else
+				return false;
+		}
+		if (!hasDigit)
+			return false;
+		const auto value = isMilliseconds ? whole : whole * 1000 + fraction;
+		offset = negative ? -value : value;
+		return true;
+	}
+
+	bool MakeAffine(Rational scale, const int64_t offset, Affine& affine) {
+		if (scale.num <= 0 || scale.den <= 0)
+			return false;
+		const auto divisor = std::gcd(scale.num, scale.den);
+		scale.num /= divisor;
+		scale.den /= divisor;
+		if (scale.den >= int64_t(1) << 31)
+			return false;
+		affine.scale = scale;
+		affine.offset = offset;
+		return true;
+	}
+
+	bool ConvertFramerate(const Rational from, const Rational to, const int64_t offset, Affine& affine) {
+		// Reduced across first, so that rates within ParseRate's limits cannot overflow.
+		const auto a = std::gcd(from.num, to.num), b = std::gcd(from.den, to.den);
+		if (a == 0 || b == 0)
+			return false;
+		return MakeAffine({ from.num / a * (to.den / b), from.den / b * (to.num / a) }, offset, affine);
+	}
+
+	int64_t Affine::Apply(const int64_t start) const {
+		if (start < 0)
+			return start;
+
+		// start * num / den without a 128-bit product: with start = q * den + r and num = qn * den + rn,
+		// it is q * num + r * qn + r * rn / den, where r * rn < den^2 fits as den is below 2^31.
+		// Unsigned, so that a product up to 2^64 is still exact for a negative offset to bring back into range.
+		const uint64_t num = scale.num, den = scale.den;
+		const auto q = static_cast<uint64_t>(start) / den, r = static_cast<uint64_t>(start) % den;
+		const auto fraction = r * (num % den);
+		auto product = SaturatingAdd(SaturatingMultiply(q, num), SaturatingMultiply(r, num / den));
+		product = SaturatingAdd(product, fraction / den);
+		if (2 * (fraction % den) >= den)
+			product = SaturatingAdd(product, uint64_t(1));
+
+		constexpr auto MAX = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+		if (product <= MAX)
+			return SaturatingAdd(static_cast<int64_t>(product), offset);
+		if (offset >= 0)
+			return std::numeric_limits<int64_t>::max();
+		// product - |offset|, which cannot go below 0 as |offset| is at most MAX + 1.
+		const auto result = product - (0 - static_cast<uint64_t>(offset));
+		return result > MAX ? std::numeric_limits<int64_t>::max() : static_cast<int64_t>(result);
+	}
+
+	bool Retime(const std::string_view text, const size_t from, const size_t to, const Affine& affine, Edit& edit) {
+		return Rewrite(text, from, to, [&affine](const int64_t start) { return affine.Apply(start); }, edit);
+	}
+
+	// Rounds half up, and saturates where a double no longer fits.
+	static int64_t RoundToInt64(const double value) {
+		if (!(value < 9.2e18))
+			return std::numeric_limits<int64_t>::max();
+		if (!(value > -9.2e18))
+			return std::numeric_limits<int64_t>::min();
+		return static_cast<int64_t>(std::floor(value + 0.5));
+	}
+
+	TimeMap Interpolate(std::vector<Anchor> anchors) {
+		std::stable_sort(anchors.begin(), anchors.end(), [](const Anchor& a, const Anchor& b) { return a.start < b.start; });
+		std::vector<Anchor> unique;
+		for (const auto& anchor : anchors) {
+			if (!unique.empty() && unique.back().start == anchor.start)
+				unique.back() = anchor;
+			else
+				unique.push_back(anchor);
+		}
+
+		if (unique.empty())
+			return [](const int64_t start) { return start; };
+		if (unique.size() == 1) {
+			const auto delta = unique[0].target - unique[0].start;
+			return [delta](const int64_t start) { return SaturatingAdd(start, delta); };
+		}
+
+		return [anchors = std::move(unique)](const int64_t start) {
+			// Segment [i - 1, i], with i the first anchor after start, kept within the first and the last segment.
+			const auto after = std::upper_bound(anchors.begin(), anchors.end(), start, [](const int64_t t, const Anchor& a) { return t < a.start; });
+			const auto i = std::clamp<size_t>(static_cast<size_t>(after - anchors.begin()), 1, anchors.size() - 1);
+			const auto& a = anchors[i - 1];
+			const auto& b = anchors[i];
+			const auto slope = static_cast<double>(b.target - a.target) / static_cast<double>(b.start - a.start);
+			return RoundToInt64(static_cast<double>(a.target) + slope * static_cast<double>(start - a.start));
+		};
+	}
+
+	TimeMap FitLine(const std::vector<Anchor>& anchors) {
+		if (anchors.empty())
+			return [](const int64_t start) { return start; };
+
+		// Centered on the means, so that large start values do not cost precision.
+		double meanStart = 0, meanTarget = 0;
+		for (const auto& anchor : anchors) {
+			meanStart += static_cast<double>(anchor.start);
+			meanTarget += static_cast<double>(anchor.target);
+		}
+		meanStart /= static_cast<double>(anchors.size());
+		meanTarget /= static_cast<double>(anchors.size());
+
+		double covariance = 0, variance = 0;
+		for (const auto& anchor : anchors) {
+			const auto ds = static_cast<double>(anchor.start) - meanStart;
+			covariance += ds * (static_cast<double>(anchor.target) - meanTarget);
+			variance += ds * ds;
+		}
+		const auto slope = variance > 0 ? covariance / variance : 1.0;
+
+		return [slope, meanStart, meanTarget](const int64_t start) {
+			return RoundToInt64(meanTarget + slope * (static_cast<double>(start) - meanStart));
+		};
+	}
+}
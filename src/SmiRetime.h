@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SmiRetime {
+	// Replacing [begin, end) of the original text with text gives the retimed document.
+	// Spans only from the first to the last value that changed, so that an editor replaces no more than it has to.
+	struct Edit {
+		size_t begin = 0;
+		size_t end = 0;
+		std::string text;
+		size_t changed = 0; // Syncs with a value rewritten
+	};
+
+	// Gives the new Start value for an old one.
+	typedef std::function<int64_t(int64_t start)> TimeMap;
+
+	// Rewrites the Start value of every Sync tag beginning in [from, to) to map(start), clamped at 0, in one pass,
+	// and its End value the same way if it has one. Only the digits are replaced; quotes and the rest of the tag stay as they are.
+	// Returns false, with edit empty, if no value changed.
+	bool Rewrite(std::string_view text, size_t from, size_t to, const TimeMap& map, Edit& edit);
+
+	// Adds delta to every Start value beginning in [from, to), saturating instead of overflowing.
+	bool Shift(std::string_view text, size_t from, size_t to, int64_t delta, Edit& edit);
+
+	// A positive fraction, such as 24000/1001 for 23.976 fps.
+	struct Rational {
+		int64_t num = 1;
+		int64_t den = 1;
+	};
+
+	// Reads "25", "23.976" or "24000/1001", with at most a million on either side of the slash.
+	// The NTSC rates written as decimals, 23.976 (or 23.98), 29.97, 47.952, 59.94 and 119.88, are their exact x000/1001 values.
+	bool ParseRate(std::string_view text, Rational& rate);
+
+	// Reads a signed offset such as "+1.2", "-0.5s" or "1200ms" into milliseconds: seconds, with at most three decimals,
+	// unless it ends in "ms". Spaces around the sign, the number and the unit are ignored.
+	bool ParseOffset(std::string_view text, int64_t& offset);
+
+	// start * scale + offset, with the product rounded to the nearest millisecond and halves rounded up.
+	// Exact for any start; results past the range of int64_t saturate.
+	struct Affine {
+		Rational scale; // reduced, with den below 2^31
+		int64_t offset = 0;
+
+		int64_t Apply(int64_t start) const;
+	};
+
+	// Reduces scale; fails if it is not positive or its denominator does not fit in 31 bits.
+	bool MakeAffine(Rational scale, int64_t offset, Affine& affine);
+
+	// Keeps each caption on the same frame when a video made at from fps is played at to fps instead, so the scale is from / to.
+	bool ConvertFramerate(Rational from, Rational to, int64_t offset, Affine& affine);
+
+	// Applies affine to every Start value beginning in [from, to).
+	bool Retime(std::string_view text, size_t from, size_t to, const Affine& affine, Edit& edit);
+
+	// A Start value and where it should have been, such as the time the player was at when the caption was heard.
+	struct Anchor {
+		int64_t start;
+		int64_t target;
+	};
+
+	// Passes through every anchor, linearly between them; beyond the first and the last, the nearest segment is continued.
+	// Of anchors with the same start, the last one counts. One anchor is a plain shift; none maps every value to itself.
+	TimeMap Interpolate(std::vector<Anchor> anchors);
+
+	// The straight line closest to the anchors by least squares, for anchors that are off by a little each.
+	// With fewer than two distinct starts, a shift by the average difference.
+	TimeMap FitLine(const std::vector<Anchor>& anchors);
+};
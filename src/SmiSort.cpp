@@ -0,0 +1,101 @@
+#include "SmiSort.h"
+#include "SmiParser.h"
+#include <algorithm>
+
+namespace SmiSort {
+	static bool IsBodyEndAt(const std::string_view text, const size_t pos) {
+		static constexpr std::string_view BODY_END = "</body";
+		if (pos + BODY_END.size() > text.size())
+			return false;
+		for (size_t i = 0; i < BODY_END.size(); ++i) {
+			auto c = text[pos + i];
+			if (c >= 'A' && c <= 'Z')
+				c = static_cast<char>(c + ('a' - 'A'));
+			if (c != BODY_END[i])
+				return false;
+		}
+		return true;
+	}
+
+	std::vector<Block> FindBlocks(const std::string_view text) {
+		std::vector<Block> blocks;
+		SmiParser::SyncTag tag;
+		for (size_t pos = 0; SmiParser::FindSyncTag(text, pos, tag); pos = tag.offset + tag.length) {
+			if (!blocks.empty())
+				blocks.back().length = tag.offset - blocks.back().offset;
+			blocks.push_back({ tag.start, tag.offset, 0 });
+		}
+		if (blocks.empty())
+			return blocks;
+
+		// The closing tags stay at the end, wherever the last block goes.
+		auto end = text.size();
+		for (auto pos = text.find('<', blocks.back().offset + 1); pos != std::string_view::npos; pos = text.find('<', pos + 1)) {
+			if (IsBodyEndAt(text, pos)) {
+				end = pos;
+				break;
+			}
+		}
+		blocks.back().length = end - blocks.back().offset;
+		return blocks;
+	}
+
+	void SortBlocks(std::vector<Block>& blocks) {
+		// Flipping the sign bit orders negative starts, which the parser never gives, first.
+		const auto keyOf = [](const Block& block) { return static_cast<uint64_t>(block.start) ^ (uint64_t(1) << 63); };
+
+		size_t counts[8][256] = {};
+		for (const auto& block : blocks) {
+			const auto key = keyOf(block);
+			for (auto digit = 0; digit < 8; ++digit)
+				++counts[digit][key >> (8 * digit) & 0xFF];
+		}
+
+		std::vector<Block> buffer(blocks.size());
+		auto* from = &blocks;
+		auto* to = &buffer;
+		for (auto digit = 0; digit < 8; ++digit) {
+			auto& count = counts[digit];
+			const auto shift = 8 * digit;
+			if (blocks.empty() || count[keyOf(blocks[0]) >> shift & 0xFF] == blocks.size())
+				continue;
+
+			size_t sum = 0;
+			for (auto& c : count) {
+				const auto n = c;
+				c = sum;
+				sum += n;
+			}
+			for (const auto& block : *from)
+				(*to)[count[keyOf(block) >> shift & 0xFF]++] = block;
+			std::swap(from, to);
+		}
+		if (from != &blocks)
+			blocks.swap(buffer);
+	}
+
+	bool Sort(const std::string_view text, SmiRetime::Edit& edit) {
+		edit = SmiRetime::Edit();
+		auto blocks = FindBlocks(text);
+		if (std::is_sorted(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.start < b.start; }))
+			return false;
+
+		const auto original = blocks;
+		SortBlocks(blocks);
+
+		// Blocks already in place at either end are left out of the edit.
+		size_t first = 0, last = blocks.size();
+		while (blocks[first].offset == original[first].offset)
+			++first;
+		while (blocks[last - 1].offset == original[last - 1].offset)
+			--last;
+
+		edit.begin = original[first].offset;
+		edit.end = original[last - 1].offset + original[last - 1].length;
+		edit.text.reserve(edit.end - edit.begin);
+		for (auto i = first; i < last; ++i)
+			edit.text.append(text.data() + blocks[i].offset, blocks[i].length);
+		edit.changed = last - first;
+		return true;
+	}
+}
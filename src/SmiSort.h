@@ -0,0 +1,25 @@
+#pragma once
+#include "SmiRetime.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace SmiSort {
+	// A Sync tag and what follows it up to the next Sync tag. The last block ends at </BODY>, or at the end of the text.
+	struct Block {
+		int64_t start;
+		size_t offset;
+		size_t length;
+	};
+
+	// Blocks of text in document order; text before the first Sync is not part of any.
+	std::vector<Block> FindBlocks(std::string_view text);
+
+	// Stable sort by start: an LSD radix sort a byte at a time, skipping the bytes every start has in common.
+	void SortBlocks(std::vector<Block>& blocks);
+
+	// Reorders the blocks of text by start, keeping blocks with equal starts in document order.
+	// edit spans only from the first block that moves to the last; changed is the number of blocks in between.
+	// Returns false, with edit empty, if the blocks are already in order.
+	bool Sort(std::string_view text, SmiRetime::Edit& edit);
+};
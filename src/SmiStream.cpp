@@ -0,0 +1,60 @@
+#include "SmiStream.h"
+#include "MappedFile.h"
+#include <algorithm>
+
+namespace SmiStream {
+	// Everything before the returned position can be parsed from this window alone:
+	// a tag never contains '<', so a tag starting before the last '<' ends before it,
+	// and the three bytes kept after that '<' cover a trailing "<P>".
+	static size_t FindSafeEnd(std::string_view text) {
+		const auto limit = text.size() - 3;
+		const auto lastLt = text.find_last_of('<', limit - 1);
+		if (lastLt != std::string_view::npos && lastLt != 0)
+			return lastLt;
+
+		// no tag can end in this window; do not split a CR LF pair
+		return text[limit - 1] == '\r' && text[limit] == '\n' ? limit - 1 : limit;
+	}
+
+	// Reports the tags starting before safeEnd and advances line to safeEnd. Returns false if the callback asked to stop.
+	static bool ScanWindow(std::string_view text, const size_t safeEnd, const uint64_t base, uint64_t& line, const SyncCallback& callback) {
+		size_t lineCountedTo = 0;
+		SmiParser::SyncTag tag;
+		for (size_t pos = 0; SmiParser::FindSyncTag(text, pos, tag) && tag.offset < safeEnd; pos = tag.offset + tag.length) {
+			// Only a tag at the start of a window can end too close to its end to tell whether a <P> follows; it does not fit in a window.
+			if (safeEnd != text.size() && tag.paragraphOffset == std::string_view::npos && tag.offset + tag.length + 3 > text.size())
+				continue;
+			line += SmiParser::CountLineBreaks(text.substr(lineCountedTo, tag.offset - lineCountedTo));
+			lineCountedTo = tag.offset;
+			if (!callback(tag, base + tag.offset, line))
+				return false;
+		}
+		line += SmiParser::CountLineBreaks(text.substr(lineCountedTo, safeEnd - lineCountedTo));
+		return true;
+	}
+
+	void ForEachSync(std::string_view text, const SyncCallback& callback) {
+		uint64_t line = 0;
+		ScanWindow(text, text.size(), 0, line, callback);
+	}
+
+	bool ForEachSync(MappedFile& file, const SyncCallback& callback, size_t windowSize) {
+		const auto size = file.GetSize();
+		// a smaller window could end between CR and LF
+		windowSize = std::max<size_t>(windowSize, 8);
+		uint64_t base = 0, line = 0;
+		while (base < size) {
+			const auto length = static_cast<size_t>(std::min<uint64_t>(windowSize, size - base));
+			const auto text = file.Map(base, length);
+			if (text.empty())
+				return false;
+
+			const auto safeEnd = base + length == size ? length : FindSafeEnd(text);
+			if (!ScanWindow(text, safeEnd, base, line, callback))
+				return true;
+			base += safeEnd;
+		}
+		file.Unmap();
+		return true;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "SmiParser.h"
+#include <functional>
+
+class MappedFile;
+
+namespace SmiStream {
+	constexpr size_t DEFAULT_WINDOW_SIZE = 64 * 1024 * 1024;
+
+	// tag offsets are relative to the current window; offset and line are absolute within the file.
+	// Return false to stop.
+	typedef std::function<bool(const SmiParser::SyncTag& tag, uint64_t offset, uint64_t line)> SyncCallback;
+
+	// Walks every Sync tag of a file in a single pass, keeping only one window of the file mapped at a time.
+	// A tag that does not fit in a window with 3 bytes to spare, for a <P> after it, is not reported.
+	// Returns false if a part of the file could not be mapped.
+	bool ForEachSync(MappedFile& file, const SyncCallback& callback, size_t windowSize = DEFAULT_WINDOW_SIZE);
+
+	// Same, over text already in memory.
+	void ForEachSync(std::string_view text, const SyncCallback& callback);
+};
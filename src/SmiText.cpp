@@ -0,0 +1,102 @@
+#include "SmiText.h"
+#include "HtmlEntities.h"
+#include <cstring>
+
+namespace SmiText {
+	static bool IsSpace(const char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+	}
+
+	static bool IsWordChar(const char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	// Returns the length of a <P>, </P> or <BR> tag at text[0] == '<', or 0; isBreak tells which.
+	static size_t MatchTag(std::string_view text, bool& isBreak) {
+		size_t p = 1;
+		const auto closing = p < text.size() && text[p] == '/';
+		if (closing)
+			++p;
+
+		size_t nameLength;
+		if (p < text.size() && (text[p] | 0x20) == 'p') {
+			nameLength = 1;
+			isBreak = false;
+		} else if (!closing && p + 1 < text.size() && (text[p] | 0x20) == 'b' && (text[p + 1] | 0x20) == 'r') {
+			nameLength = 2;
+			isBreak = true;
+		} else
+			return 0;
+		p += nameLength;
+
+		// word boundary after the name, then anything but '<' up to '>'
+		if (p < text.size() && IsWordChar(text[p]))
+			return 0;
+		for (; p < text.size(); ++p) {
+			if (text[p] == '>')
+				return p + 1;
+			if (text[p] == '<')
+				return 0;
+		}
+		return 0;
+	}
+
+	size_t NormalizeCaption(std::string_view html, char* out, size_t capacity) {
+		size_t length = 0;
+		auto pendingSpace = false;
+		auto pendingBreak = false;
+		char decoded[4];
+
+		// Space and line breaks are only written once something follows them, which trims every line.
+		const auto emit = [&](const char* s, const size_t n) {
+			if (length != 0) {
+				const auto separator = pendingBreak ? '\n' : ' ';
+				if ((pendingBreak || pendingSpace) && length < capacity)
+					out[length++] = separator;
+			}
+			pendingSpace = pendingBreak = false;
+			const auto count = n < capacity - length ? n : capacity - length;
+			memcpy(out + length, s, count);
+			length += count;
+		};
+
+		for (size_t i = 0; i < html.size();) {
+			const auto c = html[i];
+			if (IsSpace(c)) {
+				pendingSpace = true;
+				++i;
+			} else if (c == '<') {
+				auto isBreak = false;
+				const auto tagLength = MatchTag(html.substr(i), isBreak);
+				if (tagLength == 0) {
+					emit(&html[i], 1);
+					++i;
+				} else {
+					pendingBreak |= isBreak;
+					i += tagLength;
+				}
+			} else if (c == '&') {
+				uint32_t codePoint;
+				const auto entityLength = HtmlEntities::Decode(html.substr(i), codePoint);
+				if (entityLength == 0) {
+					emit(&html[i], 1);
+					++i;
+				} else {
+					// &nbsp; collapses like any other space
+					if (codePoint == 0xA0 || codePoint == ' ')
+						pendingSpace = true;
+					else
+						emit(decoded, HtmlEntities::EncodeUtf8(codePoint, decoded));
+					i += entityLength;
+				}
+			} else {
+				auto end = i + 1;
+				while (end < html.size() && !IsSpace(html[end]) && html[end] != '<' && html[end] != '&')
+					++end;
+				emit(&html[i], end - i);
+				i = end;
+			}
+		}
+		return length;
+	}
+}
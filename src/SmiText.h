@@ -0,0 +1,11 @@
+#pragma once
+#include <string_view>
+
+namespace SmiText {
+	// Turns the inner HTML of a caption into plain text in one pass:
+	// <P> and </P> tags are dropped, <BR> becomes a line break, runs of whitespace become one space,
+	// empty lines are dropped, each line is trimmed, and character references are decoded to UTF-8.
+	// The result is never longer than html, so a buffer of html.size() bytes is always enough;
+	// with a smaller buffer the text is cut short. Returns the number of bytes written.
+	size_t NormalizeCaption(std::string_view html, char* out, size_t capacity);
+};
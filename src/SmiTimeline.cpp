@@ -0,0 +1,366 @@
+#include "SmiTimeline.h"
+#include "SmiParser.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+void SmiTimeline::DeltaTree::Reset(const size_t size) {
+	m_tree.assign(size + 1, 0);
+}
+
+void SmiTimeline::DeltaTree::AddFrom(size_t index, const int64_t delta) {
+	for (++index; index < m_tree.size(); index += index & (~index + 1))
+		m_tree[index] += delta;
+}
+
+int64_t SmiTimeline::DeltaTree::Get(size_t index) const {
+	int64_t sum = 0;
+	for (++index; index > 0; index -= index & (~index + 1))
+		sum += m_tree[index];
+	return sum;
+}
+
+void SmiTimeline::Clear() {
+	m_starts.clear();
+	m_lines.clear();
+	m_offsets.clear();
+	m_tagLengths.clear();
+	m_ends.clear();
+	m_byStart.clear();
+	m_descents = 0;
+	ResetDeltas();
+}
+
+// Appends the Syncs starting in [begin, end) with lines counted from begin; returns the number of line breaks in the range.
+size_t SmiTimeline::ScanRange(std::string_view text, const size_t begin, const size_t end) {
+	// end is at a '<', and a Sync tag never contains one, so every tag starting before end also ends there.
+	text = text.substr(0, end);
+
+	size_t line = 0, lineCountedTo = begin;
+	SmiParser::SyncTag tag;
+	for (auto pos = begin; SmiParser::FindSyncTag(text, pos, tag); pos = tag.offset + tag.length) {
+		line += SmiParser::CountLineBreaks(text.substr(lineCountedTo, tag.offset - lineCountedTo));
+		lineCountedTo = tag.offset;
+
+		m_starts.push_back(tag.start);
+		m_lines.push_back(line);
+		m_offsets.push_back(tag.offset);
+		m_tagLengths.push_back(static_cast<uint32_t>(tag.length));
+		m_ends.push_back(SmiParser::FindSyncEnd(text, tag));
+	}
+	return line + SmiParser::CountLineBreaks(text.substr(lineCountedTo));
+}
+
+void SmiTimeline::Build(const std::string_view text, unsigned threadCount, const size_t minChunkSize) {
+	Clear();
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, text.size() / std::max<size_t>(minChunkSize, 1)));
+	if (threadCount <= 1) {
+		ScanRange(text, 0, text.size());
+		ResetDeltas();
+		BuildStartOrder();
+		return;
+	}
+
+	// Cut at "<sync" so that no tag, and no CR LF pair, is split between two chunks.
+	std::vector<size_t> bounds{ 0 };
+	for (unsigned i = 1; i < threadCount; ++i) {
+		const auto bound = SmiParser::FindSyncCandidate(text, std::max(bounds.back() + 1, text.size() / threadCount * i));
+		if (bound == std::string_view::npos)
+			break;
+		bounds.push_back(bound);
+	}
+	bounds.push_back(text.size());
+
+	std::vector<SmiTimeline> chunks(bounds.size() - 1);
+	std::vector<size_t> lineBreaks(chunks.size());
+	const auto scan = [&](const size_t i) { lineBreaks[i] = chunks[i].ScanRange(text, bounds[i], bounds[i + 1]); };
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < chunks.size(); ++i)
+		threads.emplace_back(scan, i);
+	scan(0);
+	for (auto& thread : threads)
+		thread.join();
+
+	size_t total = 0;
+	for (const auto& chunk : chunks)
+		total += chunk.Size();
+	m_starts.reserve(total);
+	m_lines.reserve(total);
+	m_offsets.reserve(total);
+	m_tagLengths.reserve(total);
+	m_ends.reserve(total);
+
+	// Line numbers in a chunk count from its first byte.
+	size_t lineBase = 0;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		const auto& chunk = chunks[i];
+		m_starts.insert(m_starts.end(), chunk.m_starts.begin(), chunk.m_starts.end());
+		m_offsets.insert(m_offsets.end(), chunk.m_offsets.begin(), chunk.m_offsets.end());
+		m_tagLengths.insert(m_tagLengths.end(), chunk.m_tagLengths.begin(), chunk.m_tagLengths.end());
+		m_ends.insert(m_ends.end(), chunk.m_ends.begin(), chunk.m_ends.end());
+		for (const auto line : chunk.m_lines)
+			m_lines.push_back(lineBase + line);
+		lineBase += lineBreaks[i];
+	}
+	ResetDeltas();
+	BuildStartOrder();
+}
+
+void SmiTimeline::BuildStartOrder() {
+	m_byStart.clear();
+	m_descents = CountDescents(0, m_starts.size());
+	if (m_descents == 0)
+		return;
+
+	m_byStart.resize(m_starts.size());
+	std::iota(m_byStart.begin(), m_byStart.end(), static_cast<size_t>(0));
+	std::stable_sort(m_byStart.begin(), m_byStart.end(), [this](const size_t a, const size_t b) {
+		return m_starts[a] < m_starts[b];
+	});
+}
+
+// Counts the entries in [begin, end) whose start is less than the one before them.
+size_t SmiTimeline::CountDescents(const size_t begin, const size_t end) const {
+	size_t count = 0;
+	for (auto i = std::max<size_t>(begin, 1); i < end && i < m_starts.size(); ++i)
+		count += m_starts[i - 1] > m_starts[i];
+	return count;
+}
+
+// The order of m_byStart: by start, then by index.
+bool SmiTimeline::IsBeforeByStart(const size_t a, const size_t b) const {
+	return m_starts[a] < m_starts[b] || (m_starts[a] == m_starts[b] && a < b);
+}
+
+// Call before the start of index changes.
+void SmiTimeline::EraseFromStartOrder(const size_t index) {
+	const auto found = std::lower_bound(m_byStart.begin(), m_byStart.end(), index, [this](const size_t a, const size_t b) {
+		return IsBeforeByStart(a, b);
+	});
+	m_byStart.erase(found);
+}
+
+// Puts the given entries, in increasing order, back into m_byStart after m_descents was updated.
+// m_byStart is empty if the document was in order before the edit, and then every other entry still is.
+void SmiTimeline::RestoreStartOrder(const std::vector<size_t>& missing) {
+	if (m_descents == 0) {
+		m_byStart.clear();
+		return;
+	}
+
+	if (m_byStart.empty()) {
+		m_byStart.reserve(m_starts.size());
+		size_t next = 0;
+		for (size_t i = 0; i < m_starts.size(); ++i) {
+			if (next < missing.size() && missing[next] == i)
+				++next;
+			else
+				m_byStart.push_back(i);
+		}
+	}
+	for (const auto index : missing) {
+		const auto at = std::lower_bound(m_byStart.begin(), m_byStart.end(), index, [this](const size_t a, const size_t b) {
+			return IsBeforeByStart(a, b);
+		});
+		m_byStart.insert(at, index);
+	}
+}
+
+void SmiTimeline::ResetDeltas() {
+	m_lineDeltas.Reset(m_starts.size());
+	m_offsetDeltas.Reset(m_starts.size());
+	m_hasDeltas = false;
+}
+
+void SmiTimeline::ApplyDeltas() {
+	if (!m_hasDeltas)
+		return;
+	for (size_t i = 0; i < m_starts.size(); ++i) {
+		m_lines[i] = GetLine(i);
+		m_offsets[i] = GetOffset(i);
+	}
+	ResetDeltas();
+}
+
+size_t SmiTimeline::GetLine(const size_t index) const {
+	return m_hasDeltas ? static_cast<size_t>(m_lines[index] + m_lineDeltas.Get(index)) : m_lines[index];
+}
+
+size_t SmiTimeline::GetOffset(const size_t index) const {
+	return m_hasDeltas ? static_cast<size_t>(m_offsets[index] + m_offsetDeltas.Get(index)) : m_offsets[index];
+}
+
+size_t SmiTimeline::FindFirstEndingAtOrAfter(const size_t offset) const {
+	size_t lo = 0, hi = m_starts.size();
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (GetOffset(mid) + m_tagLengths[mid] < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+size_t SmiTimeline::FindFirstStartingAfter(const size_t offset) const {
+	size_t lo = 0, hi = m_starts.size();
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (GetOffset(mid) <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+std::pair<size_t, size_t> SmiTimeline::Update(const SmiTextSource& source, const size_t position, const size_t removedLength, const size_t insertedLength, const ptrdiff_t linesAdded) {
+	const auto delta = static_cast<int64_t>(insertedLength) - static_cast<int64_t>(removedLength);
+
+	// Entries touching the edited range may change; rescan from the end of the one before them
+	// to the start of the one after them, as a Sync tag never spans over another '<'.
+	auto first = FindFirstEndingAtOrAfter(position);
+	// An edit in the 3 bytes after a tag can complete or break the <P> that follows it.
+	if (first > 0 && position < GetOffset(first - 1) + m_tagLengths[first - 1] + 3)
+		--first;
+	const auto last = FindFirstStartingAfter(position + removedLength);
+	const auto scanBegin = first == 0 ? 0 : GetOffset(first - 1) + m_tagLengths[first - 1];
+	const auto scanEnd = last == m_starts.size() ? source.GetLength() : static_cast<size_t>(GetOffset(last) + delta);
+
+	std::vector<SmiParser::SyncTag> tags;
+	const auto text = source.GetRange(scanBegin, scanEnd - scanBegin);
+	SmiParser::SyncTag tag;
+	for (size_t pos = 0; SmiParser::FindSyncTag(text, pos, tag); pos = tag.offset + tag.length)
+		tags.push_back(tag);
+
+	auto line = source.GetLineFromPosition(scanBegin);
+	size_t lineCountedTo = 0;
+	const auto lineOf = [&](const SmiParser::SyncTag& t) {
+		line += SmiParser::CountLineBreaks(text.substr(lineCountedTo, t.offset - lineCountedTo));
+		lineCountedTo = t.offset;
+		return line;
+	};
+
+	const auto descentsBefore = CountDescents(first, last + 1);
+	if (tags.size() == last - first) {
+		// Same number of Syncs: overwrite in place and shift the rest lazily.
+		std::vector<size_t> moved;
+		for (size_t i = 0; i < tags.size(); ++i) {
+			if (m_starts[first + i] != tags[i].start)
+				moved.push_back(first + i);
+		}
+		if (!m_byStart.empty()) {
+			for (const auto index : moved)
+				EraseFromStartOrder(index);
+		}
+
+		for (size_t i = 0; i < tags.size(); ++i) {
+			const auto index = first + i;
+			m_starts[index] = tags[i].start;
+			m_lines[index] = static_cast<size_t>(lineOf(tags[i]) - (m_hasDeltas ? m_lineDeltas.Get(index) : 0));
+			m_offsets[index] = static_cast<size_t>(scanBegin + tags[i].offset - (m_hasDeltas ? m_offsetDeltas.Get(index) : 0));
+			m_tagLengths[index] = static_cast<uint32_t>(tags[i].length);
+			m_ends[index] = SmiParser::FindSyncEnd(text, tags[i]);
+		}
+		if (last < m_starts.size() && (delta != 0 || linesAdded != 0)) {
+			m_offsetDeltas.AddFrom(last, delta);
+			m_lineDeltas.AddFrom(last, linesAdded);
+			m_hasDeltas = true;
+		}
+
+		if (!moved.empty()) {
+			m_descents = m_descents - descentsBefore + CountDescents(first, last + 1);
+			RestoreStartOrder(moved);
+		}
+		return std::make_pair(first, last);
+	}
+
+	// Syncs were added or removed; fold pending shifts in and splice.
+	if (!m_byStart.empty()) {
+		const auto shift = static_cast<ptrdiff_t>(tags.size()) - static_cast<ptrdiff_t>(last - first);
+		size_t kept = 0;
+		for (const auto index : m_byStart) {
+			if (index < first)
+				m_byStart[kept++] = index;
+			else if (index >= last)
+				m_byStart[kept++] = static_cast<size_t>(static_cast<ptrdiff_t>(index) + shift);
+		}
+		m_byStart.resize(kept);
+	}
+	ApplyDeltas();
+	for (auto i = last; i < m_starts.size(); ++i) {
+		m_lines[i] += linesAdded;
+		m_offsets[i] += delta;
+	}
+
+	std::vector<int64_t> starts(tags.size());
+	std::vector<size_t> lines(tags.size()), offsets(tags.size());
+	std::vector<uint32_t> tagLengths(tags.size());
+	std::vector<int64_t> ends(tags.size());
+	for (size_t i = 0; i < tags.size(); ++i) {
+		starts[i] = tags[i].start;
+		lines[i] = lineOf(tags[i]);
+		offsets[i] = scanBegin + tags[i].offset;
+		tagLengths[i] = static_cast<uint32_t>(tags[i].length);
+		ends[i] = SmiParser::FindSyncEnd(text, tags[i]);
+	}
+	m_starts.erase(m_starts.begin() + first, m_starts.begin() + last);
+	m_starts.insert(m_starts.begin() + first, starts.begin(), starts.end());
+	m_lines.erase(m_lines.begin() + first, m_lines.begin() + last);
+	m_lines.insert(m_lines.begin() + first, lines.begin(), lines.end());
+	m_offsets.erase(m_offsets.begin() + first, m_offsets.begin() + last);
+	m_offsets.insert(m_offsets.begin() + first, offsets.begin(), offsets.end());
+	m_tagLengths.erase(m_tagLengths.begin() + first, m_tagLengths.begin() + last);
+	m_tagLengths.insert(m_tagLengths.begin() + first, tagLengths.begin(), tagLengths.end());
+	m_ends.erase(m_ends.begin() + first, m_ends.begin() + last);
+	m_ends.insert(m_ends.begin() + first, ends.begin(), ends.end());
+
+	ResetDeltas();
+	m_descents = m_descents - descentsBefore + CountDescents(first, first + tags.size() + 1);
+	std::vector<size_t> added(tags.size());
+	std::iota(added.begin(), added.end(), first);
+	RestoreStartOrder(added);
+	return std::make_pair(first, first + tags.size());
+}
+
+size_t SmiTimeline::FindAtOrBeforeLine(const size_t line) const {
+	// first entry after line
+	size_t lo = 0, hi = m_starts.size();
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (GetLine(mid) <= line)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return npos;
+
+	// first entry on the same line as the one before it
+	const auto found = GetLine(lo - 1);
+	hi = lo - 1;
+	lo = 0;
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (GetLine(mid) < found)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+size_t SmiTimeline::FindActiveAt(const int64_t time) const {
+	if (m_byStart.empty()) {
+		const auto after = std::upper_bound(m_starts.begin(), m_starts.end(), time);
+		return after == m_starts.begin() ? npos : static_cast<size_t>(after - m_starts.begin() - 1);
+	}
+
+	const auto after = std::upper_bound(m_byStart.begin(), m_byStart.end(), time, [this](const int64_t t, const size_t index) {
+		return t < m_starts[index];
+	});
+	return after == m_byStart.begin() ? npos : *(after - 1);
+}
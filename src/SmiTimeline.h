@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Read access to a document that may live outside of memory the caller owns, such as an editor buffer.
+class SmiTextSource {
+public:
+	virtual ~SmiTextSource() = default;
+	virtual size_t GetLength() const = 0;
+	virtual std::string_view GetRange(size_t offset, size_t length) const = 0;
+	virtual size_t GetLineFromPosition(size_t position) const = 0;
+};
+
+// Index of every Sync tag in a document, in document order.
+// Kept as parallel arrays so that lookups by line or by time are binary searches.
+class SmiTimeline {
+	// Fenwick tree of shifts applied to every entry from some index onwards.
+	class DeltaTree {
+		std::vector<int64_t> m_tree;
+
+	public:
+		void Reset(size_t size);
+		void AddFrom(size_t index, int64_t delta);
+		int64_t Get(size_t index) const;
+	};
+
+	std::vector<int64_t> m_starts;
+	std::vector<size_t> m_lines;
+	std::vector<size_t> m_offsets;
+	std::vector<uint32_t> m_tagLengths;
+	std::vector<int64_t> m_ends; // -1 for a Sync without an End value
+
+	// Edits shift every later entry; the shifts are kept here and folded into the arrays above only when entries are inserted or removed.
+	DeltaTree m_lineDeltas;
+	DeltaTree m_offsetDeltas;
+	bool m_hasDeltas = false;
+
+	// Entry indices stably sorted by start; empty if m_starts is already sorted.
+	std::vector<size_t> m_byStart;
+	// Number of entries whose start is less than the one before them; m_byStart is kept only while there are any.
+	size_t m_descents = 0;
+
+	size_t ScanRange(std::string_view text, size_t begin, size_t end);
+	void BuildStartOrder();
+	size_t CountDescents(size_t begin, size_t end) const;
+	bool IsBeforeByStart(size_t a, size_t b) const;
+	void EraseFromStartOrder(size_t index);
+	void RestoreStartOrder(const std::vector<size_t>& missing);
+	void ResetDeltas();
+	void ApplyDeltas();
+	size_t FindFirstEndingAtOrAfter(size_t offset) const;
+	size_t FindFirstStartingAfter(size_t offset) const;
+
+public:
+	static constexpr size_t npos = static_cast<size_t>(-1);
+	// Chunks smaller than this are not worth a thread of their own.
+	static constexpr size_t MIN_CHUNK_SIZE = 4 << 20;
+
+	void Clear();
+
+	// Large texts are cut at "<sync" boundaries and scanned on up to threadCount threads (0: one per core), each with minChunkSize bytes at least.
+	// The result is the same as scanning the whole text on a single thread.
+	void Build(std::string_view text, unsigned threadCount = 0, size_t minChunkSize = MIN_CHUNK_SIZE);
+
+	// Call after [position, position + removedLength) was replaced with insertedLength bytes.
+	// Only the text between the neighboring unaffected Syncs is scanned again.
+	// An edit that keeps the number of Syncs costs O(log n) per Sync scanned, plus moving entries of m_byStart while starts are out of order;
+	// adding or removing Syncs moves every later entry, which is O(n) but never sorts.
+	// Returns the entries found there, as [first, end) in the updated index.
+	std::pair<size_t, size_t> Update(const SmiTextSource& source, size_t position, size_t removedLength, size_t insertedLength, ptrdiff_t linesAdded);
+
+	size_t Size() const { return m_starts.size(); }
+	bool Empty() const { return m_starts.empty(); }
+	int64_t GetStart(const size_t index) const { return m_starts[index]; }
+	size_t GetLine(size_t index) const;
+	size_t GetOffset(size_t index) const;
+	size_t GetTagLength(const size_t index) const { return m_tagLengths[index]; }
+	// End value of the Sync, or -1 if it has none.
+	int64_t GetEnd(const size_t index) const { return m_ends[index]; }
+
+	// First Sync on the closest line at or before line; npos if there is none.
+	size_t FindAtOrBeforeLine(size_t line) const;
+
+	// Sync with the greatest start not after time (the later one in the document on ties); npos if there is none.
+	size_t FindActiveAt(int64_t time) const;
+};
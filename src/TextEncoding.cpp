@@ -0,0 +1,386 @@
+#include "TextEncoding.h"
+#include "HtmlEntities.h"
+#include <cstdint>
+#include <cstring>
+
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTENCODING_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TEXTENCODING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TEXTENCODING_TARGET(ISA)
+#else
+#define TEXTENCODING_TARGET(ISA) __attribute__((target(ISA)))
+#endif
+#endif
+
+namespace TextEncoding {
+	static const uint16_t CP949_TABLE[126][190] = {
+#include "Cp949Table.inc"
+	};
+
+	static bool IsCp949Pair(const uint8_t lead, const uint8_t trail) {
+		return lead >= 0x81 && lead <= 0xFE && trail >= 0x41 && trail <= 0xFE && CP949_TABLE[lead - 0x81][trail - 0x41] != 0;
+	}
+
+	// Length of the run of ASCII bytes at the start of data.
+	static size_t SkipAscii(const uint8_t* data, const size_t size) {
+		size_t i = 0;
+#ifdef TEXTENCODING_SSE2
+		for (; i + 16 <= size; i += 16) {
+			const auto mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+			if (mask != 0) {
+				for (auto bit = mask; !(bit & 1); bit >>= 1)
+					++i;
+				return i;
+			}
+		}
+#endif
+		while (i < size && data[i] < 0x80)
+			++i;
+		return i;
+	}
+
+	// Length of the valid UTF-8 sequence at data[0] >= 0x80, or 0.
+	static size_t MatchUtf8Sequence(const uint8_t* data, const size_t size, uint32_t& codePoint) {
+		const auto lead = data[0];
+		size_t length;
+		uint32_t min;
+		if (lead >= 0xC2 && lead <= 0xDF) {
+			length = 2;
+			min = 0x80;
+			codePoint = lead & 0x1F;
+		} else if (lead >= 0xE0 && lead <= 0xEF) {
+			length = 3;
+			min = 0x800;
+			codePoint = lead & 0x0F;
+		} else if (lead >= 0xF0 && lead <= 0xF4) {
+			length = 4;
+			min = 0x10000;
+			codePoint = lead & 0x07;
+		} else
+			return 0;
+
+		if (size < length)
+			return 0;
+		for (size_t i = 1; i < length; ++i) {
+			if ((data[i] & 0xC0) != 0x80)
+				return 0;
+			codePoint = (codePoint << 6) | (data[i] & 0x3F);
+		}
+		if (codePoint < min || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint < 0xE000))
+			return 0;
+		return length;
+	}
+
+	static bool IsValidUtf8Scalar(const uint8_t* p, const size_t size) {
+		for (size_t i = 0; i < size;) {
+			i += SkipAscii(p + i, size - i);
+			if (i == size)
+				break;
+			uint32_t codePoint;
+			const auto length = MatchUtf8Sequence(p + i, size - i, codePoint);
+			if (length == 0)
+				return false;
+			i += length;
+		}
+		return true;
+	}
+
+#ifdef TEXTENCODING_X86
+	// Keiser and Lemire's lookup algorithm ("Validating UTF-8 In Less Than One Instruction Per Byte", 2021):
+	// three 16-entry tables, indexed by the nibbles of each byte and the one before it, flag every error
+	// that a pair of bytes can show; the bytes two and three back tell where a continuation is required.
+	enum : uint8_t {
+		TOO_SHORT = 1 << 0, // lead or ASCII after a lead
+		TOO_LONG = 1 << 1, // continuation after ASCII
+		OVERLONG_3 = 1 << 2, // E0 80-9F
+		TOO_LARGE = 1 << 3, // F4 90-BF, or F5-FF
+		SURROGATE = 1 << 4, // ED A0-BF
+		OVERLONG_2 = 1 << 5, // C0-C1
+		TOO_LARGE_1000 = 1 << 6, // F5-FF 80-8F
+		OVERLONG_4 = 1 << 6, // F0 80-8F
+		TWO_CONTS = 1 << 7, // continuation after continuation; an error unless a 3 or 4 byte sequence needs it
+		CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+	};
+
+	TEXTENCODING_TARGET("ssse3")
+	static inline __m128i CheckUtf8Block(const __m128i input, const __m128i previous) {
+		const auto byte1High = _mm_setr_epi8(
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+			static_cast<char>(TWO_CONTS), static_cast<char>(TWO_CONTS), static_cast<char>(TWO_CONTS), static_cast<char>(TWO_CONTS),
+			TOO_SHORT | OVERLONG_2,
+			TOO_SHORT,
+			TOO_SHORT | OVERLONG_3 | SURROGATE,
+			TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+		const auto byte1Low = _mm_setr_epi8(
+			static_cast<char>(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+			static_cast<char>(CARRY | OVERLONG_2),
+			static_cast<char>(CARRY),
+			static_cast<char>(CARRY),
+			static_cast<char>(CARRY | TOO_LARGE),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000));
+		const auto byte2High = _mm_setr_epi8(
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+			static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+			static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+			static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+		const auto nibble = _mm_set1_epi8(0x0F);
+
+		const auto previous1 = _mm_alignr_epi8(input, previous, 15);
+		const auto special = _mm_and_si128(_mm_and_si128(
+			_mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(previous1, 4), nibble)),
+			_mm_shuffle_epi8(byte1Low, _mm_and_si128(previous1, nibble))),
+			_mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+		// only bytes after E0-FF and F0-FF keep their high bit
+		const auto third = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 14), _mm_set1_epi8(0xE0 - 0x80));
+		const auto fourth = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 13), _mm_set1_epi8(0xF0 - 0x80));
+		const auto mustContinue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+		return _mm_xor_si128(mustContinue, special);
+	}
+
+	TEXTENCODING_TARGET("ssse3")
+	static bool IsValidUtf8Ssse3(const uint8_t* p, const size_t size) {
+		// nonzero where a lead byte in the last three is still waiting for continuations
+		const auto lastLeads = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+		auto error = _mm_setzero_si128();
+		auto previous = _mm_setzero_si128();
+		auto incomplete = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 16 <= size; i += 16) {
+			const auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			if (_mm_movemask_epi8(input) == 0)
+				error = _mm_or_si128(error, incomplete);
+			else {
+				error = _mm_or_si128(error, CheckUtf8Block(input, previous));
+				incomplete = _mm_subs_epu8(input, lastLeads);
+			}
+			previous = input;
+		}
+
+		// The rest, padded with zeros: ASCII, which fails a sequence cut off at the end like any other.
+		uint8_t last[16] = {};
+		memcpy(last, p + i, size - i);
+		error = _mm_or_si128(error, CheckUtf8Block(_mm_loadu_si128(reinterpret_cast<const __m128i*>(last)), previous));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+	}
+
+	static bool CpuSupportsSsse3() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return !!(info[2] & (1 << 9));
+#else
+		return __builtin_cpu_supports("ssse3");
+#endif
+	}
+#endif
+
+	static bool IsKernelSupported(const Kernel kernel) {
+		switch (kernel) {
+#ifdef TEXTENCODING_X86
+			case Kernel::SSSE3:
+				return CpuSupportsSsse3();
+#endif
+			case Kernel::SCALAR:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	static std::atomic<Kernel>& SelectedKernel() {
+		static std::atomic<Kernel> kernel{ IsKernelSupported(Kernel::SSSE3) ? Kernel::SSSE3 : Kernel::SCALAR };
+		return kernel;
+	}
+
+	bool SelectKernel(const Kernel kernel) {
+		if (!IsKernelSupported(kernel))
+			return false;
+		SelectedKernel() = kernel;
+		return true;
+	}
+
+	Kernel GetKernel() {
+		return SelectedKernel();
+	}
+
+	bool IsValidUtf8(std::string_view data) {
+		const auto p = reinterpret_cast<const uint8_t*>(data.data());
+#ifdef TEXTENCODING_X86
+		if (SelectedKernel().load(std::memory_order_relaxed) == Kernel::SSSE3)
+			return IsValidUtf8Ssse3(p, data.size());
+#endif
+		return IsValidUtf8Scalar(p, data.size());
+	}
+
+	// SMI files are mostly ASCII markup, so as UTF-16 every other byte of the first few KB is mostly zero.
+	static Encoding GuessUtf16(std::string_view data) {
+		const auto size = data.size() < 4096 ? data.size() & ~static_cast<size_t>(1) : 4096;
+		if (size < 4)
+			return Encoding::UNKNOWN;
+		size_t evenZeros = 0, oddZeros = 0;
+		for (size_t i = 0; i < size; i += 2) {
+			evenZeros += data[i] == 0;
+			oddZeros += data[i + 1] == 0;
+		}
+		const auto units = size / 2;
+		if (oddZeros * 10 > units * 3 && evenZeros * 20 < units)
+			return Encoding::UTF16LE;
+		if (evenZeros * 10 > units * 3 && oddZeros * 20 < units)
+			return Encoding::UTF16BE;
+		return Encoding::UNKNOWN;
+	}
+
+	static bool LooksLikeCp949(std::string_view data) {
+		const auto p = reinterpret_cast<const uint8_t*>(data.data());
+		size_t valid = 0, invalid = 0;
+		for (size_t i = 0; i < data.size();) {
+			i += SkipAscii(p + i, data.size() - i);
+			if (i == data.size())
+				break;
+			if (i + 1 < data.size() && IsCp949Pair(p[i], p[i + 1])) {
+				++valid;
+				i += 2;
+			} else {
+				++invalid;
+				++i;
+			}
+		}
+		return valid > 0 && invalid * 100 <= valid;
+	}
+
+	Detection Detect(std::string_view data) {
+		Detection result;
+		if (data.size() >= 3 && memcmp(data.data(), "\xEF\xBB\xBF", 3) == 0) {
+			result.encoding = Encoding::UTF8;
+			result.bomLength = 3;
+		} else if (data.size() >= 2 && memcmp(data.data(), "\xFF\xFE", 2) == 0) {
+			result.encoding = Encoding::UTF16LE;
+			result.bomLength = 2;
+		} else if (data.size() >= 2 && memcmp(data.data(), "\xFE\xFF", 2) == 0) {
+			result.encoding = Encoding::UTF16BE;
+			result.bomLength = 2;
+		} else if ((result.encoding = GuessUtf16(data)) != Encoding::UNKNOWN) {
+			// no BOM
+		} else if (IsValidUtf8(data))
+			result.encoding = Encoding::UTF8;
+		else if (LooksLikeCp949(data))
+			result.encoding = Encoding::CP949;
+		return result;
+	}
+
+	static void AppendCodePoint(const uint32_t codePoint, std::string& out) {
+		char buf[4];
+		out.append(buf, HtmlEntities::EncodeUtf8(codePoint, buf));
+	}
+
+	void Utf16ToUtf8(std::string_view data, const bool bigEndian, std::string& out) {
+		const auto p = reinterpret_cast<const uint8_t*>(data.data());
+		const auto units = data.size() / 2;
+		out.reserve(out.size() + units);
+
+		const auto unitAt = [&](const size_t i) -> uint32_t {
+			return bigEndian ? (p[i * 2] << 8) | p[i * 2 + 1] : p[i * 2] | (p[i * 2 + 1] << 8);
+		};
+
+		for (size_t i = 0; i < units;) {
+#ifdef TEXTENCODING_SSE2
+			// eight ASCII units at a time
+			const auto highMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+			while (i + 8 <= units) {
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 2));
+				if (bigEndian)
+					v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, highMask), _mm_setzero_si128())) != 0xFFFF)
+					break;
+				char packed[16];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(packed), _mm_packus_epi16(v, v));
+				out.append(packed, 8);
+				i += 8;
+			}
+			if (i == units)
+				break;
+#endif
+			const auto unit = unitAt(i++);
+			if (unit >= 0xD800 && unit < 0xDC00 && i < units) {
+				const auto low = unitAt(i);
+				if (low >= 0xDC00 && low < 0xE000) {
+					AppendCodePoint(0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00), out);
+					++i;
+					continue;
+				}
+			}
+			AppendCodePoint(unit >= 0xD800 && unit < 0xE000 ? 0xFFFD : unit, out);
+		}
+		if (data.size() & 1)
+			AppendCodePoint(0xFFFD, out);
+	}
+
+	void Cp949ToUtf8(std::string_view data, std::string& out) {
+		const auto p = reinterpret_cast<const uint8_t*>(data.data());
+		const auto size = data.size();
+		// written in place: a byte becomes at most 3, as U+FFFD
+		const auto begin = out.size();
+		out.resize(begin + size * 3);
+		auto o = &out[begin];
+		for (size_t i = 0; i < size;) {
+			const auto ascii = SkipAscii(p + i, size - i);
+			memcpy(o, data.data() + i, ascii);
+			o += ascii;
+			i += ascii;
+			if (i == size)
+				break;
+
+			// every code point of the table is in the BMP
+			uint32_t codePoint = 0xFFFD;
+			if (i + 1 < size && IsCp949Pair(p[i], p[i + 1])) {
+				codePoint = CP949_TABLE[p[i] - 0x81][p[i + 1] - 0x41];
+				i += 2;
+			} else
+				++i;
+			o += HtmlEntities::EncodeUtf8(codePoint, o);
+		}
+		out.resize(static_cast<size_t>(o - out.data()));
+	}
+
+	bool ToUtf8(std::string_view data, std::string& out) {
+		const auto detection = Detect(data);
+		data.remove_prefix(detection.bomLength);
+		switch (detection.encoding) {
+			case Encoding::UTF8:
+				out.append(data.data(), data.size());
+				return true;
+			case Encoding::UTF16LE:
+			case Encoding::UTF16BE:
+				Utf16ToUtf8(data, detection.encoding == Encoding::UTF16BE, out);
+				return true;
+			case Encoding::CP949:
+				Cp949ToUtf8(data, out);
+				return true;
+			default:
+				return false;
+		}
+	}
+}
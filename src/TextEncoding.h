@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace TextEncoding {
+	enum class Encoding {
+		UNKNOWN,
+		UTF8, // includes plain ASCII
+		UTF16LE,
+		UTF16BE,
+		CP949, // includes EUC-KR
+	};
+
+	struct Detection {
+		Encoding encoding = Encoding::UNKNOWN;
+		size_t bomLength = 0;
+	};
+
+	// Looks at the BOM first; without one, tells UTF-16 apart by its zero bytes,
+	// then accepts valid UTF-8, then CP949 if nearly all non-ASCII bytes form valid CP949 pairs.
+	Detection Detect(std::string_view data);
+
+	// Rejects overlong forms, surrogates and code points past U+10FFFF.
+	// With SSSE3, checks 16 bytes at a time with table lookups; otherwise skips ASCII runs 16 bytes at a time and checks the rest byte by byte.
+	bool IsValidUtf8(std::string_view data);
+
+	// Implementations of IsValidUtf8. The best one the CPU supports is used unless the tests or benchmarks select another.
+	enum class Kernel {
+		SCALAR,
+		SSSE3
+	};
+	// Returns false, keeping the current one, if the CPU does not support kernel.
+	bool SelectKernel(Kernel kernel);
+	Kernel GetKernel();
+
+	// The converters append to out; malformed input becomes U+FFFD. data excludes the BOM.
+	void Utf16ToUtf8(std::string_view data, bool bigEndian, std::string& out);
+	void Cp949ToUtf8(std::string_view data, std::string& out);
+
+	// Detects the encoding and converts to UTF-8 without a BOM. Returns false if the encoding is unknown.
+	bool ToUtf8(std::string_view data, std::string& out);
+};
@@ -0,0 +1,4 @@
+#pragma once
+
+#define IDD_SHIFT_TIMINGS 101
+#define IDC_SHIFT_AMOUNT 1001
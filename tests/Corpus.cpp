@@ -0,0 +1,67 @@
+#include "Corpus.h"
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace Corpus {
+	static const char* const HEADER =
+		"<SAMI>\r\n<HEAD>\r\n<TITLE>Generated</TITLE>\r\n<STYLE TYPE=\"text/css\">\r\n<!--\r\n"
+		"P { margin-left:8pt; margin-right:8pt; margin-bottom:2pt; margin-top:2pt;\r\n"
+		"    text-align:center; font-size:20pt; font-family:Arial, Sans-serif; font-weight:bold; color:white; }\r\n"
+		".KRCC { Name:Korean; lang:ko-KR; SAMIType:CC; }\r\n"
+		".ENCC { Name:English; lang:en-US; SAMIType:CC; }\r\n"
+		"-->\r\n</STYLE>\r\n</HEAD>\r\n<BODY>\r\n";
+
+	static const char* const LINES[] = {
+		"\xEC\x95\x88\xEB\x85\x95\xED\x95\x98\xEC\x84\xB8\xEC\x9A\x94", // 안녕하세요
+		"\xEA\xB7\xB8\xEB\x9E\x98\xEC\x84\x9C \xEC\x96\xB4\xEB\x96\xBB\xEA\xB2\x8C \xEB\x90\x90\xEC\x96\xB4?", // 그래서 어떻게 됐어?
+		"<font color=\"#ffff00\">(\xEC\x9D\x8C\xEC\x95\x85)</font>", // (음악)
+		"Tom &amp; Jerry",
+		"- \xEA\xB0\x80\xEC\x9E\x90!<br>- \xEC\xA7\x80\xEA\xB8\x88?", // - 가자!<br>- 지금?
+		"&quot;\xEC\xA0\x95\xEB\xA7\x90\xEC\x9D\xB4\xEC\x95\xBC&quot;", // "정말이야"
+		"I don't know what you're talking about.",
+		"<i>\xEB\x82\x98\xEB\xA0\x88\xEC\x9D\xB4\xEC\x85\x98</i>", // 나레이션
+	};
+
+	std::string MakeSmi(const size_t captions, const uint32_t seed) {
+		std::mt19937 random(seed);
+		const auto pick = [&](const uint32_t n) { return static_cast<uint32_t>(random() % n); };
+
+		std::string text = HEADER;
+		text.reserve(text.size() + captions * 110);
+		int64_t start = 1000 + pick(5000);
+		char tag[96];
+		for (size_t i = 0; i < captions; ++i) {
+			static const char* const FORMATS[] = {
+				"<SYNC Start=%" PRId64 "><P Class=KRCC>",
+				"<Sync Start=%" PRId64 "><P Class=KRCC>",
+				"<sync start=\"%" PRId64 "\"><p class=\"KRCC\">",
+				"<SYNC Start=%" PRId64 " End=%" PRId64 "><P Class=KRCC>",
+			};
+			const auto format = pick(8);
+			const auto end = start + 800 + pick(3000);
+			snprintf(tag, sizeof tag, FORMATS[format < 5 ? 0 : format - 4], start, end);
+			text += tag;
+			text += format == 7 ? "\r\n" : "";
+			text += LINES[pick(sizeof LINES / sizeof LINES[0])];
+			if (pick(3) == 0) {
+				text += "<br>";
+				text += LINES[pick(sizeof LINES / sizeof LINES[0])];
+			}
+			text += "\r\n";
+
+			snprintf(tag, sizeof tag, "<SYNC Start=%" PRId64 "><P Class=KRCC>&nbsp;\r\n", end);
+			text += tag;
+			start = end + 100 + pick(4000);
+		}
+		text += "</BODY>\r\n</SAMI>\r\n";
+		return text;
+	}
+
+	std::string ReadFile(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+}
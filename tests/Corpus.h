@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Generated documents for the tests and benchmarks.
+namespace Corpus {
+	// An SMI document like the ones subtitle editors write: a STYLE header, then captions in a KRCC paragraph,
+	// each followed by a blank &nbsp; Sync, with tag case, quoting and line breaks varying the way they do in real files.
+	// Starts increase; the same seed gives the same document.
+	std::string MakeSmi(size_t captions, uint32_t seed = 1);
+
+	// The whole file, or an empty string if it cannot be read.
+	std::string ReadFile(const std::string& path);
+};
@@ -0,0 +1,290 @@
+#include "FakeMpcHc.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static bool SendAll(const int connection, const char* data, size_t size) {
+	while (size > 0) {
+		const auto sent = send(connection, data, size, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return false;
+		data += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+// Reads one request off the connection into method, path and body; false once the client closes it.
+static bool ReadRequest(const int connection, std::string& buffer, std::string& method, std::string& path, std::string& body) {
+	size_t headerEnd;
+	while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+		char received[4096];
+		const auto length = recv(connection, received, sizeof received, 0);
+		if (length <= 0)
+			return false;
+		buffer.append(received, static_cast<size_t>(length));
+	}
+
+	const auto methodEnd = buffer.find(' ');
+	const auto pathEnd = buffer.find(' ', methodEnd + 1);
+	if (methodEnd == std::string::npos || pathEnd == std::string::npos || pathEnd > headerEnd)
+		return false;
+	method = buffer.substr(0, methodEnd);
+	path = buffer.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+	size_t contentLength = 0;
+	const auto header = buffer.find("Content-Length:");
+	if (header != std::string::npos && header < headerEnd)
+		contentLength = strtoul(buffer.c_str() + header + 15, nullptr, 10);
+
+	const auto bodyBegin = headerEnd + 4;
+	while (buffer.size() < bodyBegin + contentLength) {
+		char received[4096];
+		const auto length = recv(connection, received, sizeof received, 0);
+		if (length <= 0)
+			return false;
+		buffer.append(received, static_cast<size_t>(length));
+	}
+	body = buffer.substr(bodyBegin, contentLength);
+	buffer.erase(0, bodyBegin + contentLength);
+	return true;
+}
+
+FakeMpcHc::FakeMpcHc(const Listening listening) {
+	m_listener = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLength = sizeof address;
+	if (m_listener == -1 || bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0
+		|| listen(m_listener, listening == Listening::ACCEPT ? 16 : 0) != 0 || getsockname(m_listener, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0) {
+		perror("FakeMpcHc");
+		abort();
+	}
+	m_port = ntohs(address.sin_port);
+	if (listening == Listening::ACCEPT) {
+		m_acceptor = std::thread(&FakeMpcHc::AcceptMain, this);
+		return;
+	}
+
+	// Connect until the kernel stops completing handshakes; from then on it drops the SYNs.
+	while (true) {
+		const auto connection = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		m_backlog.push_back(connection);
+		if (connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0)
+			continue;
+		pollfd connecting{ connection, POLLOUT, 0 };
+		if (errno != EINPROGRESS || poll(&connecting, 1, 50) != 1)
+			break;
+	}
+}
+
+FakeMpcHc::~FakeMpcHc() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		for (const auto connection : m_connections)
+			shutdown(connection, SHUT_RDWR);
+	}
+	m_stopped.notify_all();
+
+	// Wakes the acceptor out of accept.
+	shutdown(m_listener, SHUT_RDWR);
+	if (m_acceptor.joinable())
+		m_acceptor.join();
+	close(m_listener);
+	for (const auto connection : m_backlog)
+		close(connection);
+
+	// No new handlers once the acceptor is gone.
+	for (auto& handler : m_handlers)
+		handler.join();
+}
+
+void FakeMpcHc::AcceptMain() {
+	while (true) {
+		const auto connection = accept(m_listener, nullptr, nullptr);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stopping) {
+			if (connection != -1)
+				close(connection);
+			return;
+		}
+		if (connection == -1)
+			continue;
+		++m_counters.connections;
+		// Pieces go out as they are written, not held back until the client acknowledges the last one.
+		const int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof noDelay);
+		m_connections.push_back(connection);
+		m_handlers.emplace_back(&FakeMpcHc::ConnectionMain, this, connection);
+	}
+}
+
+void FakeMpcHc::ConnectionMain(const int connection) {
+	std::string buffer, method, path, body;
+	for (unsigned answered = 0; ReadRequest(connection, buffer, method, path, body);) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		const auto behavior = m_behavior;
+		++m_counters.requests;
+		if (m_dropNext > 0 || std::uniform_real_distribution<double>()(m_random) < behavior.dropProbability) {
+			if (m_dropNext > 0)
+				--m_dropNext;
+			++m_counters.drops;
+			break;
+		}
+		if (!behavior.answer)
+			continue;
+		auto delay = behavior.delay;
+		if (behavior.jitter.count() > 0)
+			delay += std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0, behavior.jitter.count())(m_random));
+		if (m_stopped.wait_for(lock, delay, [this] { return m_stopping; }))
+			break;
+
+		std::string status = "200 OK", content;
+		if (method == "GET" && path == "/variables.html")
+			content = MakeVariablesPage();
+		else if (method == "POST" && path == "/command.html") {
+			RunCommand(body);
+			++m_counters.commands;
+			// The player answers a command with its whole control page.
+			content = "<!DOCTYPE html>\r\n<html>\r\n<head><title>MPC-HC WebServer - Controls</title></head>\r\n<body>\r\n" + std::string(2048, ' ') + "\r\n</body>\r\n</html>\r\n";
+		} else {
+			status = "404 Not Found";
+			content = "<html><body>404</body></html>";
+		}
+		lock.unlock();
+
+		++answered;
+		const auto keepAlive = behavior.keepAlive && (behavior.requestsPerConnection == 0 || answered < behavior.requestsPerConnection);
+		auto response = "HTTP/1.1 " + status + "\r\nServer: MPC-HC WebServer\r\nContent-Type: text/html; charset=utf-8\r\n";
+		if (!keepAlive)
+			response += "Connection: close\r\n";
+		if (behavior.chunked) {
+			response += "Transfer-Encoding: chunked\r\n\r\n";
+			const auto chunkSize = behavior.pieceSize == 0 ? content.size() : behavior.pieceSize;
+			for (size_t i = 0; i < content.size(); i += chunkSize) {
+				char size[32];
+				snprintf(size, sizeof size, "%zx\r\n", std::min(chunkSize, content.size() - i));
+				response += size + content.substr(i, chunkSize) + "\r\n";
+			}
+			response += "0\r\n\r\n";
+		} else
+			response += "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+
+		const auto pieceSize = behavior.pieceSize == 0 ? response.size() : behavior.pieceSize;
+		auto sent = true;
+		for (size_t i = 0; sent && i < response.size(); i += pieceSize) {
+			if (i > 0 && behavior.pieceDelay.count() > 0)
+				std::this_thread::sleep_for(behavior.pieceDelay);
+			sent = SendAll(connection, response.data() + i, std::min(pieceSize, response.size() - i));
+		}
+		if (!sent || !keepAlive)
+			break;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_connections.erase(std::find(m_connections.begin(), m_connections.end(), connection));
+	close(connection);
+}
+
+int64_t FakeMpcHc::PositionAt(const std::chrono::steady_clock::time_point time) const {
+	if (m_state != 2)
+		return m_position;
+	const auto elapsed = std::chrono::duration<double, std::milli>(time - m_positionTime).count() * m_playbackRate;
+	return std::min(m_duration, m_position + static_cast<int64_t>(elapsed));
+}
+
+void FakeMpcHc::RunCommand(const std::string& form) {
+	const auto now = std::chrono::steady_clock::now();
+	int64_t hours, minutes, seconds, milliseconds;
+	if (form == "wm_command=889") {
+		m_position = PositionAt(now);
+		m_positionTime = now;
+		m_state = m_state == 2 ? 1 : 2;
+	} else if (sscanf(form.c_str(), "wm_command=-1&position=%" SCNd64 ":%" SCNd64 ":%" SCNd64 ":%" SCNd64, &hours, &minutes, &seconds, &milliseconds) == 4) {
+		m_position = std::min(m_duration, ((hours * 60 + minutes) * 60 + seconds) * 1000 + milliseconds);
+		m_positionTime = now;
+	}
+}
+
+std::string FakeMpcHc::MakeVariablesPage() {
+	const auto position = PositionAt(std::chrono::steady_clock::now());
+	char page[2048];
+	snprintf(page, sizeof page,
+		"<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Strict//EN\" \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-strict.dtd\">\r\n"
+		"<html xmlns=\"http://www.w3.org/1999/xhtml\" xml:lang=\"en\" lang=\"en\">\r\n"
+		"<head>\r\n"
+		"<meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\" />\r\n"
+		"<title>MPC-HC WebServer - Variables</title>\r\n"
+		"<link rel=\"stylesheet\" href=\"default.css\" />\r\n"
+		"</head>\r\n"
+		"<body class=\"page-variables\">\r\n"
+		"<p id=\"file\">video.mkv</p>\r\n"
+		"<p id=\"filepatharg\">C:%%5cVideos%%5cvideo.mkv</p>\r\n"
+		"<p id=\"filepath\">C:\\Videos\\video.mkv</p>\r\n"
+		"<p id=\"filedirarg\">C:%%5cVideos</p>\r\n"
+		"<p id=\"filedir\">C:\\Videos</p>\r\n"
+		"<p id=\"state\">%d</p>\r\n"
+		"<p id=\"statestring\">%s</p>\r\n"
+		"<p id=\"position\">%" PRId64 "</p>\r\n"
+		"<p id=\"positionstring\">%02" PRId64 ":%02" PRId64 ":%02" PRId64 "</p>\r\n"
+		"<p id=\"duration\">%" PRId64 "</p>\r\n"
+		"<p id=\"durationstring\">%02" PRId64 ":%02" PRId64 ":%02" PRId64 "</p>\r\n"
+		"<p id=\"volumelevel\">100</p>\r\n"
+		"<p id=\"muted\">0</p>\r\n"
+		"<p id=\"playbackrate\">%g</p>\r\n"
+		"<p id=\"size\">1.2 GB</p>\r\n"
+		"<p id=\"reloadtime\">0</p>\r\n"
+		"<p id=\"version\">1.9.24.0</p>\r\n"
+		"</body>\r\n"
+		"</html>\r\n",
+		m_state, m_state == 2 ? "Playing" : m_state == 1 ? "Paused" : "Stopped",
+		position, position / 3600000, position / 60000 % 60, position / 1000 % 60,
+		m_duration, m_duration / 3600000, m_duration / 60000 % 60, m_duration / 1000 % 60,
+		m_playbackRate);
+	return page;
+}
+
+void FakeMpcHc::SetBehavior(const Behavior& behavior) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_behavior = behavior;
+}
+
+void FakeMpcHc::DropNext(const size_t count) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_dropNext = count;
+}
+
+FakeMpcHc::Counters FakeMpcHc::GetCounters() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_counters;
+}
+
+void FakeMpcHc::SetPlayer(const int state, const int64_t position, const int64_t duration, const double playbackRate) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_state = state;
+	m_position = position;
+	m_positionTime = std::chrono::steady_clock::now();
+	m_duration = duration;
+	m_playbackRate = playbackRate;
+}
+
+int FakeMpcHc::GetState() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_state;
+}
+
+int64_t FakeMpcHc::GetPosition() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return PositionAt(std::chrono::steady_clock::now());
+}
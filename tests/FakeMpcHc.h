@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A stand-in for MPC-HC's web interface on a loopback port, run in-process on its own threads.
+// Answers /variables.html and /command.html the way the player does, from a player that plays in real time,
+// with delays, jitter and dropped connections as set in its Behavior.
+class FakeMpcHc {
+public:
+	enum class Listening {
+		ACCEPT,
+		// Never accepts, and fills its backlog first, so that connection attempts go unanswered as on a port that drops SYNs.
+		NEVER_ACCEPT
+	};
+
+	struct Behavior {
+		std::chrono::microseconds delay{ 0 }; // before every response
+		std::chrono::microseconds jitter{ 0 }; // a uniformly random extra delay up to this
+		double dropProbability = 0; // of closing the connection instead of answering a request
+		bool keepAlive = true;
+		unsigned requestsPerConnection = 0; // closed after answering this many; 0 for no limit
+		bool chunked = false;
+		size_t pieceSize = 0; // the response is written this many bytes at a time, or at once for 0
+		std::chrono::microseconds pieceDelay{ 0 }; // between the pieces
+		bool answer = true; // if not, requests are read but never answered
+	};
+
+	struct Counters {
+		size_t connections = 0;
+		size_t requests = 0; // every request read, answered or not
+		size_t drops = 0;
+		size_t commands = 0; // POSTs to /command.html that were answered
+	};
+
+private:
+	int m_listener = -1;
+	unsigned m_port = 0;
+	std::thread m_acceptor;
+	std::vector<int> m_backlog; // connections that fill the backlog of a listener that never accepts
+
+	// Guards everything below.
+	std::mutex m_mutex;
+	std::condition_variable m_stopped;
+	bool m_stopping = false;
+	std::vector<std::thread> m_handlers;
+	std::vector<int> m_connections; // open ones, shut down when stopping
+	Behavior m_behavior;
+	Counters m_counters;
+	size_t m_dropNext = 0;
+	std::mt19937 m_random{ 1 };
+
+	int m_state = 1;
+	int64_t m_position = 0; // ms, as of m_positionTime
+	std::chrono::steady_clock::time_point m_positionTime = std::chrono::steady_clock::now();
+	int64_t m_duration = 5400000;
+	double m_playbackRate = 1;
+
+	void AcceptMain();
+	void ConnectionMain(int connection);
+	// Expects m_mutex to be held.
+	int64_t PositionAt(std::chrono::steady_clock::time_point time) const;
+	void RunCommand(const std::string& form);
+	std::string MakeVariablesPage();
+
+public:
+	explicit FakeMpcHc(Listening listening = Listening::ACCEPT);
+	FakeMpcHc(const FakeMpcHc&) = delete;
+	FakeMpcHc& operator =(const FakeMpcHc&) = delete;
+	~FakeMpcHc();
+
+	unsigned GetPort() const { return m_port; }
+
+	void SetBehavior(const Behavior& behavior);
+	// The next count requests are dropped, whatever the drop probability.
+	void DropNext(size_t count);
+	Counters GetCounters();
+
+	// state as in variables.html: 0 stopped, 1 paused, 2 playing.
+	void SetPlayer(int state, int64_t position, int64_t duration = 5400000, double playbackRate = 1);
+	int GetState();
+	int64_t GetPosition();
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A small runner for the tests and benchmarks of the platform-neutral sources.
+// TEST and BENCHMARK register a function; CHECK and CHECK_EQ report a failure and carry on.
+namespace Test {
+	struct Case {
+		const char* name;
+		void (*function)();
+	};
+
+	std::vector<Case>& Tests();
+	std::vector<Case>& Benchmarks();
+
+	struct Registrar {
+		Registrar(std::vector<Case>& cases, const char* name, void (*function)()) {
+			cases.push_back({ name, function });
+		}
+	};
+
+	void Fail(const char* file, int line, const std::string& message);
+
+	template<typename T, typename = void>
+	struct IsPrintable : std::false_type {};
+	template<typename T>
+	struct IsPrintable<T, std::void_t<decltype(std::declval<std::ostream&>() << std::declval<const T&>())>> : std::true_type {};
+
+	template<typename T>
+	std::string Show(const T& value) {
+		std::ostringstream out;
+		if constexpr (std::is_enum_v<T>)
+			out << static_cast<int64_t>(value);
+		else if constexpr (IsPrintable<T>::value)
+			out << value;
+		else
+			out << "(value)";
+		return out.str();
+	}
+
+	// Set by --quick: benchmarks use smaller inputs, so that they can run along with the tests.
+	bool IsQuick();
+	// Files given with --file, measured in addition to the generated documents.
+	const std::vector<std::string>& CorpusFiles();
+
+	// Best of repeat runs of function, in seconds.
+	template<typename TFunction>
+	double Time(TFunction&& function, const int repeat = 3) {
+		auto best = 1e300;
+		for (auto i = 0; i < repeat; ++i) {
+			const auto begin = std::chrono::steady_clock::now();
+			function();
+			const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			if (seconds < best)
+				best = seconds;
+		}
+		return best;
+	}
+
+	// The value below which the given fraction of samples lie; sorts samples.
+	double Percentile(std::vector<double>& samples, double fraction);
+};
+
+#define TEST_CONCAT_(A, B) A##B
+#define TEST_CONCAT(A, B) TEST_CONCAT_(A, B)
+
+#define TEST(NAME) \
+	static void Test_##NAME(); \
+	static const Test::Registrar TEST_CONCAT(testRegistrar, __LINE__)(Test::Tests(), #NAME, Test_##NAME); \
+	static void Test_##NAME()
+
+#define BENCHMARK(NAME) \
+	static void Benchmark_##NAME(); \
+	static const Test::Registrar TEST_CONCAT(benchmarkRegistrar, __LINE__)(Test::Benchmarks(), #NAME, Benchmark_##NAME); \
+	static void Benchmark_##NAME()
+
+#define CHECK(CONDITION) \
+	do { \
+		if (!(CONDITION)) \
+			Test::Fail(__FILE__, __LINE__, #CONDITION); \
+	} while (false)
+
+#define CHECK_EQ(ACTUAL, EXPECTED) \
+	do { \
+		const auto& actual_ = (ACTUAL); \
+		const auto& expected_ = (EXPECTED); \
+		if (!(actual_ == expected_)) \
+			Test::Fail(__FILE__, __LINE__, std::string(#ACTUAL " == " #EXPECTED ": ") + Test::Show(actual_) + " != " + Test::Show(expected_)); \
+	} while (false)
@@ -0,0 +1,122 @@
+#include "Test.h"
+#include "HtmlEntities.h"
+#include <string>
+
+// codePoint if text decodes whole, consuming every byte; 0 if it does not.
+static uint32_t DecodeAll(const std::string& text) {
+	uint32_t codePoint = 0;
+	return HtmlEntities::Decode(text, codePoint) == text.size() ? codePoint : 0;
+}
+
+TEST(HtmlEntities_Named) {
+	size_t count = 0;
+	const auto* entities = HtmlEntities::GetNamedEntities(count);
+	// The 252 of HTML 4, and apos.
+	CHECK_EQ(count, size_t(253));
+	for (size_t i = 0; i < count; ++i) {
+		const std::string name = entities[i].name;
+		CHECK_EQ(HtmlEntities::FindNamed(name), entities[i].codePoint);
+		CHECK_EQ(DecodeAll("&" + name + ";"), entities[i].codePoint);
+		CHECK_EQ(DecodeAll("&" + name + ";" + "rest"), uint32_t(0));
+		if (i > 0)
+			CHECK(std::string(entities[i - 1].name) < name);
+	}
+	CHECK_EQ(DecodeAll("&amp;"), uint32_t('&'));
+	CHECK_EQ(DecodeAll("&apos;"), uint32_t('\''));
+	CHECK_EQ(DecodeAll("&thetasym;"), uint32_t(0x03D1));
+	CHECK_EQ(DecodeAll("&euro;"), uint32_t(0x20AC));
+
+	// Names are case sensitive.
+	CHECK_EQ(DecodeAll("&Aring;"), uint32_t(0x00C5));
+	CHECK_EQ(DecodeAll("&aring;"), uint32_t(0x00E5));
+	for (const auto* unknown : { "", "a", "AMP", "Amp", "NBSP", "amp ", "ampx", "thetasymx" }) {
+		CHECK_EQ(HtmlEntities::FindNamed(unknown), uint32_t(0));
+		CHECK_EQ(DecodeAll(std::string("&") + unknown + ";"), uint32_t(0));
+	}
+}
+
+TEST(HtmlEntities_Numeric) {
+	CHECK_EQ(DecodeAll("&#65;"), uint32_t('A'));
+	CHECK_EQ(DecodeAll("&#x41;"), uint32_t('A'));
+	CHECK_EQ(DecodeAll("&#X4a;"), uint32_t('J'));
+	CHECK_EQ(DecodeAll("&#0000000000000000065;"), uint32_t('A'));
+	CHECK_EQ(DecodeAll("&#x10FFFF;"), uint32_t(0x10FFFF));
+	CHECK_EQ(DecodeAll("&#xA0;"), uint32_t(0xA0));
+	CHECK_EQ(DecodeAll("&#127;"), uint32_t(0x7F));
+
+	// 0x80-0x9F are Windows-1252, and its five holes are U+FFFD.
+	CHECK_EQ(DecodeAll("&#128;"), uint32_t(0x20AC));
+	CHECK_EQ(DecodeAll("&#x80;"), uint32_t(0x20AC));
+	CHECK_EQ(DecodeAll("&#150;"), uint32_t(0x2013));
+	CHECK_EQ(DecodeAll("&#x99;"), uint32_t(0x2122));
+	CHECK_EQ(DecodeAll("&#x9F;"), uint32_t(0x0178));
+	for (const auto* hole : { "&#x81;", "&#x8D;", "&#x8F;", "&#x90;", "&#x9D;" })
+		CHECK_EQ(DecodeAll(hole), uint32_t(0xFFFD));
+
+	// What no character can be is U+FFFD, however many digits it takes.
+	for (const auto* invalid : { "&#0;", "&#xD800;", "&#xDFFF;", "&#x110000;", "&#1114112;", "&#99999999999999999999999;", "&#xFFFFFFFFFFFFFFFFF;" })
+		CHECK_EQ(DecodeAll(invalid), uint32_t(0xFFFD));
+}
+
+TEST(HtmlEntities_Malformed) {
+	// Without its ';', with no digits or with anything else in them, a reference is not one.
+	for (const auto* malformed : { "", "&", "&;", "&#", "&#;", "&#x;", "&#65", "&#x41", "&#6 5;", "&#65a;", "&#xG;", "&# 65;", "&#-1;",
+			"&amp", "&amp ;", "& amp;", "&am p;", "amp;", "&&amp;" }) {
+		uint32_t codePoint = 7;
+		CHECK_EQ(HtmlEntities::Decode(malformed, codePoint), size_t(0));
+		CHECK_EQ(codePoint, uint32_t(7));
+	}
+
+	// Names are 8 letters at most, so a ';' further on ends no reference, even one FindNamed would know if cut short.
+	uint32_t codePoint = 0;
+	CHECK_EQ(HtmlEntities::Decode("&thetasym;", codePoint), size_t(10));
+	CHECK_EQ(HtmlEntities::Decode("&thetasyma;", codePoint), size_t(0));
+	CHECK_EQ(HtmlEntities::Decode("&ampampamp;", codePoint), size_t(0));
+	CHECK_EQ(HtmlEntities::FindNamed("thetasyma"), uint32_t(0));
+	// Only up to the first ';' is looked at.
+	CHECK_EQ(HtmlEntities::Decode("&lt;&gt;", codePoint), size_t(4));
+	CHECK_EQ(codePoint, uint32_t('<'));
+
+	// A caption of nothing but '&' is no reference anywhere, and is not read to its end for each of them.
+	const std::string ampersands(1 << 20, '&');
+	size_t decoded = 0;
+	const auto time = Test::Time([&] {
+		for (size_t pos = 0; pos < ampersands.size(); ++pos)
+			decoded += HtmlEntities::Decode(std::string_view(ampersands).substr(pos), codePoint);
+	}, 1);
+	CHECK_EQ(decoded, size_t(0));
+	CHECK(time < 1.0);
+}
+
+BENCHMARK(HtmlEntities_Decode) {
+	size_t count = 0;
+	const auto* entities = HtmlEntities::GetNamedEntities(count);
+	std::string text;
+	for (size_t i = 0; text.size() < (Test::IsQuick() ? 100000u : 10000000u); ++i) {
+		text += "caption &";
+		text += entities[i % count].name;
+		text += "; &#";
+		text += std::to_string(i % 0x2000);
+		text += "; & &&x;\r\n";
+	}
+
+	const auto decodeAll = [](std::string_view text, size_t& references) {
+		uint32_t codePoint = 0;
+		references = 0;
+		for (size_t pos = text.find('&'); pos != std::string_view::npos; pos = text.find('&', pos + 1)) {
+			const auto length = HtmlEntities::Decode(text.substr(pos), codePoint);
+			if (length != 0) {
+				++references;
+				pos += length - 1;
+			}
+		}
+	};
+	size_t references = 0;
+	const auto time = Test::Time([&] { decodeAll(text, references); });
+	printf("  %zu references in %.1f MB: %.2f ms, %.0f MB/s, %.1f ns per reference\n", references, text.size() / 1e6, time * 1e3,
+		text.size() / 1e6 / time, time * 1e9 / references);
+
+	const std::string ampersands(Test::IsQuick() ? 100000 : 1000000, '&');
+	const auto ampersandTime = Test::Time([&] { decodeAll(ampersands, references); });
+	printf("  %zu '&' with no ';': %.2f ms, %.1f ns each\n", ampersands.size(), ampersandTime * 1e3, ampersandTime * 1e9 / ampersands.size());
+}
@@ -0,0 +1,83 @@
+// Runs the tests, or with --bench the benchmarks, whose names contain the filter given.
+//   NppSmiTests [filter]
+//   NppSmiTests --bench [--quick] [--file corpus.smi]... [filter]
+
+#include "Test.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Test {
+	static size_t failures = 0;
+	static bool quick = false;
+	static std::vector<std::string> corpusFiles;
+
+	// A test failing in a loop prints the first few only.
+	static const size_t MAX_FAILURES_SHOWN = 20;
+	static size_t failuresInCase = 0;
+
+	std::vector<Case>& Tests() {
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	std::vector<Case>& Benchmarks() {
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	void Fail(const char* file, const int line, const std::string& message) {
+		++failures;
+		if (++failuresInCase <= MAX_FAILURES_SHOWN)
+			printf("  %s:%d: %s\n", file, line, message.c_str());
+		else if (failuresInCase == MAX_FAILURES_SHOWN + 1)
+			printf("  (further failures not shown)\n");
+	}
+
+	bool IsQuick() {
+		return quick;
+	}
+
+	const std::vector<std::string>& CorpusFiles() {
+		return corpusFiles;
+	}
+
+	double Percentile(std::vector<double>& samples, const double fraction) {
+		if (samples.empty())
+			return 0;
+		std::sort(samples.begin(), samples.end());
+		const auto index = static_cast<size_t>(std::ceil(fraction * samples.size()));
+		return samples[std::min(samples.size() - 1, index == 0 ? 0 : index - 1)];
+	}
+}
+
+int main(const int argc, char* argv[]) {
+	auto bench = false;
+	std::string filter;
+	for (auto i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--bench") == 0)
+			bench = true;
+		else if (strcmp(argv[i], "--quick") == 0)
+			Test::quick = true;
+		else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+			Test::corpusFiles.emplace_back(argv[++i]);
+		else
+			filter = argv[i];
+	}
+
+	setvbuf(stdout, nullptr, _IOLBF, 0);
+	size_t run = 0, failed = 0;
+	for (const auto& testCase : bench ? Test::Benchmarks() : Test::Tests()) {
+		if (strstr(testCase.name, filter.c_str()) == nullptr)
+			continue;
+		printf("%s\n", testCase.name);
+		const auto before = Test::failures;
+		Test::failuresInCase = 0;
+		testCase.function();
+		++run;
+		if (Test::failures != before)
+			++failed;
+	}
+	printf("%zu of %zu %s failed\n", failed, run, bench ? "benchmarks" : "tests");
+	return failed == 0 && run != 0 ? 0 : 1;
+}
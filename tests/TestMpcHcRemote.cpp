@@ -0,0 +1,546 @@
+#include "FakeMpcHc.h"
+#include "Test.h"
+#include "MpcHcRemote.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+using namespace MpcHcRemote;
+
+namespace {
+	// Points MpcHcRemote at a fake player for as long as it lives.
+	class Remote {
+	public:
+		FakeMpcHc player;
+
+		explicit Remote(const FakeMpcHc::Listening listening = FakeMpcHc::Listening::ACCEPT)
+			: player(listening) {
+			SetWebServerPort(player.GetPort());
+		}
+		~Remote() {
+			Disconnect();
+			SetWebServerPort(0);
+		}
+
+		// Lets the next request through even if the last one found the player down.
+		void ResetBreaker() {
+			SetWebServerPort(player.GetPort());
+		}
+	};
+}
+
+static double MillisecondsSince(const std::chrono::steady_clock::time_point begin) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template<typename TPredicate>
+static bool WaitUntil(TPredicate&& predicate) {
+	for (auto i = 0; i < 200; ++i) {
+		if (predicate())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return false;
+}
+
+TEST(MpcHcRemote_Variables) {
+	Remote remote;
+	remote.player.SetPlayer(1, 754321, 5432100, 1.25);
+	MpcHcVariables::PlayerVariables variables;
+	CHECK(GetVariables(variables));
+	CHECK_EQ(variables.state, 1);
+	CHECK_EQ(variables.position, 754321);
+	CHECK_EQ(variables.duration, 5432100);
+	CHECK_EQ(variables.playbackRate, 1.25);
+	CHECK_EQ(variables.file, std::string("video.mkv"));
+	CHECK_EQ(GetPlayerState(), PlayerState::PAUSED);
+	CHECK_EQ(GetCurrentPlayerTimestamp(), 754321);
+
+	// Requests share one connection.
+	CHECK(GetVariables(variables));
+	CHECK_EQ(remote.player.GetCounters().connections, 1u);
+	CHECK_EQ(remote.player.GetCounters().requests, 4u);
+}
+
+TEST(MpcHcRemote_Commands) {
+	Remote remote;
+	remote.player.SetPlayer(1, 1000);
+	CHECK(SendCommand(MpcHcCommand::PLAY_PAUSE));
+	CHECK_EQ(remote.player.GetState(), 2);
+	CHECK_EQ(GetPlayerState(), PlayerState::PLAYING);
+	CHECK(SendCommand(MpcHcCommand::PLAY_PAUSE));
+	CHECK_EQ(remote.player.GetState(), 1);
+
+	CHECK(Seek(3723456));
+	CHECK_EQ(remote.player.GetPosition(), 3723456);
+	CHECK_EQ(GetCurrentPlayerTimestamp(), 3723456);
+	CHECK_EQ(remote.player.GetCounters().commands, 3u);
+	CHECK_EQ(remote.player.GetCounters().connections, 1u);
+}
+
+TEST(MpcHcRemote_Framing) {
+	// Every way the response may come: closed after each one, chunked, and a few bytes at a time.
+	Remote remote;
+	remote.player.SetPlayer(2, 60000);
+	FakeMpcHc::Behavior behaviors[4];
+	behaviors[0].keepAlive = false;
+	behaviors[1].requestsPerConnection = 2;
+	behaviors[2].chunked = true;
+	behaviors[2].pieceSize = 7;
+	behaviors[3].pieceSize = 5;
+	for (const auto& behavior : behaviors) {
+		remote.player.SetBehavior(behavior);
+		for (auto i = 0; i < 3; ++i) {
+			MpcHcVariables::PlayerVariables variables;
+			CHECK(GetVariables(variables));
+			CHECK_EQ(variables.state, 2);
+			CHECK(variables.position >= 60000);
+			CHECK(Seek(60000));
+		}
+	}
+	CHECK_EQ(remote.player.GetCounters().drops, 0u);
+}
+
+TEST(MpcHcRemote_Drops) {
+	Remote remote;
+	MpcHcVariables::PlayerVariables variables;
+
+	// A kept connection the server drops is reopened once, unseen by the caller.
+	CHECK(GetVariables(variables));
+	remote.player.DropNext(1);
+	CHECK(GetVariables(variables));
+	CHECK_EQ(remote.player.GetCounters().connections, 2u);
+	CHECK_EQ(remote.player.GetCounters().drops, 1u);
+
+	// A command on a dropped connection is not sent again, as the player may have carried it out.
+	remote.player.DropNext(1);
+	CHECK(!SendCommand(MpcHcCommand::PLAY_PAUSE));
+	CHECK_EQ(remote.player.GetCounters().requests, 4u);
+	CHECK_EQ(remote.player.GetCounters().drops, 2u);
+	remote.ResetBreaker();
+	CHECK(Seek(1000));
+	CHECK_EQ(remote.player.GetCounters().commands, 1u);
+
+	// A new connection that is dropped is a failure, and the player counts as down for a while.
+	Disconnect();
+	remote.player.DropNext(1);
+	CHECK(!GetVariables(variables));
+	const auto requests = remote.player.GetCounters().requests;
+	CHECK(!GetVariables(variables));
+	CHECK_EQ(remote.player.GetCounters().requests, requests);
+	remote.ResetBreaker();
+	CHECK(GetVariables(variables));
+}
+
+TEST(MpcHcRemote_Polling) {
+	Remote remote;
+	remote.player.SetPlayer(2, 10000);
+	StartPolling(10);
+	CHECK(WaitUntil([&] { return remote.player.GetCounters().requests >= 3; }));
+	const auto requests = remote.player.GetCounters().requests;
+
+	// Answered from the poller's samples, extrapolated to now.
+	for (auto i = 0; i < 5; ++i) {
+		const auto expected = remote.player.GetPosition();
+		const auto position = GetCurrentPlayerTimestamp();
+		CHECK(std::abs(position - expected) < 50);
+	}
+	CHECK(remote.player.GetCounters().requests - requests < 5);
+	StopPolling();
+}
+
+TEST(MpcHcRemote_PollInterval) {
+	// The interval changes while the poller runs and other threads ask for the position.
+	Remote remote;
+	remote.player.SetPlayer(2, 0);
+	StartPolling(200);
+	std::atomic<bool> stop{ false };
+	std::thread reader([&] {
+		while (!stop)
+			GetCurrentPlayerTimestamp();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	const auto slowRequests = remote.player.GetCounters().requests;
+	StartPolling(2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	stop = true;
+	reader.join();
+	StopPolling();
+	CHECK(remote.player.GetCounters().requests - slowRequests >= 10);
+}
+
+TEST(MpcHcRemote_PausePolling) {
+	// Pausing does not wait for the poll in flight, and what that poll reads is not used.
+	Remote remote;
+	FakeMpcHc::Behavior behavior;
+	behavior.delay = std::chrono::milliseconds(300);
+	remote.player.SetBehavior(behavior);
+	remote.player.SetPlayer(1, 1000);
+	StartPolling(10);
+	CHECK(WaitUntil([&] { return remote.player.GetCounters().requests == 1; }));
+
+	const auto begin = std::chrono::steady_clock::now();
+	PausePolling();
+	CHECK(MillisecondsSince(begin) < 20);
+	remote.player.SetBehavior(FakeMpcHc::Behavior());
+	remote.player.SetPlayer(1, 2000);
+	std::this_thread::sleep_for(std::chrono::milliseconds(400));
+	CHECK_EQ(remote.player.GetCounters().requests, 1u);
+	CHECK_EQ(GetCurrentPlayerTimestamp(), 2000);
+
+	// The same poller goes on.
+	StartPolling(10);
+	CHECK(WaitUntil([&] { return remote.player.GetCounters().requests >= 5; }));
+	StopPolling();
+}
+
+TEST(MpcHcRemote_BackDated) {
+	// A key press handled 50 ms late still gets the position the player had when the key went down.
+	Remote remote;
+	for (const auto rate : { 1.0, 1.5 }) {
+		for (const auto polling : { false, true }) {
+			remote.player.SetPlayer(2, 60000, 5400000, rate);
+			if (polling)
+				StartPolling(20);
+			std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+			const auto pressed = std::chrono::steady_clock::now();
+			const auto expected = remote.player.GetPosition();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			const auto backDated = GetPlayerTimestampAt(pressed);
+			const auto late = GetCurrentPlayerTimestamp();
+			StopPolling();
+
+			CHECK(std::abs(backDated - expected) <= 3);
+			CHECK(late - expected >= static_cast<int64_t>(50 * rate) - 3);
+		}
+	}
+
+	// Paused, the time does not matter.
+	remote.player.SetPlayer(1, 60000);
+	CHECK_EQ(GetPlayerTimestampAt(std::chrono::steady_clock::now() - std::chrono::seconds(1)), 60000);
+}
+
+// Queues a seek to 1000 on a player that takes 100 ms to answer, and returns once the player has it, so that
+// whatever is queued next waits behind it.
+static void QueueBehindSlowSeek(Remote& remote) {
+	FakeMpcHc::Behavior behavior;
+	behavior.delay = std::chrono::milliseconds(100);
+	remote.player.SetBehavior(behavior);
+	remote.player.SetPlayer(1, 0);
+	const auto requests = remote.player.GetCounters().requests;
+	QueueSeek(1000);
+	CHECK(WaitUntil([&] { return remote.player.GetCounters().requests > requests; }));
+}
+
+TEST(MpcHcRemote_CommandQueue) {
+	{
+		// The last absolute seek wins.
+		Remote remote;
+		QueueBehindSlowSeek(remote);
+		QueueSeek(2000);
+		QueueSeek(3000);
+		QueueSeek(4000);
+		CHECK(WaitUntil([&] { return remote.player.GetCounters().commands == 2; }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		CHECK_EQ(remote.player.GetCounters().commands, 2u);
+		CHECK_EQ(remote.player.GetPosition(), 4000);
+		StopCommandQueue();
+	}
+	{
+		// Relative seeks add up, and start from where the seeks before them went.
+		Remote remote;
+		QueueBehindSlowSeek(remote);
+		QueueSeekBy(500);
+		QueueSeekBy(-200);
+		QueueSeekBy(1000);
+		CHECK(WaitUntil([&] { return remote.player.GetCounters().commands == 2; }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		CHECK_EQ(remote.player.GetCounters().commands, 2u);
+		CHECK_EQ(remote.player.GetPosition(), 2300);
+
+		// Onto a waiting absolute seek, they move it, not below 0.
+		QueueBehindSlowSeek(remote);
+		QueueSeek(5000);
+		QueueSeekBy(-6000);
+		QueueSeekBy(700);
+		CHECK(WaitUntil([&] { return remote.player.GetCounters().commands == 4; }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		CHECK_EQ(remote.player.GetCounters().commands, 4u);
+		CHECK_EQ(remote.player.GetPosition(), 700);
+		StopCommandQueue();
+	}
+	{
+		// A command is a barrier: the seeks before it are sent, and only those after it merge.
+		Remote remote;
+		QueueBehindSlowSeek(remote);
+		QueueSeek(2000);
+		QueueCommand(MpcHcCommand::PLAY_PAUSE);
+		QueueSeek(3000);
+		QueueSeek(4000);
+		CHECK(WaitUntil([&] { return remote.player.GetCounters().commands == 4; }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		CHECK_EQ(remote.player.GetCounters().commands, 4u);
+		CHECK_EQ(remote.player.GetState(), 2);
+		const auto position = remote.player.GetPosition();
+		CHECK(position >= 4000 && position < 4500);
+		StopCommandQueue();
+	}
+}
+
+TEST(MpcHcRemote_CommandQueue_Failed) {
+	std::atomic<int> failures{ 0 };
+	SetCommandFailedHandler([&] { ++failures; });
+	{
+		// Nothing listening.
+		unsigned port;
+		{
+			FakeMpcHc closed;
+			port = closed.GetPort();
+		}
+		SetWebServerPort(port);
+		QueueSeek(1000);
+		CHECK(WaitUntil([&] { return failures == 1; }));
+		QueueCommand(MpcHcCommand::PLAY_PAUSE);
+		CHECK(WaitUntil([&] { return failures == 2; }));
+		SetWebServerPort(0);
+	}
+	{
+		// Dropped on a command: the commands still waiting behind it are dropped too, and the handler is called once.
+		Remote remote;
+		QueueBehindSlowSeek(remote);
+		remote.player.DropNext(1);
+		QueueCommand(MpcHcCommand::PLAY_PAUSE);
+		QueueSeek(2000);
+		CHECK(WaitUntil([&] { return failures == 3; }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		CHECK_EQ(failures.load(), 3);
+		CHECK_EQ(remote.player.GetCounters().commands, 1u);
+		CHECK_EQ(remote.player.GetCounters().drops, 1u);
+		CHECK_EQ(remote.player.GetPosition(), 1000);
+		CHECK_EQ(remote.player.GetState(), 1);
+		StopCommandQueue();
+	}
+	SetCommandFailedHandler(nullptr);
+}
+
+// Fails, and then keeps failing at once without trying the player. Returns how long the first failure took, in ms.
+static double CheckPlayerDown() {
+	MpcHcVariables::PlayerVariables variables;
+	auto begin = std::chrono::steady_clock::now();
+	CHECK(!GetVariables(variables));
+	const auto failedMs = MillisecondsSince(begin);
+
+	begin = std::chrono::steady_clock::now();
+	CHECK(!GetVariables(variables));
+	CHECK(!SendCommand(MpcHcCommand::PLAY_PAUSE));
+	CHECK_EQ(GetPlayerState(), PlayerState::STOPPED);
+	CHECK_EQ(GetCurrentPlayerTimestamp(), -1);
+	CHECK(MillisecondsSince(begin) < 5);
+	return failedMs;
+}
+
+TEST(MpcHcRemote_PlayerDown) {
+	{
+		// Nothing listening: refused at once.
+		unsigned port;
+		{
+			FakeMpcHc closed;
+			port = closed.GetPort();
+		}
+		SetWebServerPort(port);
+		CHECK(CheckPlayerDown() < 50);
+		SetWebServerPort(0);
+	}
+	{
+		// SYNs dropped: the connect gives up after 200 ms, and is tried again only after a second.
+		Remote remote(FakeMpcHc::Listening::NEVER_ACCEPT);
+		const auto failedMs = CheckPlayerDown();
+		CHECK(failedMs >= 190 && failedMs < 400);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+		MpcHcVariables::PlayerVariables variables;
+		const auto begin = std::chrono::steady_clock::now();
+		CHECK(!GetVariables(variables));
+		CHECK(MillisecondsSince(begin) >= 190);
+		CHECK_EQ(remote.player.GetCounters().connections, 0u);
+	}
+	{
+		// Accepted but never answered: the receive gives up after 2 s, once, even on a kept connection.
+		Remote remote;
+		MpcHcVariables::PlayerVariables variables;
+		CHECK(GetVariables(variables));
+		FakeMpcHc::Behavior behavior;
+		behavior.answer = false;
+		remote.player.SetBehavior(behavior);
+		const auto failedMs = CheckPlayerDown();
+		CHECK(failedMs >= 1900 && failedMs < 2500);
+		CHECK_EQ(remote.player.GetCounters().requests, 2u);
+
+		remote.player.SetBehavior(FakeMpcHc::Behavior());
+		remote.ResetBreaker();
+		CHECK(GetVariables(variables));
+	}
+}
+
+namespace {
+	struct Latencies {
+		std::vector<double> samples; // ms
+		size_t failures = 0;
+	};
+
+	template<typename TFunction>
+	void Measure(Remote& remote, Latencies& latencies, TFunction&& call) {
+		const auto begin = std::chrono::steady_clock::now();
+		const auto result = call();
+		latencies.samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+		if (!result) {
+			++latencies.failures;
+			remote.ResetBreaker();
+		}
+	}
+
+	void Print(const char* name, Latencies& latencies) {
+		const auto p50 = Test::Percentile(latencies.samples, 0.5), p99 = Test::Percentile(latencies.samples, 0.99);
+		printf("    %-13s p50 %6.3f ms  p99 %6.3f ms  max %6.3f ms  %zu failed\n", name, p50, p99, latencies.samples.back(), latencies.failures);
+	}
+}
+
+BENCHMARK(MpcHcRemote_Latency) {
+	struct Scenario {
+		const char* name;
+		FakeMpcHc::Behavior behavior{};
+	};
+	Scenario scenarios[5] = {
+		{ "immediate" },
+		{ "no keep-alive" },
+		{ "1+0..2 ms" },
+		{ "1+0..2 ms, 2% dropped" },
+		{ "chunked, 64-byte pieces" },
+	};
+	scenarios[1].behavior.keepAlive = false;
+	scenarios[2].behavior.delay = scenarios[3].behavior.delay = std::chrono::milliseconds(1);
+	scenarios[2].behavior.jitter = scenarios[3].behavior.jitter = std::chrono::milliseconds(2);
+	scenarios[3].behavior.dropProbability = 0.02;
+	scenarios[4].behavior.chunked = true;
+	scenarios[4].behavior.pieceSize = 64;
+
+	const auto count = Test::IsQuick() ? 20 : 500;
+	for (const auto& scenario : scenarios) {
+		Remote remote;
+		remote.player.SetBehavior(scenario.behavior);
+		remote.player.SetPlayer(1, 0);
+
+		Latencies variables, commands, seeks;
+		for (auto i = 0; i < count; ++i) {
+			Measure(remote, variables, [] {
+				MpcHcVariables::PlayerVariables result;
+				return GetVariables(result, MpcHcVariables::FIELD_STATE | MpcHcVariables::FIELD_POSITION | MpcHcVariables::FIELD_DURATION | MpcHcVariables::FIELD_PLAYBACK_RATE);
+			});
+			Measure(remote, commands, [] { return SendCommand(MpcHcCommand::PLAY_PAUSE); });
+			Measure(remote, seeks, [i] { return Seek(i * 1000); });
+		}
+
+		const auto counters = remote.player.GetCounters();
+		printf("  %s: %zu connections, %zu requests, %zu dropped\n", scenario.name, counters.connections, counters.requests, counters.drops);
+		Print("variables", variables);
+		Print("play/pause", commands);
+		Print("seek", seeks);
+	}
+}
+
+BENCHMARK(MpcHcRemote_BackDated) {
+	// Key presses handled 0..50 ms late against a player 1..3 ms away: how far the inserted timecode is
+	// from where playback was at the key press, taken at the press and, as before, when handled.
+	Remote remote;
+	FakeMpcHc::Behavior behavior;
+	behavior.delay = std::chrono::milliseconds(1);
+	behavior.jitter = std::chrono::milliseconds(2);
+	remote.player.SetBehavior(behavior);
+	remote.player.SetPlayer(2, 0);
+
+	std::mt19937 random(1);
+	const auto count = Test::IsQuick() ? 10 : 200;
+	for (const auto polling : { false, true }) {
+		if (polling)
+			StartPolling(50);
+		std::vector<double> backDated, late;
+		for (auto i = 0; i < count; ++i) {
+			const auto pressed = std::chrono::steady_clock::now();
+			const auto expected = remote.player.GetPosition();
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::uniform_int_distribution<int>(0, 50)(random)));
+			backDated.push_back(static_cast<double>(std::abs(GetPlayerTimestampAt(pressed) - expected)));
+			late.push_back(static_cast<double>(std::abs(GetCurrentPlayerTimestamp() - expected)));
+		}
+		StopPolling();
+		printf("  %s: error p50 %.0f ms, p99 %.0f ms; taken when handled p50 %.0f ms, p99 %.0f ms\n", polling ? "polling every 50 ms" : "not polling",
+			Test::Percentile(backDated, 0.5), Test::Percentile(backDated, 0.99), Test::Percentile(late, 0.5), Test::Percentile(late, 0.99));
+	}
+}
+
+BENCHMARK(MpcHcRemote_SeekLag) {
+	// A seek forward key held down at 30 Hz: how long after each press the player is at or past where it asked for,
+	// queued as the plugin does, and sent from the pressing thread, where a slow player holds up the presses after it.
+	struct Scenario {
+		const char* name;
+		std::chrono::microseconds delay;
+		std::chrono::microseconds jitter;
+	};
+	const Scenario scenarios[] = {
+		{ "1+0..2 ms", std::chrono::milliseconds(1), std::chrono::milliseconds(2) },
+		{ "40+0..20 ms", std::chrono::milliseconds(40), std::chrono::milliseconds(20) },
+	};
+	const auto presses = Test::IsQuick() ? 15 : 150;
+	const auto period = std::chrono::microseconds(1000000 / 30);
+	for (const auto& scenario : scenarios) {
+		printf("  player %s:\n", scenario.name);
+		for (const auto queued : { true, false }) {
+			Remote remote;
+			FakeMpcHc::Behavior behavior;
+			behavior.delay = scenario.delay;
+			behavior.jitter = scenario.jitter;
+			remote.player.SetBehavior(behavior);
+			remote.player.SetPlayer(1, 0);
+
+			const auto begin = std::chrono::steady_clock::now();
+			std::vector<double> lags(presses);
+			std::atomic<int> reached{ 0 };
+			std::atomic<bool> stop{ false };
+			std::thread watcher([&] {
+				for (auto i = 0; i < presses && !stop;) {
+					const auto position = remote.player.GetPosition();
+					const auto now = std::chrono::steady_clock::now();
+					for (; i < presses && position >= (i + 1) * 1000; ++i)
+						lags[i] = std::chrono::duration<double, std::milli>(now - (begin + period * i)).count();
+					reached = i;
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+			});
+			for (auto i = 0; i < presses; ++i) {
+				std::this_thread::sleep_until(begin + period * i);
+				if (queued)
+					QueueSeekBy(1000);
+				else {
+					const auto time = GetCurrentPlayerTimestamp();
+					if (time != -1)
+						Seek(time + 1000);
+				}
+			}
+			WaitUntil([&] { return reached == presses; });
+			stop = true;
+			watcher.join();
+			StopCommandQueue();
+
+			lags.resize(reached);
+			if (lags.empty()) {
+				printf("    %-7s no press reached the player\n", queued ? "queued" : "direct");
+				continue;
+			}
+			printf("    %-7s lag p50 %6.1f ms  p99 %6.1f ms  max %6.1f ms  %zu commands for %d presses%s\n", queued ? "queued" : "direct",
+				Test::Percentile(lags, 0.5), Test::Percentile(lags, 0.99), *std::max_element(lags.begin(), lags.end()), remote.player.GetCounters().commands, presses,
+				reached == presses ? "" : " (some never reached)");
+		}
+	}
+}
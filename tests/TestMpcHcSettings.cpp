@@ -0,0 +1,150 @@
+#include "Test.h"
+#include "MpcHcSettings.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace {
+	// A directory in the temporary directory, removed with everything in it with the object.
+	class TempDirectory {
+		std::filesystem::path m_path;
+
+	public:
+		TempDirectory() {
+			m_path = std::filesystem::temp_directory_path() / ("NppSmiTests-" + std::to_string(std::random_device()()));
+			std::filesystem::create_directory(m_path);
+		}
+		~TempDirectory() {
+			std::error_code error;
+			std::filesystem::remove_all(m_path, error);
+		}
+
+		const std::filesystem::path& GetPath() const { return m_path; }
+
+		std::filesystem::path Write(const char* name, const std::string& content) const {
+			const auto path = m_path / name;
+			std::ofstream(path, std::ios::binary | std::ios::trunc).write(content.data(), static_cast<std::streamsize>(content.size()));
+			return path;
+		}
+	};
+
+	// Counts the times the file is read.
+	class CountingIniSettings : public MpcHcIniSettings {
+	protected:
+		MpcHcSettings Load() override {
+			++loads;
+			return MpcHcIniSettings::Load();
+		}
+
+	public:
+		size_t loads = 0;
+
+		using MpcHcIniSettings::MpcHcIniSettings;
+	};
+}
+
+// text as MPC-HC writes it: UTF-16LE with a byte order mark.
+static std::string ToUtf16(const std::u16string& text) {
+	std::string bytes = "\xFF\xFE";
+	for (const auto unit : text) {
+		bytes.push_back(static_cast<char>(unit & 0xFF));
+		bytes.push_back(static_cast<char>(unit >> 8));
+	}
+	return bytes;
+}
+
+static const char16_t INI[] =
+	u"[Settings]\r\n"
+	u"LastOpenDir=C:\\Videos\\자막\\\r\n"
+	u"enablewebserver = 1\r\n"
+	u"\tWebServerPort=13579 \r\n"
+	u"[Settings\\Other]\r\n"
+	u"WebServerPort=1\r\n";
+
+TEST(MpcHcIniSettings_Parse) {
+	TempDirectory directory;
+	const auto path = directory.Write("mpc-hc.ini", ToUtf16(INI));
+	auto settings = MpcHcIniSettings(path).Get();
+	CHECK(settings.webServerEnabled);
+	CHECK_EQ(settings.webServerPort, 13579u);
+	CHECK(settings.exePath.empty());
+
+	// The same in ASCII, with LF line ends; the executable is found next to the file, the 64-bit one first.
+	std::string ascii;
+	for (const auto unit : std::u16string(INI))
+		ascii.push_back(unit < 0x80 ? static_cast<char>(unit) : '?');
+	directory.Write("mpc-hc.ini", ascii);
+	directory.Write("mpc-hc.exe", "");
+	directory.Write("mpc-hc64.exe", "");
+	settings = MpcHcIniSettings(path).Get();
+	CHECK(settings.webServerEnabled);
+	CHECK_EQ(settings.webServerPort, 13579u);
+	CHECK(settings.exePath == directory.GetPath() / "mpc-hc64.exe");
+
+	// Settings elsewhere than in [Settings] do not count.
+	directory.Write("mpc-hc.ini", "EnableWebServer=1\n[Other]\nWebServerPort=80\n[settings]\nWebServerPort=8080\n");
+	settings = MpcHcIniSettings(path).Get();
+	CHECK(!settings.webServerEnabled);
+	CHECK_EQ(settings.webServerPort, 8080u);
+
+	// Without a file, the defaults.
+	settings = MpcHcIniSettings(directory.GetPath() / "missing.ini").Get();
+	CHECK(!settings.webServerEnabled);
+	CHECK_EQ(settings.webServerPort, 0u);
+	CHECK(settings.exePath.empty());
+}
+
+TEST(MpcHcIniSettings_Reload) {
+	TempDirectory directory;
+	const auto path = directory.Write("mpc-hc.ini", "[Settings]\r\nWebServerPort=13579\r\n");
+	CountingIniSettings settings(path);
+	for (auto i = 0; i < 100; ++i)
+		CHECK_EQ(settings.GetWebServerPort(), 13579u);
+	CHECK_EQ(settings.loads, 1u);
+
+	// A change is seen only once the second since the last check is up; the write time is moved on so that
+	// a coarse file system clock cannot hide it.
+	directory.Write("mpc-hc.ini", "[Settings]\r\nWebServerPort=24680\r\n");
+	std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(2));
+	CHECK_EQ(settings.GetWebServerPort(), 13579u);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	CHECK_EQ(settings.GetWebServerPort(), 24680u);
+	CHECK_EQ(settings.Get().webServerPort, 24680u);
+	CHECK_EQ(settings.loads, 2u);
+
+	// Checked again, but not changed, it is not read again.
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	CHECK_EQ(settings.GetWebServerPort(), 24680u);
+	CHECK_EQ(settings.loads, 2u);
+}
+
+BENCHMARK(MpcHcIniSettings_Get) {
+	// What every request to the player pays for the port: from the cache, and reading the file each time as before.
+	TempDirectory directory;
+	std::u16string ini = INI;
+	for (auto i = 0; i < 300; ++i)
+		ini += u"Recent File " + std::u16string(1, static_cast<char16_t>(u'0' + i % 10)) + u"=C:\\Videos\\자막\\episode.mkv\r\n";
+	const auto path = directory.Write("mpc-hc.ini", ToUtf16(ini));
+
+	const auto calls = Test::IsQuick() ? 10000 : 1000000;
+	MpcHcIniSettings settings(path);
+	size_t wrong = 0;
+	const auto cachedTime = Test::Time([&] {
+		for (auto i = 0; i < calls; ++i)
+			wrong += settings.GetWebServerPort() != 13579;
+	});
+	const auto getTime = Test::Time([&] {
+		for (auto i = 0; i < calls; ++i)
+			wrong += settings.Get().webServerPort != 13579;
+	});
+	const auto reads = Test::IsQuick() ? 100 : 10000;
+	const auto readTime = Test::Time([&] {
+		for (auto i = 0; i < reads; ++i)
+			wrong += MpcHcIniSettings(path).GetWebServerPort() != 13579;
+	});
+	CHECK_EQ(wrong, size_t(0));
+	printf("  %.1f KB file: GetWebServerPort %.1f ns, Get %.1f ns, reading the file %.1f us per call\n", ini.size() * 2 / 1e3,
+		cachedTime * 1e9 / calls, getTime * 1e9 / calls, readTime * 1e6 / reads);
+}
@@ -0,0 +1,271 @@
+#include "Test.h"
+#include "MpcHcVariables.h"
+#include <random>
+#include <regex>
+#include <string>
+
+using namespace MpcHcVariables;
+
+// What MPC-HC 1.9 writes, with the file name entity-encoded the way its web server does.
+static const char VARIABLES_HTML[] =
+	"<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Strict//EN\" \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-strict.dtd\">\r\n"
+	"<html xmlns=\"http://www.w3.org/1999/xhtml\" xml:lang=\"en\" lang=\"en\">\r\n"
+	"<head>\r\n"
+	"<meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\" />\r\n"
+	"<title>MPC-HC WebServer - Variables</title>\r\n"
+	"<link rel=\"stylesheet\" href=\"default.css\" />\r\n"
+	"</head>\r\n"
+	"<body class=\"page-variables\">\r\n"
+	"<p id=\"file\">&#xC790;&#xB9C9; Caf&eacute; &amp; Bar.mkv</p>\r\n"
+	"<p id=\"filepatharg\">C:%5cVideos%5cCaf%c3%a9.mkv</p>\r\n"
+	"<p id=\"filepath\">C:\\Videos\\&#xC790;&#xB9C9; Caf&eacute; &amp; Bar.mkv</p>\r\n"
+	"<p id=\"filedirarg\">C:%5cVideos</p>\r\n"
+	"<p id=\"filedir\">C:\\Videos</p>\r\n"
+	"<p id=\"state\">2</p>\r\n"
+	"<p id=\"statestring\">Playing</p>\r\n"
+	"<p id=\"position\">754321</p>\r\n"
+	"<p id=\"positionstring\">00:12:34</p>\r\n"
+	"<p id=\"duration\">5432100</p>\r\n"
+	"<p id=\"durationstring\">01:30:32</p>\r\n"
+	"<p id=\"volumelevel\">85</p>\r\n"
+	"<p id=\"muted\">1</p>\r\n"
+	"<p id=\"playbackrate\">1.25</p>\r\n"
+	"<p id=\"size\">1.2 GB</p>\r\n"
+	"<p id=\"reloadtime\">0</p>\r\n"
+	"<p id=\"version\">1.9.24.0</p>\r\n"
+	"</body>\r\n"
+	"</html>\r\n";
+
+static std::string Replace(std::string text, const std::string& from, const std::string& to) {
+	const auto pos = text.find(from);
+	CHECK(pos != std::string::npos);
+	if (pos != std::string::npos)
+		text.replace(pos, from.size(), to);
+	return text;
+}
+
+TEST(MpcHcVariables_Parse_Full) {
+	PlayerVariables variables;
+	CHECK(Parse(VARIABLES_HTML, variables));
+	CHECK_EQ(variables.found, static_cast<uint32_t>(ALL_FIELDS));
+	CHECK_EQ(variables.file, std::string("\xEC\x9E\x90\xEB\xA7\x89 Caf\xC3\xA9 & Bar.mkv"));
+	CHECK_EQ(variables.filePath, std::string("C:\\Videos\\\xEC\x9E\x90\xEB\xA7\x89 Caf\xC3\xA9 & Bar.mkv"));
+	CHECK_EQ(variables.fileDir, std::string("C:\\Videos"));
+	CHECK_EQ(variables.version, std::string("1.9.24.0"));
+	CHECK_EQ(variables.state, 2);
+	CHECK_EQ(variables.position, 754321);
+	CHECK_EQ(variables.duration, 5432100);
+	CHECK_EQ(variables.volumeLevel, 85);
+	CHECK_EQ(variables.muted, true);
+	CHECK_EQ(variables.playbackRate, 1.25);
+}
+
+TEST(MpcHcVariables_Parse_Required) {
+	// Stops at the position, so nothing after it is read.
+	PlayerVariables variables;
+	CHECK(Parse(VARIABLES_HTML, variables, FIELD_STATE | FIELD_POSITION));
+	CHECK_EQ(variables.found & (FIELD_STATE | FIELD_POSITION), static_cast<uint32_t>(FIELD_STATE | FIELD_POSITION));
+	CHECK_EQ(variables.found & (FIELD_DURATION | FIELD_VERSION), 0u);
+	CHECK_EQ(variables.duration, -1);
+
+	// Older versions have no playbackrate; the rest is still read and the default kept.
+	const auto old = Replace(VARIABLES_HTML, "<p id=\"playbackrate\">1.25</p>\r\n", "");
+	CHECK(!Parse(old, variables));
+	CHECK_EQ(variables.found, static_cast<uint32_t>(ALL_FIELDS & ~FIELD_PLAYBACK_RATE));
+	CHECK_EQ(variables.playbackRate, 1.0);
+	CHECK(Parse(old, variables, FIELD_POSITION | FIELD_DURATION | FIELD_VERSION));
+}
+
+TEST(MpcHcVariables_Parse_Values) {
+	PlayerVariables variables;
+
+	// Either decimal separator, whatever the locale.
+	CHECK(Parse(Replace(VARIABLES_HTML, ">1.25<", ">0,5<"), variables, FIELD_PLAYBACK_RATE));
+	CHECK_EQ(variables.playbackRate, 0.5);
+	CHECK(Parse(Replace(VARIABLES_HTML, ">1.25<", ">2<"), variables, FIELD_PLAYBACK_RATE));
+	CHECK_EQ(variables.playbackRate, 2.0);
+
+	// Stopped players report -1 for the state on some versions.
+	CHECK(Parse(Replace(VARIABLES_HTML, "\"state\">2<", "\"state\">-1<"), variables, FIELD_STATE));
+	CHECK_EQ(variables.state, -1);
+
+	// Any number of digits, as long as the value fits.
+	CHECK(Parse(Replace(VARIABLES_HTML, ">754321<", ">9223372036854775807<"), variables, FIELD_POSITION));
+	CHECK_EQ(variables.position, INT64_MAX);
+	CHECK(Parse(Replace(VARIABLES_HTML, ">754321<", ">-9223372036854775807<"), variables, FIELD_POSITION));
+	CHECK_EQ(variables.position, -INT64_MAX);
+	CHECK(Parse(Replace(VARIABLES_HTML, ">754321<", ">00000000000000000000754321<"), variables, FIELD_POSITION));
+	CHECK_EQ(variables.position, 754321);
+
+	// Malformed values are left out of found and keep their defaults.
+	const char* const malformed[][2] = {
+		{ ">754321<", "><" },
+		{ ">754321<", ">75x<" },
+		{ ">754321<", ">-<" },
+		{ ">754321<", "> 754321<" },
+		{ ">754321<", ">9223372036854775808<" },
+		{ ">754321<", ">-9223372036854775809<" },
+		{ ">754321<", ">99999999999999999999999<" },
+	};
+	for (const auto& replacement : malformed) {
+		CHECK(!Parse(Replace(VARIABLES_HTML, replacement[0], replacement[1]), variables));
+		CHECK_EQ(variables.found & FIELD_POSITION, 0u);
+		CHECK_EQ(variables.position, -1);
+	}
+	CHECK(!Parse(Replace(VARIABLES_HTML, ">1.25<", ">1.2.5<"), variables));
+	CHECK_EQ(variables.found & FIELD_PLAYBACK_RATE, 0u);
+	CHECK(!Parse(Replace(VARIABLES_HTML, ">1.25<", ">.<"), variables));
+	CHECK_EQ(variables.found & FIELD_PLAYBACK_RATE, 0u);
+
+	// Unknown references are kept as they are.
+	CHECK(Parse(Replace(VARIABLES_HTML, "C:\\Videos</p>", "A&bogus;&#;B</p>"), variables, FIELD_FILE_DIR));
+	CHECK_EQ(variables.fileDir, std::string("A&bogus;&#;B"));
+
+	// Elements with other attributes, or ids that only start like a known one, are skipped.
+	CHECK(Parse("<p id=\"position\" class=\"x\">1</p><p id=\"positionstring\">2</p><p id=\"position\">3</p>", variables, FIELD_POSITION));
+	CHECK_EQ(variables.position, 3);
+
+	// A previous result does not leak into the next one.
+	CHECK(!Parse("", variables));
+	CHECK_EQ(variables.found, 0u);
+	CHECK_EQ(variables.file, std::string());
+}
+
+TEST(MpcHcVariables_Parse_Truncated) {
+	// A response read in pieces: every prefix parses what it has completely, and nothing more.
+	const std::string html = VARIABLES_HTML;
+	const auto full = html.find("754321</p>") + 10;
+	for (size_t length = 0; length <= html.size(); ++length) {
+		PlayerVariables variables;
+		const auto found = Parse(std::string_view(html).substr(0, length), variables, FIELD_STATE | FIELD_POSITION);
+		CHECK_EQ(found, length >= full);
+		if (found)
+			CHECK_EQ(variables.position, 754321);
+		else
+			CHECK_EQ(variables.found & FIELD_POSITION, 0u);
+	}
+}
+
+static void CheckSame(const PlayerVariables& actual, const PlayerVariables& expected) {
+	CHECK_EQ(actual.found, expected.found);
+	CHECK_EQ(actual.file, expected.file);
+	CHECK_EQ(actual.filePath, expected.filePath);
+	CHECK_EQ(actual.fileDir, expected.fileDir);
+	CHECK_EQ(actual.version, expected.version);
+	CHECK_EQ(actual.state, expected.state);
+	CHECK_EQ(actual.position, expected.position);
+	CHECK_EQ(actual.duration, expected.duration);
+	CHECK_EQ(actual.volumeLevel, expected.volumeLevel);
+	CHECK_EQ(actual.muted, expected.muted);
+	CHECK_EQ(actual.playbackRate, expected.playbackRate);
+}
+
+TEST(MpcHcVariables_Parser_Pieces) {
+	// However the page is cut, the pieces give what the whole page does.
+	const std::string pages[] = {
+		VARIABLES_HTML,
+		Replace(VARIABLES_HTML, "<p id=\"state\">", "<p id=\"state\" class=\"x\"><p id=\"state\">"),
+		"<p id=\"position\">12</p><p id=\"position<p id=\"duration\">34</p>",
+	};
+	const uint32_t requireds[] = { ALL_FIELDS, FIELD_STATE | FIELD_POSITION, FIELD_VERSION };
+	std::mt19937 random(1);
+	for (const auto& page : pages) {
+		for (const auto required : requireds) {
+			PlayerVariables expected;
+			const auto expectedComplete = Parse(page, expected, required);
+			for (size_t pieceSize = 1; pieceSize <= page.size() + 1; pieceSize += pieceSize < 16 ? 1 : 13) {
+				for (auto randomSizes : { false, true }) {
+					PlayerVariables variables;
+					Parser parser(variables, required);
+					auto complete = false;
+					for (size_t i = 0; i < page.size() && !complete;) {
+						const auto size = randomSizes ? std::uniform_int_distribution<size_t>(0, 2 * pieceSize)(random) : pieceSize;
+						complete = parser.Append(std::string_view(page).substr(i, size));
+						i += size;
+					}
+					CHECK_EQ(complete, expectedComplete);
+					CHECK_EQ(parser.Append("<p id=\"muted\">1</p>"), expectedComplete);
+					if (expectedComplete)
+						CheckSame(variables, expected);
+				}
+			}
+		}
+	}
+}
+
+BENCHMARK(MpcHcVariables_Parse) {
+	// The two regexes MpcHcRemote used, which read only the state and position.
+	static const std::regex POSITION_MATCHER("<p id=\"position\">([0-9]+)</p>");
+	static const std::regex STATE_MATCHER("<p id=\"state\">(-?[0-9]+)</p>");
+
+	const std::string html = VARIABLES_HTML;
+	const auto count = Test::IsQuick() ? 1000 : 100000;
+
+	int64_t regexSum = 0, sum = 0, allSum = 0;
+	const auto regexTime = Test::Time([&] {
+		regexSum = 0;
+		std::smatch m;
+		for (auto i = 0; i < count; ++i) {
+			if (std::regex_search(html, m, POSITION_MATCHER))
+				regexSum += strtoll(m[1].str().c_str(), nullptr, 10);
+			if (std::regex_search(html, m, STATE_MATCHER))
+				regexSum += strtol(m[1].str().c_str(), nullptr, 10);
+		}
+	});
+	const auto time = Test::Time([&] {
+		sum = 0;
+		PlayerVariables variables;
+		for (auto i = 0; i < count; ++i) {
+			Parse(html, variables, FIELD_STATE | FIELD_POSITION | FIELD_DURATION | FIELD_PLAYBACK_RATE);
+			sum += variables.position + variables.state;
+		}
+	});
+	const auto allTime = Test::Time([&] {
+		allSum = 0;
+		PlayerVariables variables;
+		for (auto i = 0; i < count; ++i) {
+			Parse(html, variables);
+			allSum += variables.position + variables.state;
+		}
+	});
+	CHECK_EQ(sum, regexSum);
+	CHECK_EQ(allSum, regexSum);
+
+	printf("  %zu-byte page: regexes %.2f us, sample fields %.2f us (%.0fx), all fields %.2f us\n",
+		html.size(), regexTime / count * 1e6, time / count * 1e6, regexTime / time, allTime / count * 1e6);
+}
+
+BENCHMARK(MpcHcVariables_Parser) {
+	// The page as it comes off the connection, against parsing the whole page received so far after every piece.
+	const std::string html = VARIABLES_HTML;
+	const auto count = Test::IsQuick() ? 100 : 10000;
+	for (const size_t pieceSize : { 16, 64, 1460 }) {
+		int64_t sum = 0, rescanSum = 0;
+		const auto rescanTime = Test::Time([&] {
+			rescanSum = 0;
+			for (auto i = 0; i < count; ++i) {
+				PlayerVariables variables;
+				std::string page;
+				for (size_t j = 0; j < html.size(); j += pieceSize) {
+					page.append(html, j, pieceSize);
+					if (Parse(page, variables))
+						break;
+				}
+				rescanSum += variables.position;
+			}
+		});
+		const auto time = Test::Time([&] {
+			sum = 0;
+			for (auto i = 0; i < count; ++i) {
+				PlayerVariables variables;
+				Parser parser(variables);
+				for (size_t j = 0; j < html.size() && !parser.Append(std::string_view(html).substr(j, pieceSize)); j += pieceSize) {
+				}
+				sum += variables.position;
+			}
+		});
+		CHECK_EQ(sum, rescanSum);
+		printf("  %zu-byte pieces: parsing all received %.2f us per page, Parser %.2f us (%.1fx)\n",
+			pieceSize, rescanTime / count * 1e6, time / count * 1e6, rescanTime / time);
+	}
+}
@@ -0,0 +1,206 @@
+#include "Test.h"
+#include "MpvBackend.h"
+#include "nlohmann/json.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+	// Answers mpv's JSON IPC on a Unix domain socket, one connection at a time: observed properties are
+	// sent after observeDelay, and pause and seek commands change them the way mpv does.
+	class FakeMpv {
+		std::filesystem::path m_path;
+		int m_listener = -1;
+		std::thread m_server;
+
+		std::mutex m_mutex;
+		std::condition_variable m_stopped;
+		bool m_stopping = false;
+		int m_connection = -1;
+		std::vector<nlohmann::json> m_commands;
+		std::map<std::string, int> m_observed; // property name to observation id
+		double m_timePos = 12.5;
+		bool m_paused = true;
+
+		// Expects m_mutex to be held.
+		void Notify(const std::string& name, const nlohmann::json& data) {
+			const auto observed = m_observed.find(name);
+			if (observed == m_observed.end())
+				return;
+			const auto line = nlohmann::json{ { "event", "property-change" }, { "id", observed->second }, { "name", name }, { "data", data } }.dump() + "\n";
+			send(m_connection, line.data(), line.size(), MSG_NOSIGNAL);
+		}
+
+		void Serve(const int connection) {
+			std::string pending;
+			char buffer[4096];
+			ssize_t read;
+			while ((read = recv(connection, buffer, sizeof buffer, 0)) > 0) {
+				pending.append(buffer, static_cast<size_t>(read));
+				for (size_t lineEnd; (lineEnd = pending.find('\n')) != std::string::npos; pending.erase(0, lineEnd + 1)) {
+					const auto command = nlohmann::json::parse(pending.substr(0, lineEnd))["command"];
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_commands.push_back(command);
+					const auto name = command[0].get<std::string>();
+					if (name == "observe_property") {
+						if (m_stopped.wait_for(lock, observeDelay, [this] { return m_stopping; }) || !answerObservations)
+							continue;
+						const auto property = command[2].get<std::string>();
+						m_observed[property] = command[1].get<int>();
+						Notify(property, property == "time-pos" ? nlohmann::json(m_timePos) : property == "pause" ? nlohmann::json(m_paused) : nlohmann::json(1.0));
+					} else if (name == "cycle") {
+						m_paused = !m_paused;
+						Notify("pause", m_paused);
+					} else if (name == "seek") {
+						m_timePos = command[1].get<double>();
+						Notify("time-pos", m_timePos);
+					}
+				}
+			}
+		}
+
+	public:
+		std::chrono::milliseconds observeDelay{ 0 };
+		bool answerObservations = true;
+
+		FakeMpv() {
+			m_path = std::filesystem::temp_directory_path() / ("NppSmiTests-" + std::to_string(std::random_device()()) + ".mpv");
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			strcpy(address.sun_path, m_path.c_str());
+			m_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+			bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof address);
+			listen(m_listener, 4);
+			m_server = std::thread([this] {
+				int connection;
+				while ((connection = accept(m_listener, nullptr, nullptr)) != -1) {
+					{
+						std::lock_guard<std::mutex> lock(m_mutex);
+						m_connection = connection;
+						m_observed.clear();
+					}
+					Serve(connection);
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_connection = -1;
+					close(connection);
+				}
+			});
+		}
+
+		~FakeMpv() {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+				if (m_connection != -1)
+					shutdown(m_connection, SHUT_RDWR);
+			}
+			m_stopped.notify_all();
+			shutdown(m_listener, SHUT_RDWR);
+			m_server.join();
+			close(m_listener);
+			std::error_code error;
+			std::filesystem::remove(m_path, error);
+		}
+
+		const std::filesystem::path& GetPath() const { return m_path; }
+
+		std::vector<nlohmann::json> GetCommands() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_commands;
+		}
+	};
+}
+
+static double MillisecondsSince(const std::chrono::steady_clock::time_point begin) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template<typename TPredicate>
+static bool WaitUntil(TPredicate&& predicate) {
+	for (auto i = 0; i < 200; ++i) {
+		if (predicate())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return false;
+}
+
+TEST(MpvBackend_Connect) {
+	// SetActive connects in the background; a position query waits for mpv's first answer, and only for that.
+	FakeMpv mpv;
+	mpv.observeDelay = std::chrono::milliseconds(100);
+	MpvBackend backend(mpv.GetPath(), "mpv");
+	auto begin = std::chrono::steady_clock::now();
+	backend.SetActive(true);
+	backend.SetActive(true);
+	CHECK(MillisecondsSince(begin) < 20);
+
+	begin = std::chrono::steady_clock::now();
+	CHECK_EQ(backend.GetState(), PlayerBackend::State::PAUSED);
+	CHECK(MillisecondsSince(begin) < 450);
+	CHECK_EQ(backend.GetPosition(), 12500);
+
+	// Each observation is asked for once, on one connection.
+	CHECK(WaitUntil([&] { return mpv.GetCommands().size() == 3; }));
+	CHECK_EQ(mpv.GetCommands()[0][2].get<std::string>(), std::string("time-pos"));
+	backend.Shutdown();
+}
+
+TEST(MpvBackend_Commands) {
+	FakeMpv mpv;
+	MpvBackend backend(mpv.GetPath(), "mpv");
+	CHECK_EQ(backend.GetState(), PlayerBackend::State::PAUSED);
+
+	backend.PlayPause();
+	CHECK(WaitUntil([&] { return backend.GetState() == PlayerBackend::State::PLAYING; }));
+	backend.Seek(61500);
+	CHECK(WaitUntil([&] { return backend.GetPosition() >= 61500; }));
+	CHECK(backend.GetPosition() < 61500 + 1000);
+
+	const auto commands = mpv.GetCommands();
+	CHECK_EQ(commands.back().dump(), std::string("[\"seek\",61.5,\"absolute+exact\"]"));
+	CHECK_EQ(commands[commands.size() - 2].dump(), std::string("[\"cycle\",\"pause\"]"));
+	backend.Shutdown();
+}
+
+TEST(MpvBackend_NoAnswer) {
+	// mpv there but silent: a query gives up after a bounded wait, and commands are still sent without one.
+	FakeMpv mpv;
+	mpv.answerObservations = false;
+	MpvBackend backend(mpv.GetPath(), "mpv");
+	backend.SetActive(true);
+	auto begin = std::chrono::steady_clock::now();
+	CHECK_EQ(backend.GetPosition(), -1);
+	const auto waitedMs = MillisecondsSince(begin);
+	CHECK(waitedMs >= 400 && waitedMs < 700);
+
+	begin = std::chrono::steady_clock::now();
+	backend.PlayPause();
+	CHECK(MillisecondsSince(begin) < 20);
+	CHECK(WaitUntil([&] { return mpv.GetCommands().size() == 4; }));
+	backend.Shutdown();
+}
+
+TEST(MpvBackend_NotRunning) {
+	const auto path = std::filesystem::temp_directory_path() / "NppSmiTests-missing.mpv";
+	MpvBackend backend(path, "mpv");
+	std::atomic<int> failures{ 0 };
+	backend.SetFailureHandler([&] { ++failures; });
+
+	const auto begin = std::chrono::steady_clock::now();
+	backend.SetActive(true);
+	CHECK_EQ(backend.GetPosition(), -1);
+	CHECK_EQ(backend.GetState(), PlayerBackend::State::STOPPED);
+	backend.PlayPause();
+	CHECK(MillisecondsSince(begin) < 20);
+	CHECK_EQ(failures.load(), 1);
+	backend.Shutdown();
+}
@@ -0,0 +1,136 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SamiDocument.h"
+#include <climits>
+#include <sys/resource.h>
+
+static const char* const DOCUMENT =
+	"<SAMI><HEAD><STYLE TYPE=\"text/css\"><!--\r\n"
+	"P { margin-left:8pt; }\r\n"
+	".KRCC { Name:Korean; lang:ko-KR; SAMIType:CC; }\r\n"
+	".ENCC {Name: English ;lang:en-US}\r\n"
+	"--></STYLE></HEAD><BODY>\r\n"
+	"<SYNC Start=1000><P Class=KRCC>  first  <P Class=ENCC>second</P>ignored\r\n"
+	"<SYNC Start=2000 End=2500><P Class=krcc>&nbsp;\r\n"
+	"<SYNC Start=3000>no paragraph\r\n"
+	"<SYNC Start=4000><P Class=JPCC>undeclared\r\n"
+	"<SYNC Start=5000 End=x>\r\n"
+	"<SYNC Start=6000 End=99999999999999999999999>\r\n"
+	"</BODY>\r\n<SYNC Start=7000>after the body";
+
+TEST(SamiDocument_Parse) {
+	SamiDocument document;
+	document.Parse(DOCUMENT);
+
+	const auto& classes = document.GetClasses();
+	CHECK_EQ(classes.size(), 3u);
+	if (classes.size() != 3)
+		return;
+	CHECK_EQ(classes[0].name, "KRCC");
+	CHECK_EQ(classes[0].displayName, "Korean");
+	CHECK_EQ(classes[0].lang, "ko-KR");
+	CHECK_EQ(classes[0].samiType, "CC");
+	CHECK(classes[0].isDeclared);
+	CHECK_EQ(classes[1].displayName, "English");
+	CHECK_EQ(classes[1].lang, "en-US");
+	CHECK_EQ(classes[2].name, "JPCC");
+	CHECK(!classes[2].isDeclared);
+	CHECK_EQ(document.FindClass("encc"), 1u);
+	CHECK_EQ(document.FindClass("FRCC"), SamiDocument::NO_CLASS);
+
+	CHECK_EQ(document.GetSyncCount(), 6u);
+	std::vector<const SamiDocument::Sync*> syncs;
+	for (auto sync = document.GetFirstSync(); sync != nullptr; sync = sync->next)
+		syncs.push_back(sync);
+	CHECK_EQ(syncs.size(), 6u);
+	if (syncs.size() != 6)
+		return;
+
+	auto paragraph = syncs[0]->paragraphs;
+	CHECK(paragraph != nullptr && paragraph->classId == 0 && paragraph->text == "first");
+	paragraph = paragraph != nullptr ? paragraph->next : nullptr;
+	CHECK(paragraph != nullptr && paragraph->classId == 1 && paragraph->text == "second" && paragraph->next == nullptr);
+	CHECK_EQ(syncs[0]->end, SamiDocument::NO_TIME);
+
+	CHECK_EQ(syncs[1]->start, 2000);
+	CHECK_EQ(syncs[1]->end, 2500);
+	CHECK(syncs[1]->paragraphs != nullptr && syncs[1]->paragraphs->classId == 0 && syncs[1]->paragraphs->text == "&nbsp;");
+
+	CHECK(syncs[2]->paragraphs != nullptr && syncs[2]->paragraphs->classId == SamiDocument::NO_CLASS && syncs[2]->paragraphs->text == "no paragraph");
+	CHECK(syncs[3]->paragraphs != nullptr && syncs[3]->paragraphs->classId == 2);
+	CHECK_EQ(syncs[4]->end, SamiDocument::NO_TIME);
+	CHECK(syncs[4]->paragraphs == nullptr);
+	// saturates like Start
+	CHECK_EQ(syncs[5]->end, LLONG_MAX);
+}
+
+TEST(SamiDocument_Reparse) {
+	SamiDocument document;
+	document.Parse(DOCUMENT);
+	document.Parse("<SYNC Start=1><P Class=ENCC>x");
+	CHECK_EQ(document.GetSyncCount(), 1u);
+	CHECK_EQ(document.GetClasses().size(), 1u);
+	CHECK_EQ(document.FindClass("KRCC"), SamiDocument::NO_CLASS);
+	document.Parse("");
+	CHECK_EQ(document.GetSyncCount(), 0u);
+	CHECK(document.GetFirstSync() == nullptr);
+}
+
+TEST(SamiDocument_Corpus) {
+	const auto text = Corpus::MakeSmi(1000);
+	SamiDocument document;
+	document.Parse(text);
+	CHECK_EQ(document.GetSyncCount(), 2000u);
+	CHECK_EQ(document.GetClasses().size(), 2u);
+	size_t paragraphs = 0;
+	for (auto sync = document.GetFirstSync(); sync != nullptr; sync = sync->next) {
+		for (auto paragraph = sync->paragraphs; paragraph != nullptr; paragraph = paragraph->next) {
+			CHECK_EQ(paragraph->classId, 0u);
+			++paragraphs;
+		}
+	}
+	CHECK_EQ(paragraphs, 2000u);
+}
+
+TEST(MonotonicArena_Allocate) {
+	MonotonicArena arena(64);
+	const auto a = arena.New<int64_t>(1);
+	const auto b = arena.New<char>('x');
+	const auto c = arena.New<int64_t>(2);
+	CHECK_EQ(*a, 1);
+	CHECK_EQ(*b, 'x');
+	CHECK_EQ(*c, 2);
+	CHECK_EQ(reinterpret_cast<uintptr_t>(c) % alignof(int64_t), 0u);
+	// larger than a block
+	const auto big = static_cast<char*>(arena.Allocate(1000, 1));
+	big[999] = 1;
+	CHECK(arena.GetBlockCount() >= 2);
+	CHECK_EQ(arena.CopyString("copied"), "copied");
+	arena.Release();
+	CHECK_EQ(arena.GetBlockCount(), 0u);
+}
+
+// Peak resident memory of the process so far, in MB.
+static double PeakRssMb() {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+BENCHMARK(SamiDocument_Parse) {
+	std::vector<std::pair<std::string, std::string>> documents;
+	documents.emplace_back("generated", Corpus::MakeSmi(Test::IsQuick() ? 2000 : 300000));
+	for (const auto& path : Test::CorpusFiles())
+		documents.emplace_back(path, Corpus::ReadFile(path));
+
+	// The peak only grows, so what a parse adds shows only where it needs more than anything before it did.
+	for (const auto& document : documents) {
+		SamiDocument parsed;
+		const auto peakBefore = PeakRssMb();
+		const auto seconds = Test::Time([&] { parsed.Parse(document.second); });
+		const auto peak = PeakRssMb();
+		printf("  %s, %.1f MB: %zu Syncs in %.1f ms, %.0f MB/s, peak RSS %.1f MB (+%.1f MB), %zu arena blocks\n", document.first.c_str(),
+			document.second.size() / 1e6, parsed.GetSyncCount(), seconds * 1e3, document.second.size() / seconds / 1e6, peak, peak - peakBefore,
+			parsed.GetArena().GetBlockCount());
+	}
+}
@@ -0,0 +1,64 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SmiLint.h"
+#include "SmiTimeline.h"
+
+static std::vector<uint32_t> CheckEach(const std::string& text, const SmiLint::Options& options = SmiLint::Options()) {
+	SmiTimeline timeline;
+	timeline.Build(text);
+	std::vector<uint32_t> issues;
+	for (size_t i = 0; i < timeline.Size(); ++i)
+		issues.push_back(SmiLint::Check(timeline, i, options));
+	return issues;
+}
+
+TEST(SmiLint_Check) {
+	using namespace SmiLint;
+	const auto issues = CheckEach(
+		"<SAMI><BODY>\r\n"
+		"<SYNC Start=1000><P>fine\r\n"
+		"<SYNC Start=3000><P>together\r\n"
+		"<SYNC Start=3000><P>out of order next\r\n"
+		"<SYNC Start=2500><P>out of order\r\n"
+		"<SYNC Start=4000><P>short\r\n"
+		"<SYNC Start=4050 End=6000><P>overlaps\r\n"
+		"<SYNC Start=5000 End=5020><P>ends too soon\r\n"
+		"<SYNC Start=7000 End=7000><P>empty\r\n"
+		"<SYNC Start=8000 End=9000><P>last\r\n"
+		"</BODY></SAMI>\r\n");
+	CHECK((issues == std::vector<uint32_t>{ 0, ZERO_DURATION, 0, OUT_OF_ORDER, SHORT_DURATION, OVERLAP, SHORT_DURATION, ENDS_BEFORE_START, 0 }));
+
+	// An End before the next Sync is what counts for the duration, and a last Sync is only checked if it has one.
+	SmiLint::Options options;
+	options.minDuration = 1500;
+	CHECK((CheckEach("<SYNC Start=0 End=1000>a<SYNC Start=5000>b<SYNC Start=6000 End=7000>c<SYNC Start=9000>d", options)
+		== std::vector<uint32_t>{ SHORT_DURATION, SHORT_DURATION, SHORT_DURATION, 0 }));
+	CHECK(CheckAll(SmiTimeline(), options).empty());
+}
+
+TEST(SmiLint_CheckAll_Corpus) {
+	// Generated documents are in order, with captions well over the minimum; each blank Sync ends its caption.
+	SmiTimeline timeline;
+	timeline.Build(Corpus::MakeSmi(500));
+	CHECK(SmiLint::CheckAll(timeline, SmiLint::Options()).empty());
+
+	std::string text = Corpus::MakeSmi(20);
+	const auto second = text.find("<SYNC", text.find("<SYNC") + 1);
+	text.insert(text.find('>', second), " End=99999999");
+	timeline.Build(text);
+	const auto findings = SmiLint::CheckAll(timeline, SmiLint::Options());
+	CHECK_EQ(findings.size(), size_t(1));
+	if (!findings.empty()) {
+		CHECK_EQ(findings[0].index, size_t(1));
+		CHECK_EQ(findings[0].issues, uint32_t(SmiLint::OVERLAP));
+	}
+}
+
+BENCHMARK(SmiLint_CheckAll) {
+	const auto text = Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000);
+	SmiTimeline timeline;
+	const auto buildTime = Test::Time([&] { timeline.Build(text, 1); });
+	std::vector<SmiLint::Finding> findings;
+	const auto checkTime = Test::Time([&] { findings = SmiLint::CheckAll(timeline, SmiLint::Options()); });
+	printf("  %zu Syncs: Build %.2f ms, CheckAll %.2f ms, %zu findings\n", timeline.Size(), buildTime * 1e3, checkTime * 1e3, findings.size());
+}
@@ -0,0 +1,291 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SmiParser.h"
+#include <climits>
+#include <cstdlib>
+#include <random>
+#include <regex>
+
+// The regex FindSyncTag replaced, as the plugin had it.
+static const std::regex SYNC_MATCHER(R"(<sync(?=\s)[^<>]*\s)" R"(start=(['"]?)(\d+)\1(?=\s|>)[^<>]*>(?:<P>)?)", std::regex_constants::icase);
+
+static bool EndsWithParagraph(const std::string& match) {
+	return match.size() >= 3 && match[match.size() - 3] == '<' && (match[match.size() - 2] | 0x20) == 'p' && match.back() == '>';
+}
+
+// Walks every tag of text with both, the way the callers do, and compares what they found.
+static void CheckSameAsRegex(const std::string& text) {
+	size_t from = 0;
+	while (true) {
+		std::smatch match;
+		const auto regexFound = std::regex_search(text.begin() + static_cast<ptrdiff_t>(from), text.end(), match, SYNC_MATCHER);
+		SmiParser::SyncTag tag;
+		const auto found = SmiParser::FindSyncTag(text, from, tag);
+		CHECK_EQ(found, regexFound);
+		if (!found || !regexFound) {
+			if (found != regexFound)
+				printf("  in: %s\n", text.c_str());
+			return;
+		}
+
+		const auto offset = from + static_cast<size_t>(match.position(0));
+		const auto whole = match.str(0);
+		CHECK_EQ(tag.offset, offset);
+		CHECK_EQ(tag.length, whole.size());
+		CHECK_EQ(tag.start, strtoll(match.str(2).c_str(), nullptr, 10));
+		CHECK_EQ(tag.valueOffset, from + static_cast<size_t>(match.position(2)));
+		CHECK_EQ(tag.valueLength, static_cast<size_t>(match.length(2)));
+		if (EndsWithParagraph(whole)) {
+			CHECK_EQ(tag.paragraphOffset, offset + whole.size() - 3);
+			CHECK_EQ(tag.paragraphLength, 3u);
+		} else
+			CHECK_EQ(tag.paragraphOffset, std::string::npos);
+		if (tag.offset != offset || tag.length != whole.size()) {
+			printf("  in: %s\n", text.c_str());
+			return;
+		}
+		from = tag.offset + tag.length;
+	}
+}
+
+TEST(SmiParser_FindSyncTag_Cases) {
+	const char* const cases[] = {
+		"<SYNC Start=1000><P Class=KRCC>text",
+		"<sync start=1000>",
+		"<Sync Start='1000'><p>",
+		"<SYNC Start=\"1000\" End=\"2000\"><P>",
+		"<SYNC\tStart=1000\r\n><P>",
+		"<SYNC\r\nStart=1000>",
+		"<SYNC Start=\"1000'>",
+		"<SYNC Start='1000\">",
+		"<SYNC Start=\"1000>",
+		"<SYNC Start=1000\">",
+		"<SYNC Start=>",
+		"<SYNC Start=abc>",
+		"<SYNC Start=12a>",
+		"<SYNC Start= 1000>",
+		"<SYNC Start =1000>",
+		"<SYNCStart=1000>",
+		"<SYNC>",
+		"<SYNC Start=1000",
+		"<SYNC Start=1000<P>",
+		"<SYNC Start=1000 <b>>",
+		"<SYNC Start=1 Start=2>",
+		"<SYNC Start=1 Start=x>",
+		"<SYNC Start=x Start=2>",
+		"<SYNC XStart=5 Start=6>",
+		"<SYNC Start=5 XStart=6>",
+		"<SYNC Start=99999999999999999999999>",
+		"<SYNC Start=9223372036854775807>",
+		"<SYNC Start=9223372036854775808>",
+		"<SYNC Start=000123>",
+		"<SYNC Start=1000><P>",
+		"<SYNC Start=1000><p>",
+		"<SYNC Start=1000><P >",
+		"<SYNC Start=1000> <P>",
+		"<SYNC Start=1000><Pa>",
+		"<SYNC Start=1000><P",
+		"<<SYNC Start=1>",
+		"<SYNC <SYNC Start=1>",
+		"<SYNC Start=1><SYNC Start=2><P><SYNC Start=3>",
+		"x<sYnC sTaRt=42 eNd=50>y",
+		"<SYNC class=a Start=7 class=b>",
+		"<syncx Start=1>",
+		"<sync\vStart=1\f>",
+	};
+	for (const auto text : cases)
+		CheckSameAsRegex(text);
+}
+
+TEST(SmiParser_FindSyncTag_Random) {
+	// Pieces that the regex is sensitive to, put together at random.
+	static const char* const PIECES[] = {
+		"<sync", "<SYNC", "<SyNc", "<s", "ync", " ", " ", "\t", "\r\n", "\n",
+		"start=", "Start=", "START=", "start =", "xstart=", "=", "\"", "'",
+		"0", "7", "123", "9223372036854775807", "99999999999999999999999", "12a",
+		"end=5", "class=KRCC", "<P>", "<p>", "<P ", ">", ">", "<", "x", "<br>", "&nbsp;",
+	};
+	std::mt19937 random(12345);
+	const auto count = sizeof PIECES / sizeof PIECES[0];
+	for (auto iteration = 0; iteration < 20000; ++iteration) {
+		std::string text;
+		const auto pieces = 1 + random() % 14;
+		for (size_t i = 0; i < pieces; ++i)
+			text += PIECES[random() % count];
+		CheckSameAsRegex(text);
+	}
+}
+
+TEST(SmiParser_FindSyncTag_Corpus) {
+	CheckSameAsRegex(Corpus::MakeSmi(300));
+}
+
+TEST(SmiParser_FindSyncTag_Overflow) {
+	SmiParser::SyncTag tag;
+	CHECK(SmiParser::FindSyncTag("<SYNC Start=123456789012345678901234567890>", 0, tag));
+	CHECK_EQ(tag.start, LLONG_MAX);
+	CHECK_EQ(tag.valueLength, 30u);
+}
+
+TEST(SmiParser_FindAttribute) {
+	std::string_view value;
+	CHECK(SmiParser::FindAttribute("<SYNC Start=1 End='2000'>", "end", value));
+	CHECK_EQ(value, "2000");
+	CHECK(SmiParser::FindAttribute("<P Class=KRCC>", "class", value));
+	CHECK_EQ(value, "KRCC");
+	CHECK(!SmiParser::FindAttribute("<SYNC Start=1 XEnd=2>", "end", value));
+	CHECK(!SmiParser::FindAttribute("<SYNC Start=1 End='2>", "end", value));
+}
+
+TEST(SmiParser_FindSyncEnd) {
+	const struct {
+		const char* text;
+		int64_t end;
+	} CASES[] = {
+		{ "<SYNC Start=1 End=2000><P>x", 2000 }, { "<sync end='300' start=1>", 300 }, { "<SYNC Start=1>", -1 },
+		{ "<SYNC Start=1 End=>", -1 }, { "<SYNC Start=1 End=12a>", -1 }, { "<SYNC Start=1 End=\"-5\">", -1 },
+		{ "<SYNC Start=1><P End=5>", -1 }, { "<SYNC Start=1 End=123456789012345678901234567890>", LLONG_MAX },
+	};
+	for (const auto& c : CASES) {
+		SmiParser::SyncTag tag;
+		CHECK(SmiParser::FindSyncTag(c.text, 0, tag));
+		CHECK_EQ(SmiParser::FindSyncEnd(c.text, tag), c.end);
+	}
+}
+
+TEST(SmiParser_CountLineBreaks) {
+	CHECK_EQ(SmiParser::CountLineBreaks(""), 0u);
+	CHECK_EQ(SmiParser::CountLineBreaks("a\r\nb\nc\rd"), 3u);
+	CHECK_EQ(SmiParser::CountLineBreaks("\r\n\r\n"), 2u);
+	CHECK_EQ(SmiParser::CountLineBreaks("a\r"), 1u);
+}
+
+// Per line, as "Insert beginning timecode" and the old "Go to current line" used it, and over whole documents.
+BENCHMARK(SmiParser_FindSyncTag) {
+	std::vector<std::pair<std::string, std::string>> documents;
+	documents.emplace_back("generated", Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000));
+	for (const auto& path : Test::CorpusFiles())
+		documents.emplace_back(path, Corpus::ReadFile(path));
+
+	for (const auto& document : documents) {
+		const auto& text = document.second;
+		std::vector<std::string> lines;
+		for (size_t begin = 0; begin < text.size();) {
+			auto end = text.find('\n', begin);
+			end = end == std::string::npos ? text.size() : end + 1;
+			lines.push_back(text.substr(begin, end - begin));
+			begin = end;
+		}
+
+		size_t regexFound = 0, found = 0;
+		const auto regexTime = Test::Time([&] {
+			regexFound = 0;
+			std::smatch match;
+			for (const auto& line : lines)
+				regexFound += std::regex_search(line, match, SYNC_MATCHER);
+		}, 1);
+		const auto scanTime = Test::Time([&] {
+			found = 0;
+			SmiParser::SyncTag tag;
+			for (const auto& line : lines)
+				found += SmiParser::FindSyncTag(line, 0, tag);
+		});
+		CHECK_EQ(found, regexFound);
+
+		size_t tags = 0;
+		const auto wholeTime = Test::Time([&] {
+			tags = 0;
+			SmiParser::SyncTag tag;
+			for (size_t pos = 0; SmiParser::FindSyncTag(text, pos, tag); pos = tag.offset + tag.length)
+				++tags;
+		});
+
+		printf("  %s: %zu lines, %.1f MB\n", document.first.c_str(), lines.size(), text.size() / 1e6);
+		printf("  per line: regex %.1f ns, scanner %.1f ns, %.0fx faster\n",
+			regexTime * 1e9 / lines.size(), scanTime * 1e9 / lines.size(), regexTime / scanTime);
+		printf("  whole document: %zu tags in %.2f ms, %.2f GB/s\n", tags, wholeTime * 1e3, text.size() / wholeTime / 1e9);
+	}
+}
+
+static const SmiParser::Kernel KERNELS[] = { SmiParser::Kernel::SCALAR, SmiParser::Kernel::SSE2, SmiParser::Kernel::AVX2 };
+static const char* const KERNEL_NAMES[] = { "scalar", "SSE2", "AVX2" };
+
+static size_t FindSyncCandidateReference(const std::string& text, size_t from) {
+	for (; from + 5 <= text.size(); ++from) {
+		if (text[from] == '<' && (text[from + 1] | 0x20) == 's' && (text[from + 2] | 0x20) == 'y'
+			&& (text[from + 3] | 0x20) == 'n' && (text[from + 4] | 0x20) == 'c')
+			return from;
+	}
+	return std::string::npos;
+}
+
+TEST(SmiParser_FindSyncCandidate_Kernels) {
+	const auto original = SmiParser::GetKernel();
+	std::mt19937 random(7);
+	static const char ALPHABET[] = "<<<sSyYnNcC x>";
+	for (size_t k = 0; k < 3; ++k) {
+		if (!SmiParser::SelectKernel(KERNELS[k])) {
+			printf("  %s: not supported by this CPU\n", KERNEL_NAMES[k]);
+			continue;
+		}
+
+		// Dense near-misses at every length, so that matches land on and across every vector boundary.
+		for (auto iteration = 0; iteration < 3000; ++iteration) {
+			std::string text(random() % 160, ' ');
+			for (auto& c : text)
+				c = ALPHABET[random() % (sizeof ALPHABET - 1)];
+			if (!text.empty() && random() % 2)
+				text.replace(random() % text.size(), 0, random() % 2 ? "<sync" : "<SyNc");
+			for (size_t from = 0; from <= text.size(); ++from)
+				CHECK_EQ(SmiParser::FindSyncCandidate(text, from), FindSyncCandidateReference(text, from));
+		}
+
+		// A single tag at every distance from the end, with nothing but text before it.
+		for (size_t distance = 5; distance < 80; ++distance) {
+			std::string text(300, 'x');
+			text.replace(text.size() - distance, 5, "<SYNC");
+			CHECK_EQ(SmiParser::FindSyncCandidate(text, 0), text.size() - distance);
+			CHECK_EQ(SmiParser::FindSyncCandidate(text.substr(0, text.size() - distance + 4), 0), std::string::npos);
+		}
+
+		CheckSameAsRegex(Corpus::MakeSmi(50, static_cast<uint32_t>(k)));
+	}
+	SmiParser::SelectKernel(original);
+}
+
+// Counts every candidate with each kernel, over a document, over text without any '<', and over markup that is all near misses.
+BENCHMARK(SmiParser_FindSyncCandidate) {
+	const auto size = Test::IsQuick() ? (1u << 20) : (64u << 20);
+	std::vector<std::pair<std::string, std::string>> inputs;
+	auto document = Corpus::MakeSmi(size / 100);
+	inputs.emplace_back("generated document", document);
+	inputs.emplace_back("no markup", std::string(size, 'a'));
+	std::string markup;
+	while (markup.size() < size)
+		markup += "<span><s>x</s><br><P Class=KRCC>";
+	inputs.emplace_back("markup without Syncs", markup);
+	for (const auto& path : Test::CorpusFiles())
+		inputs.emplace_back(path, Corpus::ReadFile(path));
+
+	const auto original = SmiParser::GetKernel();
+	for (const auto& input : inputs) {
+		printf("  %s, %.1f MB:", input.first.c_str(), input.second.size() / 1e6);
+		size_t expected = SIZE_MAX;
+		for (size_t k = 0; k < 3; ++k) {
+			if (!SmiParser::SelectKernel(KERNELS[k]))
+				continue;
+			size_t count = 0;
+			const auto seconds = Test::Time([&] {
+				count = 0;
+				for (auto pos = SmiParser::FindSyncCandidate(input.second, 0); pos != std::string::npos; pos = SmiParser::FindSyncCandidate(input.second, pos + 1))
+					++count;
+			});
+			if (expected == SIZE_MAX)
+				expected = count;
+			CHECK_EQ(count, expected);
+			printf(" %s %.2f GB/s", KERNEL_NAMES[k], input.second.size() / seconds / 1e9);
+		}
+		printf("\n");
+	}
+	SmiParser::SelectKernel(original);
+}
@@ -0,0 +1,273 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SmiParser.h"
+#include "SmiRetime.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <random>
+
+// text with edit applied.
+static std::string Apply(const std::string& text, const SmiRetime::Edit& edit) {
+	return text.substr(0, edit.begin) + edit.text + text.substr(edit.end);
+}
+
+static std::vector<int64_t> Starts(const std::string& text) {
+	std::vector<int64_t> starts;
+	SmiParser::SyncTag tag;
+	for (size_t pos = 0; SmiParser::FindSyncTag(text, pos, tag); pos = tag.offset + tag.length)
+		starts.push_back(tag.start);
+	return starts;
+}
+
+TEST(SmiRetime_ParseOffset) {
+	const struct {
+		const char* text;
+		int64_t offset;
+	} VALID[] = {
+		{ "+1.2", 1200 }, { "-0.5s", -500 }, { "1.25s", 1250 }, { "1200ms", 1200 }, { "-40ms", -40 }, { "3", 3000 },
+		{ " + 2.5 s ", 2500 }, { ".5", 500 }, { "7.", 7000 }, { "0.001", 1 }, { "-0", 0 }, { "1000000000000ms", 1000000000000 },
+	};
+	for (const auto& valid : VALID) {
+		int64_t offset = -1;
+		CHECK(SmiRetime::ParseOffset(valid.text, offset));
+		CHECK_EQ(offset, valid.offset);
+	}
+
+	// Milliseconds are whole, and nothing finer than them is taken.
+	for (const auto* invalid : { "", "+", "s", "ms", ".", "1.5ms", "0.0001", "1..2", "1.2.3", "--1", "1 2", "1h", "1e3", "1000000000001" }) {
+		int64_t offset = 7;
+		CHECK(!SmiRetime::ParseOffset(invalid, offset));
+		CHECK_EQ(offset, 7);
+	}
+}
+
+TEST(SmiRetime_Shift) {
+	const std::string text = "<SAMI><BODY>\r\n<SYNC Start=1000><P>one\r\n<SYNC Start=\"2000\"><P>two\r\n<sync start=3000><p>three\r\n";
+	SmiRetime::Edit edit;
+	CHECK(SmiRetime::Shift(text, 0, text.size(), 1200, edit));
+	CHECK_EQ(edit.changed, size_t(3));
+	CHECK_EQ(Apply(text, edit), std::string("<SAMI><BODY>\r\n<SYNC Start=2200><P>one\r\n<SYNC Start=\"3200\"><P>two\r\n<sync start=4200><p>three\r\n"));
+	// Only the digits, from the first to the last value, are replaced.
+	CHECK_EQ(text.substr(edit.begin, 4), std::string("1000"));
+	CHECK_EQ(text.substr(edit.end - 4, 4), std::string("3000"));
+
+	// A range picks the Syncs beginning in it; the one ending the second line is left as it is.
+	const auto second = text.find("<SYNC Start=\"2000\"");
+	CHECK(SmiRetime::Shift(text, second, text.find("two\r\n") + 3, -500, edit));
+	CHECK_EQ(edit.changed, size_t(1));
+	CHECK((Starts(Apply(text, edit)) == std::vector<int64_t>{ 1000, 1500, 3000 }));
+
+	// Clamped at 0, and saturating rather than wrapping.
+	CHECK(SmiRetime::Shift(text, 0, text.size(), -2500, edit));
+	CHECK((Starts(Apply(text, edit)) == std::vector<int64_t>{ 0, 0, 500 }));
+	CHECK(SmiRetime::Shift(text, 0, text.size(), std::numeric_limits<int64_t>::max(), edit));
+	CHECK_EQ(Starts(Apply(text, edit)).back(), std::numeric_limits<int64_t>::max());
+
+	// End values move with their Starts, wherever they are in the tag.
+	const std::string ends = "<SYNC End='2500' Start=1000><P>one\r\n<SYNC Start=3000 END=3600><P>two\r\n<SYNC Start=5000><P>three\r\n";
+	CHECK(SmiRetime::Shift(ends, 0, ends.size(), 100, edit));
+	CHECK_EQ(edit.changed, size_t(3));
+	CHECK_EQ(Apply(ends, edit), std::string("<SYNC End='2600' Start=1100><P>one\r\n<SYNC Start=3100 END=3700><P>two\r\n<SYNC Start=5100><P>three\r\n"));
+	CHECK(SmiRetime::Shift(ends, 0, ends.size(), -2000, edit));
+	CHECK_EQ(Apply(ends, edit), std::string("<SYNC End='500' Start=0><P>one\r\n<SYNC Start=1000 END=1600><P>two\r\n<SYNC Start=3000><P>three\r\n"));
+
+	CHECK(!SmiRetime::Shift(text, 0, text.size(), 0, edit));
+	CHECK(edit.text.empty());
+	CHECK(!SmiRetime::Shift(text, text.find("one"), text.find("<SYNC Start=\"2000\""), 100, edit));
+}
+
+// start * num / den + offset in 128 bits, the product rounded half up, then clamped to int64_t.
+static int64_t ApplyReference(const SmiRetime::Affine& affine, const int64_t start) {
+	if (start < 0)
+		return start;
+	const auto product = static_cast<__int128>(start) * affine.scale.num;
+	auto result = product / affine.scale.den;
+	if (2 * (product % affine.scale.den) >= affine.scale.den)
+		++result;
+	result += affine.offset;
+	if (result > std::numeric_limits<int64_t>::max())
+		return std::numeric_limits<int64_t>::max();
+	if (result < std::numeric_limits<int64_t>::min())
+		return std::numeric_limits<int64_t>::min();
+	return static_cast<int64_t>(result);
+}
+
+TEST(SmiRetime_Affine) {
+	SmiRetime::Affine affine;
+	// 23.976 to 25 fps: 1001 ms of film is 960 ms of PAL, exactly.
+	CHECK(SmiRetime::ConvertFramerate({ 24000, 1001 }, { 25, 1 }, 0, affine));
+	CHECK_EQ(affine.scale.num, int64_t(960));
+	CHECK_EQ(affine.scale.den, int64_t(1001));
+	CHECK_EQ(affine.Apply(1001), int64_t(960));
+	CHECK_EQ(affine.Apply(0), int64_t(0));
+	CHECK_EQ(affine.Apply(-5), int64_t(-5));
+
+	// Halves round up, and nothing else does.
+	CHECK(SmiRetime::MakeAffine({ 1, 2 }, 0, affine));
+	CHECK_EQ(affine.Apply(1), int64_t(1));
+	CHECK_EQ(affine.Apply(3), int64_t(2));
+	CHECK(SmiRetime::MakeAffine({ 2, 3 }, 0, affine));
+	CHECK_EQ(affine.Apply(1), int64_t(1));
+	CHECK_EQ(affine.Apply(2), int64_t(1));
+	CHECK_EQ(affine.Apply(4), int64_t(3));
+
+	CHECK(!SmiRetime::MakeAffine({ 0, 1 }, 0, affine));
+	CHECK(!SmiRetime::MakeAffine({ 1, int64_t(1) << 31 }, 0, affine));
+	CHECK(SmiRetime::MakeAffine({ int64_t(3) << 31, int64_t(3) << 31 }, 0, affine));
+	CHECK_EQ(affine.scale.den, int64_t(1));
+
+	// Against 128-bit arithmetic, with starts and scales of every size and the largest denominators allowed.
+	const SmiRetime::Rational SCALES[] = {
+		{ 24000, 25025 }, { 25025, 24000 }, { 1, 1 }, { 1, 3 }, { 7, 2 }, { 1000000, 999999 },
+		{ (int64_t(1) << 31) - 2, (int64_t(1) << 31) - 1 }, { (int64_t(1) << 31) - 1, 3 }, { (int64_t(1) << 62) + 1, (int64_t(1) << 31) - 1 },
+	};
+	std::mt19937_64 random(3);
+	for (const auto& scale : SCALES) {
+		for (auto i = 0; i < 20000; ++i) {
+			const auto start = static_cast<int64_t>(random() >> (1 + random() % 63));
+			const int64_t OFFSETS[] = { 0, 1200, -1200, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min(), static_cast<int64_t>(random()) };
+			const auto offset = OFFSETS[i % 6];
+			CHECK(SmiRetime::MakeAffine(scale, offset, affine));
+			const auto expected = ApplyReference(affine, start), actual = affine.Apply(start);
+			if (actual != expected) {
+				CHECK_EQ(actual, expected);
+				printf("  start %lld, scale %lld/%lld, offset %lld\n", static_cast<long long>(start),
+					static_cast<long long>(affine.scale.num), static_cast<long long>(affine.scale.den), static_cast<long long>(offset));
+				return;
+			}
+		}
+	}
+}
+
+TEST(SmiRetime_Interpolate) {
+	using SmiRetime::Interpolate;
+	CHECK_EQ(Interpolate({})(1234), int64_t(1234));
+
+	// One anchor is a shift.
+	auto map = Interpolate({ { 1000, 1500 } });
+	CHECK_EQ(map(0), int64_t(500));
+	CHECK_EQ(map(1000), int64_t(1500));
+	CHECK_EQ(map(3600000), int64_t(3600500));
+
+	// Two are a line through both, continued past either of them; what goes below 0 is for Rewrite to clamp.
+	map = Interpolate({ { 3000, 5000 }, { 1000, 1000 } });
+	CHECK_EQ(map(1000), int64_t(1000));
+	CHECK_EQ(map(2000), int64_t(3000));
+	CHECK_EQ(map(3000), int64_t(5000));
+	CHECK_EQ(map(0), int64_t(-1000));
+	CHECK_EQ(map(4000), int64_t(7000));
+
+	// In any order, with the last of anchors at the same start counting; each segment has its own slope,
+	// and the first and last ones go on past the anchors.
+	map = Interpolate({ { 5000, 9000 }, { 1000, 2000 }, { 3000, 3000 }, { 1000, 1000 } });
+	CHECK_EQ(map(0), int64_t(0));
+	CHECK_EQ(map(1000), int64_t(1000));
+	CHECK_EQ(map(2000), int64_t(2000));
+	CHECK_EQ(map(3000), int64_t(3000));
+	CHECK_EQ(map(4000), int64_t(6000));
+	CHECK_EQ(map(5000), int64_t(9000));
+	CHECK_EQ(map(6000), int64_t(12000));
+
+	// Halves round up.
+	map = Interpolate({ { 0, 0 }, { 2, 1 } });
+	CHECK_EQ(map(1), int64_t(1));
+	CHECK_EQ(map(3), int64_t(2));
+
+	// Every anchor at the same start: a shift to the last of them.
+	map = Interpolate({ { 2000, 2500 }, { 2000, 3000 }, { 2000, 2000 }, { 2000, 3000 } });
+	CHECK_EQ(map(0), int64_t(1000));
+	CHECK_EQ(map(2000), int64_t(3000));
+	CHECK_EQ(map(10000), int64_t(11000));
+
+	// Through every anchor of many, in random order.
+	std::mt19937_64 random(8);
+	std::vector<SmiRetime::Anchor> anchors;
+	for (int64_t start = 0; start < 3600000; start += 1000 + static_cast<int64_t>(random() % 60000))
+		anchors.push_back({ start, start + static_cast<int64_t>(random() % 2000) });
+	auto shuffled = anchors;
+	std::shuffle(shuffled.begin(), shuffled.end(), random);
+	map = Interpolate(shuffled);
+	for (const auto& anchor : anchors)
+		CHECK_EQ(map(anchor.start), anchor.target);
+}
+
+TEST(SmiRetime_FitLine) {
+	using SmiRetime::FitLine;
+	CHECK_EQ(FitLine({})(1234), int64_t(1234));
+	CHECK_EQ(FitLine({ { 1000, 1500 } })(3000), int64_t(3500));
+
+	// Points on a line give that line, in any order.
+	auto map = FitLine({ { 5000, 10100 }, { 0, 100 }, { 1000, 2100 }, { 3000, 6100 } });
+	CHECK_EQ(map(0), int64_t(100));
+	CHECK_EQ(map(2000), int64_t(4100));
+	CHECK_EQ(map(3600000), int64_t(7200100));
+
+	// Every anchor at the same start: a shift by the average difference.
+	map = FitLine({ { 2000, 2500 }, { 2000, 3000 }, { 2000, 3500 } });
+	CHECK_EQ(map(0), int64_t(1000));
+	CHECK_EQ(map(2000), int64_t(3000));
+
+	// Marks up to 40 ms off either way along a 25/24 speed-up with a 500 ms delay: the line is found to within a few ms
+	// over the whole film, closer than any one mark.
+	std::mt19937_64 random(9);
+	std::vector<SmiRetime::Anchor> anchors;
+	for (auto i = 0; i < 200; ++i) {
+		const auto start = static_cast<int64_t>(random() % 7200000);
+		anchors.push_back({ start, start * 25 / 24 + 500 + static_cast<int64_t>(random() % 81) - 40 });
+	}
+	map = FitLine(anchors);
+	int64_t worst = 0;
+	for (int64_t start = 0; start <= 7200000; start += 60000)
+		worst = std::max(worst, std::abs(map(start) - (start * 25 / 24 + 500)));
+	CHECK(worst <= 10);
+}
+
+BENCHMARK(SmiRetime_Shift) {
+	const auto text = Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000);
+	SmiRetime::Edit edit;
+	const auto time = Test::Time([&] { SmiRetime::Shift(text, 0, text.size(), 1200, edit); });
+	printf("  %zu Syncs in %.1f MB: %.2f ms, %.0f MB/s\n", edit.changed, text.size() / 1e6, time * 1e3, text.size() / 1e6 / time);
+}
+
+BENCHMARK(SmiRetime_Affine) {
+	std::mt19937_64 random(4);
+	std::vector<int64_t> starts(Test::IsQuick() ? 10000 : 1000000);
+	for (auto& start : starts)
+		start = static_cast<int64_t>(random() % 36000000);
+	SmiRetime::Affine affine;
+	SmiRetime::ConvertFramerate({ 24000, 1001 }, { 25, 1 }, 1200, affine);
+
+	int64_t sum = 0, referenceSum = 0;
+	const auto time = Test::Time([&] {
+		sum = 0;
+		for (const auto start : starts)
+			sum += affine.Apply(start);
+	});
+	const auto referenceTime = Test::Time([&] {
+		referenceSum = 0;
+		for (const auto start : starts)
+			referenceSum += ApplyReference(affine, start);
+	});
+	printf("  Apply %.2f ns, 128-bit reference %.2f ns per value (%s)\n", time * 1e9 / starts.size(), referenceTime * 1e9 / starts.size(),
+		sum == referenceSum ? "same" : "DIFFERENT");
+}
+
+BENCHMARK(SmiRetime_Anchors) {
+	// Fitting a large file to 100 anchors, either way, against a plain shift of it.
+	const auto text = Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000);
+	const auto starts = Starts(text);
+	std::mt19937_64 random(10);
+	std::vector<SmiRetime::Anchor> anchors;
+	for (auto i = 0; i < 100; ++i) {
+		const auto start = starts[random() % starts.size()];
+		anchors.push_back({ start, start * 25 / 24 + 500 + static_cast<int64_t>(random() % 81) - 40 });
+	}
+
+	SmiRetime::Edit edit;
+	const auto shiftTime = Test::Time([&] { SmiRetime::Shift(text, 0, text.size(), 500, edit); });
+	const auto interpolateTime = Test::Time([&] { SmiRetime::Rewrite(text, 0, text.size(), SmiRetime::Interpolate(anchors), edit); });
+	const auto fitTime = Test::Time([&] { SmiRetime::Rewrite(text, 0, text.size(), SmiRetime::FitLine(anchors), edit); });
+	printf("  %zu Syncs in %.1f MB, %zu anchors: Shift %.2f ms, Interpolate %.2f ms, FitLine %.2f ms\n", starts.size(), text.size() / 1e6,
+		anchors.size(), shiftTime * 1e3, interpolateTime * 1e3, fitTime * 1e3);
+}
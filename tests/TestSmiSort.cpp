@@ -0,0 +1,83 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SmiSort.h"
+#include <algorithm>
+#include <random>
+
+static bool ByStart(const SmiSort::Block& a, const SmiSort::Block& b) {
+	return a.start < b.start;
+}
+
+static bool SameOrder(const std::vector<SmiSort::Block>& a, const std::vector<SmiSort::Block>& b) {
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const SmiSort::Block& x, const SmiSort::Block& y) {
+		return x.start == y.start && x.offset == y.offset;
+	});
+}
+
+TEST(SmiSort_SortBlocks_Stable) {
+	// Against std::stable_sort, with offsets telling apart blocks of equal start. Few distinct starts make long runs of equal keys;
+	// wide ones need every byte, and narrow ones let the bytes all starts share be skipped.
+	std::mt19937_64 random(6);
+	for (const uint64_t range : { uint64_t(1), uint64_t(7), uint64_t(300), uint64_t(1) << 40, ~uint64_t(0) >> 1 }) {
+		for (const size_t size : { size_t(0), size_t(1), size_t(2), size_t(1000) }) {
+			std::vector<SmiSort::Block> blocks(size);
+			for (size_t i = 0; i < size; ++i)
+				blocks[i] = { static_cast<int64_t>(random() % range + 3600000), i, 1 };
+			auto expected = blocks;
+			std::stable_sort(expected.begin(), expected.end(), ByStart);
+			SmiSort::SortBlocks(blocks);
+			CHECK(SameOrder(blocks, expected));
+		}
+	}
+
+	// Negative starts, which only a caller can give, go first.
+	std::vector<SmiSort::Block> blocks = { { 5, 0, 1 }, { -1, 1, 1 }, { 5, 2, 1 }, { -1, 3, 1 }, { 0, 4, 1 } };
+	SmiSort::SortBlocks(blocks);
+	CHECK(SameOrder(blocks, { { -1, 1, 1 }, { -1, 3, 1 }, { 0, 4, 1 }, { 5, 0, 1 }, { 5, 2, 1 } }));
+}
+
+TEST(SmiSort_Sort) {
+	const std::string text =
+		"<SAMI><BODY>\r\n"
+		"<SYNC Start=1000><P>a\r\n"
+		"<SYNC Start=3000><P>b\r\n"
+		"<SYNC Start=2000><P>c\r\n"
+		"<SYNC Start=2000><P>d\r\n"
+		"<SYNC Start=4000><P>e\r\n"
+		"</BODY></SAMI>\r\n";
+	SmiRetime::Edit edit;
+	CHECK(SmiSort::Sort(text, edit));
+	// Equal starts keep their order, and the blocks in place at either end are not part of the edit.
+	CHECK_EQ(edit.changed, size_t(3));
+	CHECK_EQ(text.substr(0, edit.begin) + edit.text + text.substr(edit.end), std::string(
+		"<SAMI><BODY>\r\n"
+		"<SYNC Start=1000><P>a\r\n"
+		"<SYNC Start=2000><P>c\r\n"
+		"<SYNC Start=2000><P>d\r\n"
+		"<SYNC Start=3000><P>b\r\n"
+		"<SYNC Start=4000><P>e\r\n"
+		"</BODY></SAMI>\r\n"));
+
+	// The last block moves without the closing tags.
+	const std::string last = "<SAMI><BODY>\r\n<SYNC Start=2000><P>a\r\n<SYNC Start=1000><P>b\r\n</BODY></SAMI>";
+	CHECK(SmiSort::Sort(last, edit));
+	CHECK_EQ(last.substr(0, edit.begin) + edit.text + last.substr(edit.end),
+		std::string("<SAMI><BODY>\r\n<SYNC Start=1000><P>b\r\n<SYNC Start=2000><P>a\r\n</BODY></SAMI>"));
+
+	CHECK(!SmiSort::Sort(Corpus::MakeSmi(100), edit));
+	CHECK(edit.text.empty());
+	CHECK(!SmiSort::Sort("no Sync at all", edit));
+}
+
+BENCHMARK(SmiSort_SortBlocks) {
+	const auto text = Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000);
+	auto blocks = SmiSort::FindBlocks(text);
+	std::mt19937 random(7);
+	std::shuffle(blocks.begin(), blocks.end(), random);
+
+	auto radix = blocks, stable = blocks;
+	const auto radixTime = Test::Time([&] { radix = blocks; SmiSort::SortBlocks(radix); });
+	const auto stableTime = Test::Time([&] { stable = blocks; std::stable_sort(stable.begin(), stable.end(), ByStart); });
+	printf("  %zu shuffled blocks: SortBlocks %.2f ms, std::stable_sort %.2f ms (%s)\n", blocks.size(), radixTime * 1e3, stableTime * 1e3,
+		SameOrder(radix, stable) ? "same" : "DIFFERENT");
+}
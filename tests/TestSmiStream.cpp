@@ -0,0 +1,124 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "MappedFile.h"
+#include "SmiStream.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+	struct Found {
+		uint64_t offset;
+		uint64_t line;
+		int64_t start;
+		size_t length;
+		bool hasParagraph;
+
+		bool operator ==(const Found& other) const {
+			return offset == other.offset && line == other.line && start == other.start && length == other.length && hasParagraph == other.hasParagraph;
+		}
+	};
+
+	// A file in the temporary directory, removed with the object.
+	class TempFile {
+		std::filesystem::path m_path;
+
+	public:
+		explicit TempFile(const std::string& content) {
+			m_path = std::filesystem::temp_directory_path() / ("NppSmiTests-" + std::to_string(std::random_device()()) + ".smi");
+			std::ofstream(m_path, std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+		}
+		~TempFile() {
+			std::error_code error;
+			std::filesystem::remove(m_path, error);
+		}
+
+		const std::filesystem::path& GetPath() const { return m_path; }
+	};
+}
+
+static SmiStream::SyncCallback Collect(std::vector<Found>& found) {
+	return [&found](const SmiParser::SyncTag& tag, const uint64_t offset, const uint64_t line) {
+		found.push_back({ offset, line, tag.start, tag.length, tag.paragraphOffset != std::string::npos });
+		return true;
+	};
+}
+
+// Walks text from a file with windows of the given size and compares with the walk over text in memory.
+// Windows too small for a tag may skip it, but must never report anything the walk in memory does not.
+static void CheckWindows(const std::string& text, const std::vector<size_t>& windowSizes, const size_t longestTag) {
+	std::vector<Found> expected;
+	SmiStream::ForEachSync(text, Collect(expected));
+
+	TempFile temp(text);
+	MappedFile file;
+	CHECK(file.Open(temp.GetPath()));
+	for (const auto windowSize : windowSizes) {
+		std::vector<Found> found;
+		CHECK(SmiStream::ForEachSync(file, Collect(found), windowSize));
+		if (windowSize >= 2 * longestTag + 8) {
+			CHECK_EQ(found.size(), expected.size());
+			for (size_t i = 0; i < found.size() && i < expected.size(); ++i)
+				CHECK(found[i] == expected[i]);
+			continue;
+		}
+		size_t next = 0;
+		for (const auto& tag : found) {
+			while (next < expected.size() && expected[next].offset < tag.offset)
+				++next;
+			CHECK(next < expected.size() && expected[next] == tag);
+		}
+	}
+}
+
+TEST(SmiStream_Windows) {
+	CheckWindows(Corpus::MakeSmi(500), { 64, 100, 127, 128, 1000, 4093, 65536, SmiStream::DEFAULT_WINDOW_SIZE }, 48);
+	// Line breaks of every kind next to the tags, so that windows end between CR and LF and right before <P>.
+	std::string breaks;
+	std::mt19937 random(9);
+	static const char* const PIECES[] = { "\r\n", "\r", "\n", "<SYNC Start=10>", "<SYNC Start=20><P>", "<P>", "x", "\r\n<br>" };
+	while (breaks.size() < 20000)
+		breaks += PIECES[random() % (sizeof PIECES / sizeof PIECES[0])];
+	CheckWindows(breaks, { 1, 8, 9, 16, 17, 18, 19, 21, 25, 33, 39, 40, 41, 97, 256, 4096 }, 18);
+}
+
+TEST(SmiStream_Stop) {
+	const auto text = Corpus::MakeSmi(100);
+	TempFile temp(text);
+	MappedFile file;
+	CHECK(file.Open(temp.GetPath()));
+	size_t calls = 0;
+	CHECK(SmiStream::ForEachSync(file, [&](const SmiParser::SyncTag&, uint64_t, uint64_t) { return ++calls < 3; }, 256));
+	CHECK_EQ(calls, 3u);
+}
+
+TEST(SmiStream_Missing) {
+	MappedFile file;
+	CHECK(!file.Open(std::filesystem::temp_directory_path() / "NppSmiTests-missing.smi"));
+	CHECK(file.Map(0, 16).empty());
+}
+
+// SmiDump's walk over a file on disk, windowed as it maps it, against reading the whole file first.
+BENCHMARK(SmiStream_ForEachSync) {
+	std::vector<std::string> paths;
+	std::unique_ptr<TempFile> generated;
+	if (Test::CorpusFiles().empty()) {
+		generated = std::make_unique<TempFile>(Corpus::MakeSmi(Test::IsQuick() ? 2000 : 1000000));
+		paths.push_back(generated->GetPath().string());
+	} else
+		paths = Test::CorpusFiles();
+
+	for (const auto& path : paths) {
+		MappedFile file;
+		CHECK(file.Open(path));
+		size_t count = 0;
+		const auto callback = [&count](const SmiParser::SyncTag&, uint64_t, uint64_t) { ++count; return true; };
+		printf("  %s, %.1f MB\n", path.c_str(), file.GetSize() / 1e6);
+		for (const size_t windowSize : { 1u << 20, 16u << 20, 64u << 20 }) {
+			const auto seconds = Test::Time([&] { count = 0; SmiStream::ForEachSync(file, callback, windowSize); });
+			printf("  mapped, %zu MB windows: %.2f GB/s, %zu Syncs\n", windowSize >> 20, file.GetSize() / seconds / 1e9, count);
+		}
+		const auto seconds = Test::Time([&] { count = 0; SmiStream::ForEachSync(Corpus::ReadFile(path), callback); });
+		printf("  read into memory: %.2f GB/s, %zu Syncs\n", file.GetSize() / seconds / 1e9, count);
+	}
+}
@@ -0,0 +1,164 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SmiParser.h"
+#include "SmiText.h"
+#include <random>
+#include <regex>
+
+// The caption regexes NppSmi.cpp had, with the entities and whitespace rules of NormalizeCaption, applied in one pass.
+static const std::regex CAPTION_MATCHER(R"((</?p\b[^<>]*>)|(<br\b[^<>]*>)|&(amp|lt|gt|quot|nbsp|#44032|#x41);)", std::regex_constants::icase);
+static const std::regex SPACE_MATCHER(R"(\s+)");
+
+static std::string NormalizeReference(const std::string& html) {
+	// \x01 marks a <BR>, which a literal line break in the HTML is not.
+	std::string replaced;
+	auto last = html.cbegin();
+	for (std::sregex_iterator it(html.begin(), html.end(), CAPTION_MATCHER), end; it != end; ++it) {
+		const auto& match = *it;
+		replaced.append(last, match[0].first);
+		last = match[0].second;
+		if (match[2].matched)
+			replaced += '\x01';
+		else if (match[3].matched) {
+			const auto name = match.str(3);
+			replaced += name == "amp" ? "&" : name == "lt" ? "<" : name == "gt" ? ">" : name == "quot" ? "\"" : name == "nbsp" ? " " : name == "#x41" ? "A" : "\xEA\xB0\x80";
+		}
+	}
+	replaced.append(last, html.cend());
+
+	std::string result;
+	size_t begin = 0;
+	while (begin <= replaced.size()) {
+		auto end = replaced.find('\x01', begin);
+		if (end == std::string::npos)
+			end = replaced.size();
+		auto line = std::regex_replace(replaced.substr(begin, end - begin), SPACE_MATCHER, " ");
+		if (!line.empty() && line.front() == ' ')
+			line.erase(0, 1);
+		if (!line.empty() && line.back() == ' ')
+			line.pop_back();
+		if (!line.empty())
+			result += (result.empty() ? "" : "\n") + line;
+		begin = end + 1;
+	}
+	return result;
+}
+
+static std::string Normalize(const std::string& html) {
+	std::string out(html.size(), '\0');
+	out.resize(SmiText::NormalizeCaption(html, &out[0], out.size()));
+	return out;
+}
+
+TEST(SmiText_NormalizeCaption_Cases) {
+	const char* const cases[] = {
+		"",
+		"plain",
+		"  two   words  ",
+		"<P Class=KRCC>caption",
+		"<p>a</p>b",
+		"a<br>b",
+		"a<BR/>b<Br >c",
+		"<br><br>a<br><br>",
+		"a <br> b",
+		"a\r\n<br>\r\nb",
+		"<brx>a",
+		"<pre>a",
+		"<p<br>a",
+		"<b>bold</b>",
+		"Tom &amp; Jerry",
+		"&lt;br&gt;",
+		"a&nbsp;&nbsp;b",
+		"&nbsp;",
+		"&#44032;&#x41;",
+		"&amp",
+		"& x",
+		"- \xEA\xB0\x80\xEC\x9E\x90!<br>- \xEC\xA7\x80\xEA\xB8\x88?",
+		"<font color=\"#ffff00\">(x)</font>",
+	};
+	for (const auto html : cases) {
+		CHECK_EQ(Normalize(html), NormalizeReference(html));
+	}
+}
+
+TEST(SmiText_NormalizeCaption_Random) {
+	static const char* const PIECES[] = {
+		"<p>", "<P Class=KRCC>", "</P>", "<br>", "<BR/>", "<br >", "<brx>", "<pre>", "<b>", "</b>", "<", ">", "p", "br",
+		" ", "  ", "\t", "\r\n", "\n", "&amp;", "&lt;", "&nbsp;", "&#44032;", "&", ";", "a", "word", "\xEA\xB0\x80",
+	};
+	std::mt19937 random(21);
+	for (auto iteration = 0; iteration < 20000; ++iteration) {
+		std::string html;
+		const auto pieces = random() % 12;
+		for (size_t i = 0; i < pieces; ++i)
+			html += PIECES[random() % (sizeof PIECES / sizeof PIECES[0])];
+		const auto normalized = Normalize(html);
+		CHECK_EQ(normalized, NormalizeReference(html));
+		if (normalized != NormalizeReference(html))
+			printf("  in: %s\n", html.c_str());
+	}
+}
+
+TEST(SmiText_NormalizeCaption_Capacity) {
+	char out[8];
+	CHECK_EQ(SmiText::NormalizeCaption("<p>one two three", out, 5), 5u);
+	CHECK_EQ(std::string(out, 5), "one t");
+	CHECK_EQ(SmiText::NormalizeCaption("one", out, 0), 0u);
+}
+
+// The caption blocks of a document, as the text between Sync tags.
+static std::vector<std::string> SplitCaptions(const std::string& text) {
+	std::vector<std::string> captions;
+	SmiParser::SyncTag tag, next;
+	auto hasTag = SmiParser::FindSyncTag(text, 0, tag);
+	while (hasTag) {
+		const auto hasNext = SmiParser::FindSyncTag(text, tag.offset + tag.length, next);
+		const auto end = hasNext ? next.offset : text.size();
+		captions.push_back(text.substr(tag.offset + tag.length, end - tag.offset - tag.length));
+		tag = next;
+		hasTag = hasNext;
+	}
+	return captions;
+}
+
+// Per caption, against the regexes applied the way the plugin used to: one std::regex_replace per pattern.
+BENCHMARK(SmiText_NormalizeCaption) {
+	static const std::regex TAG_REMOVER(R"(</?p\b[^<>]*>)", std::regex_constants::icase);
+	static const std::regex BR_REPLACER(R"(<br\b[^<>]*>)", std::regex_constants::icase);
+	static const std::regex MULTILINE_MATCHER(R"(\n+)");
+
+	std::vector<std::pair<std::string, std::string>> documents;
+	documents.emplace_back("generated", Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000));
+	for (const auto& path : Test::CorpusFiles())
+		documents.emplace_back(path, Corpus::ReadFile(path));
+
+	for (const auto& document : documents) {
+		const auto captions = SplitCaptions(document.second);
+		size_t bytes = 0;
+		for (const auto& caption : captions)
+			bytes += caption.size();
+
+		size_t regexLength = 0, length = 0;
+		const auto regexTime = Test::Time([&] {
+			regexLength = 0;
+			for (const auto& caption : captions) {
+				auto text = std::regex_replace(caption, TAG_REMOVER, "");
+				text = std::regex_replace(text, BR_REPLACER, "\n");
+				text = std::regex_replace(text, MULTILINE_MATCHER, "\n");
+				regexLength += text.size();
+			}
+		}, 1);
+		std::string out;
+		const auto time = Test::Time([&] {
+			length = 0;
+			for (const auto& caption : captions) {
+				out.resize(caption.size());
+				length += SmiText::NormalizeCaption(caption, &out[0], out.size());
+			}
+		});
+		CHECK(length > 0 && regexLength > 0);
+		printf("  %s: %zu captions, %.1f MB\n", document.first.c_str(), captions.size(), bytes / 1e6);
+		printf("  regexes %.0f ns per caption, NormalizeCaption %.0f ns (%.0f MB/s), %.0fx faster\n",
+			regexTime * 1e9 / captions.size(), time * 1e9 / captions.size(), bytes / time / 1e6, regexTime / time);
+	}
+}
@@ -0,0 +1,412 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "SmiParser.h"
+#include "SmiTimeline.h"
+#include <algorithm>
+#include <cinttypes>
+#include <functional>
+#include <random>
+#include <thread>
+
+namespace {
+	struct Entry {
+		int64_t start;
+		size_t line;
+		size_t offset;
+		int64_t end;
+	};
+}
+
+// Every Sync of text with its line, found the slow way.
+static std::vector<Entry> ScanEntries(const std::string& text) {
+	std::vector<Entry> entries;
+	size_t line = 0, lineCountedTo = 0;
+	SmiParser::SyncTag tag;
+	for (size_t pos = 0; SmiParser::FindSyncTag(text, pos, tag); pos = tag.offset + tag.length) {
+		line += SmiParser::CountLineBreaks(std::string_view(text).substr(lineCountedTo, tag.offset - lineCountedTo));
+		lineCountedTo = tag.offset;
+		entries.push_back({ tag.start, line, tag.offset, SmiParser::FindSyncEnd(text, tag) });
+	}
+	return entries;
+}
+
+static size_t ScanTagLength(const std::string& text, const size_t offset) {
+	SmiParser::SyncTag tag;
+	return SmiParser::FindSyncTag(text, offset, tag) ? tag.length : 0;
+}
+
+// A document with one Sync per line at most, with starts from the given list; a negative start leaves the line without a Sync.
+static std::string MakeDocument(const std::vector<int64_t>& starts) {
+	std::string text = "<SAMI><BODY>\r\n";
+	char tag[64];
+	for (const auto start : starts) {
+		if (start < 0)
+			text += "text only\r\n";
+		else {
+			snprintf(tag, sizeof tag, "<SYNC Start=%" PRId64 "><P>caption\r\n", start);
+			text += tag;
+		}
+	}
+	return text;
+}
+
+// The first Sync on the closest line at or before line, as Go to current line looked for it one line at a time.
+static size_t FindAtOrBeforeLineReference(const std::vector<Entry>& entries, const size_t line) {
+	auto found = SmiTimeline::npos;
+	for (size_t i = 0; i < entries.size() && entries[i].line <= line; ++i) {
+		if (found == SmiTimeline::npos || entries[found].line != entries[i].line)
+			found = i;
+	}
+	return found;
+}
+
+static size_t FindActiveAtReference(const std::vector<Entry>& entries, const int64_t time) {
+	auto found = SmiTimeline::npos;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (entries[i].start <= time && (found == SmiTimeline::npos || entries[i].start >= entries[found].start))
+			found = i;
+	}
+	return found;
+}
+
+static void CheckQueries(const std::string& text) {
+	const auto entries = ScanEntries(text);
+	SmiTimeline timeline;
+	timeline.Build(text);
+	CHECK_EQ(timeline.Size(), entries.size());
+	if (timeline.Size() != entries.size())
+		return;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		CHECK_EQ(timeline.GetStart(i), entries[i].start);
+		CHECK_EQ(timeline.GetLine(i), entries[i].line);
+		CHECK_EQ(timeline.GetOffset(i), entries[i].offset);
+		CHECK_EQ(timeline.GetEnd(i), entries[i].end);
+	}
+
+	const auto lines = SmiParser::CountLineBreaks(text) + 2;
+	for (size_t line = 0; line < lines; ++line)
+		CHECK_EQ(timeline.FindAtOrBeforeLine(line), FindAtOrBeforeLineReference(entries, line));
+	std::vector<int64_t> times{ -1, 0, INT64_MAX };
+	for (const auto& entry : entries) {
+		times.push_back(entry.start - 1);
+		times.push_back(entry.start);
+		times.push_back(entry.start + 1);
+	}
+	for (const auto time : times)
+		CHECK_EQ(timeline.FindActiveAt(time), FindActiveAtReference(entries, time));
+}
+
+TEST(SmiTimeline_Empty) {
+	SmiTimeline timeline;
+	timeline.Build("");
+	CHECK(timeline.Empty());
+	CHECK_EQ(timeline.FindAtOrBeforeLine(0), SmiTimeline::npos);
+	CHECK_EQ(timeline.FindActiveAt(1000), SmiTimeline::npos);
+	CheckQueries("<SAMI>\r\n<BODY>\r\n</BODY>");
+}
+
+TEST(SmiTimeline_Queries) {
+	// Ties, lines without Syncs before, between and after them, and starts going backwards.
+	CheckQueries(MakeDocument({ 1000, 2000, 3000 }));
+	CheckQueries(MakeDocument({ -1, -1, 1000, -1, 2000, 2000, -1, 3000, -1 }));
+	CheckQueries(MakeDocument({ 3000, 1000, 2000, 1000, 0, 5000, 4000 }));
+	CheckQueries(MakeDocument({ 500, 500, 500 }));
+	CheckQueries("<SYNC Start=10><SYNC Start=5><P>a\r\n<SYNC Start=7>b<SYNC Start=1>\r\n\r\n<SYNC Start=7>");
+	CheckQueries(Corpus::MakeSmi(300));
+}
+
+TEST(SmiTimeline_Random) {
+	std::mt19937 random(3);
+	for (auto iteration = 0; iteration < 300; ++iteration) {
+		std::vector<int64_t> starts(random() % 40);
+		for (auto& start : starts)
+			start = static_cast<int64_t>(random() % 12) * 100 - 200;
+		CheckQueries(MakeDocument(starts));
+	}
+}
+
+// Builds text on threadCount threads and checks every entry and lookup against building it on one.
+static void CheckParallel(const std::string& text, const unsigned threadCount, const size_t minChunkSize) {
+	SmiTimeline expected, actual;
+	expected.Build(text, 1);
+	actual.Build(text, threadCount, minChunkSize);
+	CHECK_EQ(actual.Size(), expected.Size());
+	if (actual.Size() != expected.Size())
+		return;
+	for (size_t i = 0; i < expected.Size(); ++i) {
+		CHECK_EQ(actual.GetStart(i), expected.GetStart(i));
+		CHECK_EQ(actual.GetLine(i), expected.GetLine(i));
+		CHECK_EQ(actual.GetOffset(i), expected.GetOffset(i));
+		CHECK_EQ(actual.GetTagLength(i), expected.GetTagLength(i));
+		CHECK_EQ(actual.GetEnd(i), expected.GetEnd(i));
+		CHECK_EQ(actual.FindActiveAt(expected.GetStart(i)), expected.FindActiveAt(expected.GetStart(i)));
+	}
+	const auto lines = SmiParser::CountLineBreaks(text) + 2;
+	for (size_t line = 0; line < lines; ++line)
+		CHECK_EQ(actual.FindAtOrBeforeLine(line), expected.FindAtOrBeforeLine(line));
+}
+
+TEST(SmiTimeline_Build_Parallel) {
+	// Every cut is moved up to a "<sync", so with chunks of a byte, one thread count or another cuts right at each Sync,
+	// at "<sync" that is no tag, before the first Sync and after the last.
+	const std::string texts[] = {
+		MakeDocument({ 3000, 1000, -1, 2000, 2000, -1, 500 }),
+		"<SYNC Start=1><SYNC Start=2>\r\n\r\n<SYNC Start=3 End=9><sync><SYNC Start=x><syncs Start=4>\n<SYNC Start=5>\r<SYNC Start=6>",
+		"text only\r\n<SYNC Start=1000><P>one\r\n<SYNC",
+		Corpus::MakeSmi(40),
+	};
+	for (const auto& text : texts) {
+		for (unsigned threadCount = 2; threadCount <= 64; ++threadCount)
+			CheckParallel(text, threadCount, 1);
+	}
+
+	std::mt19937 random(12);
+	for (auto document = 0; document < 100; ++document) {
+		const auto text = Corpus::MakeSmi(1 + random() % 30, document);
+		CheckParallel(text, 2 + random() % 30, 1 + random() % 64);
+	}
+
+	// And with the real chunk size, on a document large enough for it to take several threads.
+	const auto large = Corpus::MakeSmi(100000);
+	CHECK(large.size() >= 2 * SmiTimeline::MIN_CHUNK_SIZE);
+	CheckParallel(large, 2, SmiTimeline::MIN_CHUNK_SIZE);
+	CheckParallel(large, 8, SmiTimeline::MIN_CHUNK_SIZE);
+}
+
+// Build on 1 to N threads; chunks are allowed down to 256 KB so that the quick document takes the threads too.
+BENCHMARK(SmiTimeline_Build_Threads) {
+	const auto text = Corpus::MakeSmi(Test::IsQuick() ? 20000 : 100000);
+	const auto maxThreads = std::max(4u, std::thread::hardware_concurrency());
+	printf("  %.1f MB, %u cores\n", text.size() / 1e6, std::thread::hardware_concurrency());
+	SmiTimeline timeline;
+	double single = 0;
+	for (unsigned threadCount = 1; threadCount <= maxThreads; ++threadCount) {
+		const auto time = Test::Time([&] { timeline.Build(text, threadCount, 256 << 10); }, 5);
+		if (threadCount == 1)
+			single = time;
+		printf("  %u threads: %.2f ms, %.0f MB/s, %.2fx\n", threadCount, time * 1e3, text.size() / 1e6 / time, single / time);
+	}
+}
+
+// Go to current line: scanning back one line at a time as before, building the index each time as the command does,
+// and looking up a built index.
+BENCHMARK(SmiTimeline_GoToCurrentLine) {
+	// Ends with a 500 line caption, for a caret far from its Sync.
+	auto text = Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000);
+	text += "<SYNC Start=99999999><P>";
+	for (auto i = 0; i < 500; ++i)
+		text += "a long caption line\r\n";
+	std::vector<std::string> lines;
+	for (size_t begin = 0; begin < text.size();) {
+		auto end = text.find('\n', begin);
+		end = end == std::string::npos ? text.size() : end + 1;
+		lines.push_back(text.substr(begin, end - begin));
+		begin = end;
+	}
+
+	std::mt19937 random(1);
+	std::vector<size_t> carets(1000);
+	for (auto& caret : carets)
+		caret = random() % lines.size();
+
+	const auto scan = [&](const std::vector<size_t>& from) {
+		int64_t sum = 0;
+		SmiParser::SyncTag tag;
+		for (const auto caret : from) {
+			for (auto line = caret; line != static_cast<size_t>(-1); --line) {
+				if (SmiParser::FindSyncTag(lines[line], 0, tag)) {
+					sum += tag.start;
+					break;
+				}
+			}
+		}
+		return sum;
+	};
+	int64_t scanSum = 0, indexSum = 0;
+	const auto scanTime = Test::Time([&] { scanSum = scan(carets); });
+	const std::vector<size_t> lastLine(carets.size(), lines.size() - 1);
+	const auto farScanTime = Test::Time([&] { scan(lastLine); });
+
+	SmiTimeline timeline;
+	const auto buildTime = Test::Time([&] { timeline.Build(text, 1); });
+	const auto lookupTime = Test::Time([&] {
+		indexSum = 0;
+		for (const auto caret : carets) {
+			const auto index = timeline.FindAtOrBeforeLine(caret);
+			if (index != SmiTimeline::npos)
+				indexSum += timeline.GetStart(index);
+		}
+	});
+	CHECK_EQ(indexSum, scanSum);
+
+	std::vector<double> activeTimes;
+	size_t found = 0;
+	for (size_t i = 0; i < 10000; ++i) {
+		const auto time = static_cast<int64_t>(random() % static_cast<uint32_t>(timeline.GetStart(timeline.Size() - 1) + 1));
+		activeTimes.push_back(Test::Time([&] { found += timeline.FindActiveAt(time) != SmiTimeline::npos; }, 1));
+	}
+
+	printf("  %zu lines, %zu Syncs, %.1f MB\n", lines.size(), timeline.Size(), text.size() / 1e6);
+	printf("  line scan: %.2f us per lookup, %.2f us 500 lines below the Sync\n", scanTime * 1e6 / carets.size(), farScanTime * 1e6 / carets.size());
+	printf("  index: built in %.2f ms, %.3f us per lookup\n", buildTime * 1e3, lookupTime * 1e6 / carets.size());
+	CHECK(found > 0);
+	printf("  FindActiveAt: p50 %.0f ns, p99 %.0f ns\n", Test::Percentile(activeTimes, 0.5) * 1e9, Test::Percentile(activeTimes, 0.99) * 1e9);
+}
+
+namespace {
+	// A document edited the way Scintilla reports it, with line starts kept for GetLineFromPosition.
+	class EditedText : public SmiTextSource {
+		std::string m_text;
+		std::vector<size_t> m_lineStarts;
+
+		static bool IsLineEnd(const std::string& text, const size_t i) {
+			return text[i] == '\n' || (text[i] == '\r' && (i + 1 == text.size() || text[i + 1] != '\n'));
+		}
+
+	public:
+		explicit EditedText(std::string text) : m_text(std::move(text)), m_lineStarts{ 0 } {
+			for (size_t i = 0; i < m_text.size(); ++i) {
+				if (IsLineEnd(m_text, i))
+					m_lineStarts.push_back(i + 1);
+			}
+		}
+
+		const std::string& GetText() const { return m_text; }
+		size_t GetLength() const override { return m_text.size(); }
+		std::string_view GetRange(const size_t offset, const size_t length) const override { return std::string_view(m_text).substr(offset, length); }
+		size_t GetLineFromPosition(const size_t position) const override {
+			return static_cast<size_t>(std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), position) - m_lineStarts.begin() - 1);
+		}
+
+		// Replaces [position, position + removed) and returns the lines added, as SCN_MODIFIED would.
+		ptrdiff_t Replace(const size_t position, const size_t removed, const std::string& inserted) {
+			// Only the line ends from the byte before the edit to the byte after it can change.
+			const auto from = position == 0 ? 0 : position - 1;
+			const auto before = m_lineStarts.size();
+			const auto firstChanged = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), from);
+			const auto lastChanged = std::upper_bound(firstChanged, m_lineStarts.end(), position + removed + 1);
+			const auto delta = static_cast<ptrdiff_t>(inserted.size()) - static_cast<ptrdiff_t>(removed);
+			for (auto it = lastChanged; it != m_lineStarts.end(); ++it)
+				*it = static_cast<size_t>(static_cast<ptrdiff_t>(*it) + delta);
+			const auto at = m_lineStarts.erase(firstChanged, lastChanged) - m_lineStarts.begin();
+
+			m_text.replace(position, removed, inserted);
+			std::vector<size_t> starts;
+			for (auto i = from; i <= position + inserted.size() && i < m_text.size(); ++i) {
+				if (IsLineEnd(m_text, i))
+					starts.push_back(i + 1);
+			}
+			m_lineStarts.insert(m_lineStarts.begin() + at, starts.begin(), starts.end());
+			return static_cast<ptrdiff_t>(m_lineStarts.size()) - static_cast<ptrdiff_t>(before);
+		}
+	};
+}
+
+// Deletes then inserts, as Scintilla reports a replacement, and checks the index against a fresh scan.
+static void CheckEdit(SmiTimeline& timeline, EditedText& text, const size_t position, const size_t removed, const std::string& inserted) {
+	if (removed != 0)
+		timeline.Update(text, position, removed, 0, text.Replace(position, removed, ""));
+	if (!inserted.empty())
+		timeline.Update(text, position, 0, inserted.size(), text.Replace(position, 0, inserted));
+
+	const auto entries = ScanEntries(text.GetText());
+	CHECK_EQ(text.GetLineFromPosition(text.GetLength()), SmiParser::CountLineBreaks(text.GetText()));
+	CHECK_EQ(timeline.Size(), entries.size());
+	if (timeline.Size() != entries.size())
+		return;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		CHECK_EQ(timeline.GetStart(i), entries[i].start);
+		CHECK_EQ(timeline.GetLine(i), entries[i].line);
+		CHECK_EQ(timeline.GetOffset(i), entries[i].offset);
+		CHECK_EQ(timeline.GetTagLength(i), ScanTagLength(text.GetText(), entries[i].offset));
+		CHECK_EQ(timeline.GetEnd(i), entries[i].end);
+	}
+	for (const auto& entry : entries) {
+		for (const auto time : { entry.start - 1, entry.start })
+			CHECK_EQ(timeline.FindActiveAt(time), FindActiveAtReference(entries, time));
+	}
+}
+
+TEST(SmiTimeline_Update_Paragraph) {
+	// The edit is past the end of the tag but completes its <P>.
+	const std::string paragraphCases[][3] = {
+		{ "<SYNC Start=1><Pa>x", "16", "" },
+		{ "<SYNC Start=1><P\r\n", "16", ">" },
+		{ "<SYNC Start=1>< >", "15", "P" },
+		{ "<SYNC Start=1><P>x\r\n<SYNC Start=2>", "15", "a" },
+		{ "<SYNC Start=1><P>x\r\n<SYNC Start=2>", "16", "a" },
+	};
+	for (const auto& edit : paragraphCases) {
+		EditedText text(edit[0]);
+		SmiTimeline timeline;
+		timeline.Build(text.GetText());
+		const auto position = static_cast<size_t>(std::stoul(edit[1]));
+		CheckEdit(timeline, text, position, edit[2].empty() ? 1 : 0, edit[2]);
+	}
+}
+
+TEST(SmiTimeline_Update_Random) {
+	static const char* const PIECES[] = {
+		"<SYNC Start=", "<sync start='", "'", "\"", "0", "5", "12", "999", " ", ">", "<P>", "<p", "P", "<", "\r\n", "\n", "\r",
+		"caption", "<br>", " End=10", " end='20000'", "<SYNC Start=1500><P>new\r\n",
+	};
+	std::mt19937 random(11);
+	for (auto document = 0; document < 40; ++document) {
+		EditedText text(document % 2 ? Corpus::MakeSmi(20, document) : MakeDocument({ 3000, 1000, -1, 2000, 2000, 500 }));
+		SmiTimeline timeline;
+		timeline.Build(text.GetText());
+		for (auto edit = 0; edit < 200; ++edit) {
+			const auto position = random() % (text.GetLength() + 1);
+			const auto removed = random() % 3 == 0 ? std::min<size_t>(random() % 24, text.GetLength() - position) : 0;
+			const auto inserted = random() % 4 == 0 && removed != 0 ? std::string() : PIECES[random() % (sizeof PIECES / sizeof PIECES[0])];
+			CheckEdit(timeline, text, position, removed, inserted);
+		}
+	}
+}
+
+// Replays typing into a large document: caption text, a Start digit that puts the Sync out of order and back,
+// and inserting and deleting whole Syncs, against building the index again.
+BENCHMARK(SmiTimeline_Update) {
+	EditedText text(Corpus::MakeSmi(Test::IsQuick() ? 2000 : 100000));
+	SmiTimeline timeline;
+	const auto buildTime = Test::Time([&] { timeline.Build(text.GetText(), 1); });
+	printf("  %zu Syncs, %.1f MB, Build %.2f ms\n", timeline.Size(), text.GetLength() / 1e6, buildTime * 1e3);
+
+	std::mt19937 random(5);
+	const auto replay = [&](const char* name, const std::function<std::pair<size_t, std::string>()>& pick, const bool remove) {
+		std::vector<double> samples;
+		for (auto i = 0; i < (Test::IsQuick() ? 20 : 200); ++i) {
+			const auto edit = pick();
+			const auto removed = remove ? edit.second.size() : 0;
+			const auto linesAdded = remove ? text.Replace(edit.first, removed, "") : text.Replace(edit.first, 0, edit.second);
+			samples.push_back(Test::Time([&] { timeline.Update(text, edit.first, removed, remove ? 0 : edit.second.size(), linesAdded); }, 1));
+		}
+		printf("  %s: p50 %.2f us, p99 %.2f us\n", name, Test::Percentile(samples, 0.5) * 1e6, Test::Percentile(samples, 0.99) * 1e6);
+	};
+	const auto randomSync = [&] { return timeline.GetOffset(timeline.Size() / 4 + random() % (timeline.Size() / 2)); };
+
+	replay("type in a caption", [&] {
+		const auto sync = randomSync();
+		return std::make_pair(text.GetText().find('\n', sync) - 1, std::string("a"));
+	}, false);
+	std::vector<size_t> digits;
+	replay("type a Start digit", [&] {
+		digits.push_back(text.GetText().find_first_of("0123456789", randomSync()));
+		return std::make_pair(digits.back(), std::string("9"));
+	}, false);
+	replay("delete it again", [&] {
+		const auto position = digits.back();
+		digits.pop_back();
+		return std::make_pair(position, std::string("9"));
+	}, true);
+	replay("insert a Sync", [&] { return std::make_pair(randomSync(), std::string("<SYNC Start=1000><P>new\r\n")); }, false);
+	replay("delete a Sync", [&] {
+		const auto sync = randomSync();
+		return std::make_pair(sync, text.GetText().substr(sync, text.GetText().find('\n', sync) + 1 - sync));
+	}, true);
+
+	const auto entries = ScanEntries(text.GetText());
+	CHECK_EQ(timeline.Size(), entries.size());
+	for (size_t i = 0; i < entries.size() && i < timeline.Size(); ++i)
+		CHECK_EQ(timeline.GetOffset(i), entries[i].offset);
+}
@@ -0,0 +1,216 @@
+#include "Corpus.h"
+#include "Test.h"
+#include "TextEncoding.h"
+#include <iconv.h>
+#include <random>
+
+static const TextEncoding::Kernel KERNELS[] = { TextEncoding::Kernel::SCALAR, TextEncoding::Kernel::SSSE3 };
+static const char* const KERNEL_NAMES[] = { "scalar", "SSSE3" };
+
+// Runs function with each kernel the CPU supports, then puts the default one back.
+template<typename TFunction>
+static void ForEachKernel(TFunction&& function) {
+	const auto original = TextEncoding::GetKernel();
+	for (size_t k = 0; k < 2; ++k) {
+		if (TextEncoding::SelectKernel(KERNELS[k]))
+			function(k);
+		else
+			printf("  %s: not supported by this CPU\n", KERNEL_NAMES[k]);
+	}
+	TextEncoding::SelectKernel(original);
+}
+
+static bool IsValidUtf8With(const TextEncoding::Kernel kernel, const std::string& text) {
+	const auto original = TextEncoding::GetKernel();
+	TextEncoding::SelectKernel(kernel);
+	const auto valid = TextEncoding::IsValidUtf8(text);
+	TextEncoding::SelectKernel(original);
+	return valid;
+}
+
+TEST(TextEncoding_IsValidUtf8_Cases) {
+	const std::pair<const char*, bool> cases[] = {
+		{ "", true },
+		{ "ascii only", true },
+		{ "\xC2\x80 \xDF\xBF", true },
+		{ "\xE0\xA0\x80 \xED\x9F\xBF \xEE\x80\x80 \xEF\xBF\xBF", true },
+		{ "\xF0\x90\x80\x80 \xF4\x8F\xBF\xBF", true },
+		{ "\xEA\xB0\x80\xEB\x82\x98\xEB\x8B\xA4", true },
+		{ "\xC0\x80", false }, // overlong
+		{ "\xC1\xBF", false },
+		{ "\xE0\x9F\xBF", false },
+		{ "\xF0\x8F\xBF\xBF", false },
+		{ "\xED\xA0\x80", false }, // surrogate
+		{ "\xED\xBF\xBF", false },
+		{ "\xF4\x90\x80\x80", false }, // past U+10FFFF
+		{ "\xF5\x80\x80\x80", false },
+		{ "\xFF", false },
+		{ "\x80", false }, // continuation without a lead
+		{ "a\xBF", false },
+		{ "\xC2", false }, // cut off
+		{ "\xE2\x82", false },
+		{ "\xF0\x90\x80", false },
+		{ "\xC2\x41", false },
+		{ "\xE2\x82\xAC\x80", false },
+	};
+	ForEachKernel([&](const size_t k) {
+		for (const auto& c : cases) {
+			// at every offset, so that the sequence crosses and ends on every block boundary
+			for (size_t pad = 0; pad < 40; ++pad) {
+				const auto text = std::string(pad, 'x') + c.first;
+				if (TextEncoding::IsValidUtf8(text) != c.second) {
+					CHECK_EQ(TextEncoding::IsValidUtf8(text), c.second);
+					printf("  %s, %zu bytes before \"%s\"\n", KERNEL_NAMES[k], pad, c.first);
+					break;
+				}
+			}
+		}
+	});
+}
+
+// Every two and three byte string, between ASCII bytes and across a block boundary, against the scalar kernel.
+TEST(TextEncoding_IsValidUtf8_Exhaustive) {
+	if (!TextEncoding::SelectKernel(TextEncoding::Kernel::SSSE3)) {
+		printf("  SSSE3: not supported by this CPU\n");
+		return;
+	}
+	TextEncoding::SelectKernel(TextEncoding::Kernel::SCALAR);
+	std::string text(32, 'x');
+	size_t mismatches = 0;
+	for (uint32_t value = 0; value < (1u << 24); ++value) {
+		text[14] = static_cast<char>(value >> 16);
+		text[15] = static_cast<char>(value >> 8);
+		text[16] = static_cast<char>(value);
+		if ((value & 0xFF0000) == 0 && (value & 0x8080) == 0)
+			continue;
+		const auto expected = IsValidUtf8With(TextEncoding::Kernel::SCALAR, text);
+		if (IsValidUtf8With(TextEncoding::Kernel::SSSE3, text) != expected && ++mismatches <= 5)
+			printf("  %06X: scalar says %d\n", value, expected);
+	}
+	CHECK_EQ(mismatches, 0u);
+}
+
+TEST(TextEncoding_IsValidUtf8_Random) {
+	static const char* const PIECES[] = {
+		"a", "<SYNC Start=1>", "\r\n", "\xC2\x80", "\xDF\xBF", "\xEA\xB0\x80", "\xEF\xBF\xBF", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF",
+		"\xC0", "\x80", "\xBF", "\xE2\x82", "\xED\xA0", "\xF4\x90", "\xF5", "\xFF", "\xF0", "\xE0\x9F",
+	};
+	std::mt19937 random(4);
+	size_t valid = 0, mismatches = 0;
+	for (auto iteration = 0; iteration < 200000; ++iteration) {
+		std::string text;
+		const auto pieces = random() % 24;
+		// mostly valid pieces, so that a good part of the strings is valid
+		const auto invalidOdds = 4 + random() % 200;
+		for (size_t i = 0; i < pieces; ++i)
+			text += PIECES[random() % invalidOdds == 0 ? 9 + random() % 10 : random() % 9];
+		const auto expected = IsValidUtf8With(TextEncoding::Kernel::SCALAR, text);
+		valid += expected;
+		if (IsValidUtf8With(TextEncoding::GetKernel(), text) != expected)
+			++mismatches;
+	}
+	CHECK_EQ(mismatches, 0u);
+	CHECK(valid > 10000 && valid < 190000);
+}
+
+// The built-in CP949 table against glibc's, for every lead and trail byte.
+TEST(TextEncoding_Cp949Table) {
+	const auto converter = iconv_open("UTF-8", "CP949");
+	if (converter == reinterpret_cast<iconv_t>(-1)) {
+		printf("  iconv has no CP949; not checked\n");
+		return;
+	}
+	size_t pairs = 0, mismatches = 0;
+	for (auto lead = 0x81; lead <= 0xFE; ++lead) {
+		for (auto trail = 0x41; trail <= 0xFE; ++trail) {
+			char in[2] = { static_cast<char>(lead), static_cast<char>(trail) };
+			char outBuffer[16];
+			char* inPointer = in;
+			char* outPointer = outBuffer;
+			size_t inLeft = 2, outLeft = sizeof outBuffer;
+			iconv(converter, nullptr, nullptr, nullptr, nullptr);
+			const auto converted = iconv(converter, &inPointer, &inLeft, &outPointer, &outLeft) != static_cast<size_t>(-1) && inLeft == 0;
+			const auto expected = converted ? std::string(outBuffer, outPointer) : std::string();
+
+			std::string ours;
+			TextEncoding::Cp949ToUtf8(std::string_view(in, 2), ours);
+			// an invalid pair decodes as U+FFFD and the trail byte on its own
+			const auto oursValid = ours.compare(0, 3, "\xEF\xBF\xBD") != 0;
+			pairs += converted;
+			if (oursValid != converted || (converted && ours != expected)) {
+				if (++mismatches <= 5)
+					printf("  %02X%02X: iconv %s, ours %s\n", lead, trail, converted ? "valid" : "invalid", oursValid ? "valid" : "invalid");
+			}
+		}
+	}
+	iconv_close(converter);
+	CHECK_EQ(mismatches, 0u);
+	CHECK_EQ(pairs, 17048u);
+}
+
+TEST(TextEncoding_Detect) {
+	using TextEncoding::Encoding;
+	CHECK_EQ(TextEncoding::Detect("\xEF\xBB\xBF<SAMI>").encoding, Encoding::UTF8);
+	CHECK_EQ(TextEncoding::Detect("\xEF\xBB\xBF<SAMI>").bomLength, 3u);
+	CHECK_EQ(TextEncoding::Detect("\xFF\xFE<\0S\0").encoding, Encoding::UTF16LE);
+	CHECK_EQ(TextEncoding::Detect(std::string_view("<\0S\0A\0M\0I\0>\0", 12)).encoding, Encoding::UTF16LE);
+	CHECK_EQ(TextEncoding::Detect(std::string_view("\0<\0S\0A\0M\0I\0>", 12)).encoding, Encoding::UTF16BE);
+	CHECK_EQ(TextEncoding::Detect("<SAMI>\xEA\xB0\x80").encoding, Encoding::UTF8);
+	CHECK_EQ(TextEncoding::Detect("<SAMI>\xB0\xA1\xB3\xAA").encoding, Encoding::CP949);
+	CHECK_EQ(TextEncoding::Detect("\x80\x80\x80\x80").encoding, Encoding::UNKNOWN);
+
+	std::string utf8;
+	CHECK(TextEncoding::ToUtf8("<P>\xB0\xA1", utf8));
+	CHECK_EQ(utf8, "<P>\xEA\xB0\x80");
+	utf8.clear();
+	CHECK(TextEncoding::ToUtf8(std::string_view("\xFF\xFE<\0\x00\xAC\x3D\xD8\x00\xDE", 10), utf8));
+	CHECK_EQ(utf8, "<\xEA\xB0\x80\xF0\x9F\x98\x80");
+}
+
+// Korean text in UTF-8 and CP949: validation per kernel, and CP949 conversion against glibc's iconv.
+BENCHMARK(TextEncoding_Utf8AndCp949) {
+	const auto smi = Corpus::MakeSmi(Test::IsQuick() ? 2000 : 200000);
+	std::string hangul;
+	while (hangul.size() < smi.size())
+		hangul += "\xEA\xB7\xB8\xEB\x9E\x98\xEC\x84\x9C \xEC\x96\xB4\xEB\x96\xBB\xEA\xB2\x8C \xEB\x90\x90\xEC\x96\xB4?\r\n";
+	const std::pair<const char*, const std::string*> inputs[] = { { "generated SMI", &smi }, { "Korean only", &hangul } };
+
+	for (const auto& input : inputs) {
+		printf("  %s, %.1f MB: IsValidUtf8", input.first, input.second->size() / 1e6);
+		ForEachKernel([&](const size_t k) {
+			auto valid = false;
+			const auto seconds = Test::Time([&] { valid = TextEncoding::IsValidUtf8(*input.second); });
+			CHECK(valid);
+			printf(" %s %.2f GB/s", KERNEL_NAMES[k], input.second->size() / seconds / 1e9);
+		});
+		printf("\n");
+	}
+
+	const auto toCp949 = iconv_open("CP949", "UTF-8");
+	const auto fromCp949 = iconv_open("UTF-8", "CP949");
+	if (toCp949 == reinterpret_cast<iconv_t>(-1) || fromCp949 == reinterpret_cast<iconv_t>(-1)) {
+		printf("  iconv has no CP949; conversion not measured\n");
+		return;
+	}
+	const auto convert = [](const iconv_t converter, const std::string& in) {
+		std::string out(in.size() * 2, '\0');
+		auto inPointer = const_cast<char*>(in.data());
+		auto outPointer = &out[0];
+		size_t inLeft = in.size(), outLeft = out.size();
+		iconv(converter, nullptr, nullptr, nullptr, nullptr);
+		iconv(converter, &inPointer, &inLeft, &outPointer, &outLeft);
+		out.resize(out.size() - outLeft);
+		return out;
+	};
+	for (const auto& input : inputs) {
+		const auto cp949 = convert(toCp949, *input.second);
+		std::string ours, theirs;
+		const auto oursTime = Test::Time([&] { ours.clear(); TextEncoding::Cp949ToUtf8(cp949, ours); });
+		const auto iconvTime = Test::Time([&] { theirs = convert(fromCp949, cp949); });
+		CHECK(ours == theirs);
+		printf("  %s in CP949, %.1f MB: Cp949ToUtf8 %.0f MB/s, iconv %.0f MB/s\n", input.first, cp949.size() / 1e6,
+			cp949.size() / oursTime / 1e6, cp949.size() / iconvTime / 1e6);
+	}
+	iconv_close(toCp949);
+	iconv_close(fromCp949);
+}
@@ -0,0 +1,177 @@
+// Dumps the timeline of SMI files: one line per Sync with its start, line number and byte offset.
+// Files are memory mapped a window at a time, so multi-gigabyte inputs use bounded memory.
+// With --tracks, lists the language tracks of each file instead, and with --text the plain text of each caption.
+
+#include "../src/MappedFile.h"
+#include "../src/SamiDocument.h"
+#include "../src/SmiStream.h"
+#include "../src/SmiText.h"
+#include "../src/TextEncoding.h"
+#include <cinttypes>
+#include <cstdio>
+
+static int DumpFile(const std::filesystem::path& path) {
+	MappedFile file;
+	if (!file.Open(path)) {
+		fprintf(stderr, "%s: cannot open\n", path.u8string().c_str());
+		return 1;
+	}
+
+	const auto print = [](const SmiParser::SyncTag& tag, const uint64_t offset, const uint64_t line) {
+		const auto t = tag.start;
+		printf("%" PRId64 "\t%02" PRId64 ":%02" PRId64 ":%02" PRId64 ".%03" PRId64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+			t, t / 3600000, t / 60000 % 60, t / 1000 % 60, t % 1000, line + 1, offset);
+		return true;
+	};
+
+	// CP949 and UTF-8 keep tags in ASCII and can be scanned as they are; UTF-16 has to be converted first.
+	const auto head = file.Map(0, static_cast<size_t>(file.GetSize() < 4096 ? file.GetSize() : 4096));
+	const auto encoding = TextEncoding::Detect(head).encoding;
+	if (encoding == TextEncoding::Encoding::UTF16LE || encoding == TextEncoding::Encoding::UTF16BE) {
+		const auto whole = file.Map(0, static_cast<size_t>(file.GetSize()));
+		std::string utf8;
+		if (whole.empty() || !TextEncoding::ToUtf8(whole, utf8)) {
+			fprintf(stderr, "%s: read error\n", path.u8string().c_str());
+			return 1;
+		}
+		fprintf(stderr, "%s: UTF-16; offsets are in the UTF-8 conversion\n", path.u8string().c_str());
+		SmiStream::ForEachSync(utf8, print);
+		return 0;
+	}
+
+	if (!SmiStream::ForEachSync(file, print)) {
+		fprintf(stderr, "%s: read error\n", path.u8string().c_str());
+		return 1;
+	}
+	return 0;
+}
+
+// Reads the whole file into memory as UTF-8.
+static bool ReadUtf8(const std::filesystem::path& path, std::string& utf8) {
+	MappedFile file;
+	if (!file.Open(path)) {
+		fprintf(stderr, "%s: cannot open\n", path.u8string().c_str());
+		return false;
+	}
+	if (file.GetSize() == 0)
+		return true;
+	const auto whole = file.Map(0, static_cast<size_t>(file.GetSize()));
+	if (whole.empty() || !TextEncoding::ToUtf8(whole, utf8)) {
+		fprintf(stderr, "%s: read error or unknown encoding\n", path.u8string().c_str());
+		return false;
+	}
+	return true;
+}
+
+// Length of s for printf's %.*s.
+static int Field(const std::string_view s) {
+	return static_cast<int>(s.size());
+}
+
+// Prints each STYLE class with its Name, lang and SAMIType and the number of paragraphs in it.
+static int DumpTracks(const std::filesystem::path& path) {
+	std::string utf8;
+	if (!ReadUtf8(path, utf8))
+		return 1;
+
+	SamiDocument document;
+	document.Parse(utf8);
+	const auto& classes = document.GetClasses();
+	std::vector<size_t> paragraphs(classes.size());
+	size_t unclassed = 0;
+	for (auto sync = document.GetFirstSync(); sync != nullptr; sync = sync->next) {
+		for (auto paragraph = sync->paragraphs; paragraph != nullptr; paragraph = paragraph->next) {
+			if (paragraph->classId == SamiDocument::NO_CLASS)
+				++unclassed;
+			else
+				++paragraphs[paragraph->classId];
+		}
+	}
+
+	for (size_t i = 0; i < classes.size(); ++i) {
+		const auto& c = classes[i];
+		printf("%.*s\t%.*s\t%.*s\t%.*s\t%zu%s\n", Field(c.name), c.name.data(), Field(c.displayName), c.displayName.data(),
+			Field(c.lang), c.lang.data(), Field(c.samiType), c.samiType.data(), paragraphs[i], c.isDeclared ? "" : "\tundeclared");
+	}
+	if (unclassed != 0)
+		printf("-\t\t\t\t%zu\n", unclassed);
+	return 0;
+}
+
+// Prints the start, class and plain text of each paragraph that has any; line breaks are shown as \n.
+static int DumpText(const std::filesystem::path& path) {
+	std::string utf8;
+	if (!ReadUtf8(path, utf8))
+		return 1;
+
+	SamiDocument document;
+	document.Parse(utf8);
+	const auto& classes = document.GetClasses();
+	std::string text;
+	for (auto sync = document.GetFirstSync(); sync != nullptr; sync = sync->next) {
+		for (auto paragraph = sync->paragraphs; paragraph != nullptr; paragraph = paragraph->next) {
+			text.resize(paragraph->text.size());
+			text.resize(SmiText::NormalizeCaption(paragraph->text, &text[0], text.size()));
+			if (text.empty())
+				continue;
+
+			const auto className = paragraph->classId == SamiDocument::NO_CLASS ? std::string_view("-") : classes[paragraph->classId].name;
+			printf("%" PRId64 "\t%.*s\t", sync->start, Field(className), className.data());
+			for (const auto c : text) {
+				if (c == '\n')
+					fputs("\\n", stdout);
+				else
+					putchar(c);
+			}
+			putchar('\n');
+		}
+	}
+	return 0;
+}
+
+template<typename TChar>
+static bool IsOption(const TChar* arg, const char* option) {
+	for (; *option != '\0'; ++arg, ++option) {
+		if (*arg != static_cast<TChar>(*option))
+			return false;
+	}
+	return *arg == 0;
+}
+
+template<typename TChar>
+static int Run(const int argc, TChar* argv[]) {
+	auto dump = DumpFile;
+	if (argc > 1 && IsOption(argv[1], "--tracks"))
+		dump = DumpTracks;
+	else if (argc > 1 && IsOption(argv[1], "--text"))
+		dump = DumpText;
+	const auto first = dump == DumpFile ? 1 : 2;
+	if (argc <= first) {
+		fprintf(stderr, "Usage: SmiDump [--tracks | --text] file.smi [file.smi...]\n"
+			"Prints start (ms), start (HH:MM:SS.mmm), line and byte offset of each Sync, tab separated.\n"
+			"--tracks prints class, Name, lang, SAMIType and paragraph count of each STYLE class instead.\n"
+			"--text prints start, class and plain text of each paragraph instead.\n");
+		return 2;
+	}
+
+	static char buffer[1 << 16];
+	setvbuf(stdout, buffer, _IOFBF, sizeof buffer);
+
+	auto result = 0;
+	for (auto i = first; i < argc; ++i) {
+		if (argc > first + 1)
+			printf("# %s\n", std::filesystem::path(argv[i]).u8string().c_str());
+		result |= dump(argv[i]);
+	}
+	return result;
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[]) {
+	return Run(argc, argv);
+}
+#else
+int main(int argc, char* argv[]) {
+	return Run(argc, argv);
+}
+#endif
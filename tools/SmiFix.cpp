@@ -0,0 +1,205 @@
+// Fixes up and checks the timing of SMI files outside of the editor.
+// The input is memory mapped and the output written in one pass, with only the changed part rewritten.
+
+#include "../src/MappedFile.h"
+#include "../src/SmiLint.h"
+#include "../src/SmiRetime.h"
+#include "../src/SmiSort.h"
+#include "../src/TextEncoding.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static const char* const USAGE =
+	"Usage: SmiFix retime [--fps FROM:TO | --scale NUM/DEN] [--offset MS] in.smi [out.smi]\n"
+	"       SmiFix sort in.smi [out.smi]\n"
+	"       SmiFix lint [--min-duration MS] in.smi\n"
+	"retime multiplies every Sync Start by the scale, rounds to the nearest millisecond and adds the offset.\n"
+	"--fps converts between framerates, as in --fps 23.976:25; rates may be decimals or fractions.\n"
+	"sort orders the Syncs and the text after each by Start, keeping equal ones in file order.\n"
+	"Writes to out.smi, which must not be in.smi, or to standard output.\n"
+	"lint lists Syncs that are out of order, start together with the next one or last less than\n"
+	"--min-duration (100 ms), as line, start and issue; the exit status is 1 if there are any.\n";
+
+struct Options {
+	std::string command;
+	std::filesystem::path input;
+	std::filesystem::path output;
+	SmiRetime::Affine affine;
+	SmiLint::Options lint;
+};
+
+static bool ParseOffset(const std::string& text, int64_t& offset) {
+	char* end;
+	offset = strtoll(text.c_str(), &end, 10);
+	return !text.empty() && *end == 0;
+}
+
+template<typename TChar>
+static bool ParseOptions(const int argc, TChar* argv[], Options& options) {
+	std::vector<std::string> args;
+	for (auto i = 1; i < argc; ++i)
+		args.push_back(std::filesystem::path(argv[i]).u8string());
+	if (args.empty())
+		return false;
+	options.command = args[0];
+	if (options.command != "retime" && options.command != "sort" && options.command != "lint")
+		return false;
+	const auto isRetime = options.command == "retime";
+	const auto isLint = options.command == "lint";
+
+	// The framerates, or the scale, as from:to or num/den.
+	SmiRetime::Rational from, to;
+	auto hasScale = false;
+	int64_t offset = 0;
+	std::vector<std::filesystem::path> files;
+	for (size_t i = 1; i < args.size(); ++i) {
+		const auto& arg = args[i];
+		const auto hasValue = i + 1 < args.size();
+		if ((arg == "--fps" || arg == "--scale") && hasValue && !hasScale && isRetime) {
+			const auto& value = args[++i];
+			const auto separator = value.find(arg == "--fps" ? ':' : '/');
+			if (separator == std::string::npos || !SmiRetime::ParseRate(std::string_view(value).substr(0, separator), from)
+				|| !SmiRetime::ParseRate(std::string_view(value).substr(separator + 1), to)) {
+				fprintf(stderr, "bad %s: %s\n", arg.c_str() + 2, value.c_str());
+				return false;
+			}
+			hasScale = true;
+		} else if (arg == "--offset" && hasValue && isRetime) {
+			if (!ParseOffset(args[++i], offset)) {
+				fprintf(stderr, "bad offset: %s\n", args[i].c_str());
+				return false;
+			}
+		} else if (arg == "--min-duration" && hasValue && isLint) {
+			if (!ParseOffset(args[++i], options.lint.minDuration) || options.lint.minDuration < 0) {
+				fprintf(stderr, "bad minimum duration: %s\n", args[i].c_str());
+				return false;
+			}
+		} else if (arg.compare(0, 2, "--") == 0) {
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			return false;
+		} else
+			files.push_back(std::filesystem::u8path(arg));
+	}
+
+	if (files.empty() || files.size() > (isLint ? 1u : 2u))
+		return false;
+	options.input = files[0];
+	if (files.size() == 2)
+		options.output = files[1];
+
+	if (!SmiRetime::ConvertFramerate(from, to, offset, options.affine)) {
+		fprintf(stderr, "scale out of range\n");
+		return false;
+	}
+	return true;
+}
+
+static int Lint(const std::string_view text, const SmiLint::Options& options) {
+	static char buffer[1 << 16];
+	setvbuf(stdout, buffer, _IOFBF, sizeof buffer);
+
+	SmiTimeline timeline;
+	timeline.Build(text);
+	const auto findings = SmiLint::CheckAll(timeline, options);
+	for (const auto& finding : findings) {
+		const auto t = timeline.GetStart(finding.index);
+		for (auto bit = 1u; bit <= finding.issues; bit <<= 1) {
+			if (finding.issues & bit)
+				printf("%zu\t%02" PRId64 ":%02" PRId64 ":%02" PRId64 ".%03" PRId64 "\t%s\n", timeline.GetLine(finding.index) + 1,
+					t / 3600000, t / 60000 % 60, t / 1000 % 60, t % 1000, SmiLint::Describe(static_cast<SmiLint::Issue>(bit)));
+		}
+	}
+	fflush(stdout);
+	fprintf(stderr, "%zu of %zu Syncs with issues\n", findings.size(), timeline.Size());
+	return findings.empty() ? 0 : 1;
+}
+
+static int Fix(const Options& options) {
+	MappedFile file;
+	if (!file.Open(options.input)) {
+		fprintf(stderr, "%s: cannot open\n", options.input.u8string().c_str());
+		return 1;
+	}
+	const auto text = file.Map(0, static_cast<size_t>(file.GetSize()));
+	if (text.empty() && file.GetSize() != 0) {
+		fprintf(stderr, "%s: read error\n", options.input.u8string().c_str());
+		return 1;
+	}
+
+	// Tags are rewritten in place, which needs them in ASCII.
+	const auto encoding = TextEncoding::Detect(text.substr(0, 4096)).encoding;
+	if (encoding == TextEncoding::Encoding::UTF16LE || encoding == TextEncoding::Encoding::UTF16BE) {
+		fprintf(stderr, "%s: UTF-16 is not supported\n", options.input.u8string().c_str());
+		return 1;
+	}
+
+	if (options.command == "lint")
+		return Lint(text, options.lint);
+
+	SmiRetime::Edit edit;
+	const auto changed = options.command == "sort"
+		? SmiSort::Sort(text, edit)
+		: SmiRetime::Retime(text, 0, text.size(), options.affine, edit);
+
+	std::error_code error;
+	if (!options.output.empty() && std::filesystem::equivalent(options.input, options.output, error)) {
+		fprintf(stderr, "%s: cannot write over the input\n", options.output.u8string().c_str());
+		return 1;
+	}
+	const auto out = options.output.empty() ? stdout :
+#ifdef _WIN32
+		_wfopen(options.output.c_str(), L"wb");
+#else
+		fopen(options.output.c_str(), "wb");
+#endif
+	if (out == nullptr) {
+		fprintf(stderr, "%s: cannot create\n", options.output.u8string().c_str());
+		return 1;
+	}
+
+	auto written = true;
+	if (changed) {
+		written &= fwrite(text.data(), 1, edit.begin, out) == edit.begin;
+		written &= fwrite(edit.text.data(), 1, edit.text.size(), out) == edit.text.size();
+		written &= fwrite(text.data() + edit.end, 1, text.size() - edit.end, out) == text.size() - edit.end;
+	} else
+		written &= fwrite(text.data(), 1, text.size(), out) == text.size();
+	written &= fflush(out) == 0;
+	if (out != stdout)
+		written &= fclose(out) == 0;
+	if (!written) {
+		fprintf(stderr, "%s: write error\n", options.output.empty() ? "stdout" : options.output.u8string().c_str());
+		return 1;
+	}
+
+	fprintf(stderr, options.command == "sort" ? "%zu Syncs reordered\n" : "%zu Syncs retimed\n", edit.changed);
+	return 0;
+}
+
+template<typename TChar>
+static int Run(const int argc, TChar* argv[]) {
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		fputs(USAGE, stderr);
+		return 2;
+	}
+	return Fix(options);
+}
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+
+int wmain(int argc, wchar_t* argv[]) {
+	// The output is written byte for byte; no CR LF translation.
+	_setmode(_fileno(stdout), _O_BINARY);
+	return Run(argc, argv);
+}
+#else
+int main(int argc, char* argv[]) {
+	return Run(argc, argv);
+}
+#endif